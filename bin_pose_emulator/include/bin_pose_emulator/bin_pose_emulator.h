@@ -22,57 +22,70 @@ limitations under the License.
 #include <yaml-cpp/yaml.h>
 #include <geometry_msgs/Pose.h>
 #include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
 #include <tf/transform_broadcaster.h>
 #include <bin_pose_msgs/bin_pose.h>
-
-struct ConfigData
-{
-  // Virtual Bin center
-  double bin_center_x;
-  double bin_center_y;
-  double bin_center_z;
-
-  // Virtual Bin size
-  double bin_size_x;
-  double bin_size_y;
-  double bin_size_z;
-
-  // Default tool point orientation
-  double roll_default;
-  double pitch_default;
-  double yaw_default;
-
-  // Allowed orientation range
-  double roll_range;
-  double pitch_range;
-  double yaw_range;
-
-  // Planning constraints
-  double approach_distance;
-  double deapproach_height;
-};
+#include <bin_pose_msgs/bin_pose_batch.h>
+#include <bin_pose_msgs/bin_pose_pick_result.h>
+#include <bin_pose_emulator/config_data.h>
+#include <bin_pose_emulator/random_engine.h>
+#include <bin_pose_emulator/pile_generator.h>
+#include <bin_pose_emulator/reachability_map.h>
+#include <bin_pose_emulator/grasp_scorer.h>
+#include <bin_pose_emulator/pose_batch.h>
+
+#include <atomic>
+#include <random>
+#include <algorithm>
 
 class BinPoseEmulator
 {
 public:
-  BinPoseEmulator(ros::NodeHandle* nh, std::string filepath);
+  // Private params are read from pnh, nodelets pass their private node handle
+  BinPoseEmulator(ros::NodeHandle* nh, std::string filepath, ros::NodeHandle pnh = ros::NodeHandle("~"));
   ~BinPoseEmulator();
 
   bool callback(bin_pose_msgs::bin_pose::Request& req,
                 bin_pose_msgs::bin_pose::Response& res);
+  bool batchCallback(bin_pose_msgs::bin_pose_batch::Request& req,
+                     bin_pose_msgs::bin_pose_batch::Response& res);
+  bool pickResultCallback(bin_pose_msgs::bin_pose_pick_result::Request& req,
+                          bin_pose_msgs::bin_pose_pick_result::Response& res);
 
 private:
-  double randGen(double fMin, double fMax);
+  RandomEnginePtr requestEngine(uint32_t request_seed);
+  void samplePoses(RandomEngine& engine, std::size_t count, PoseSamples& samples);
   bool parseConfig(std::string filepath);
+  bool exposedPileGrasps(std::vector<PileGrasp>& grasps);
+  bool isReachable(double x, double y, double z, const double q[4]) const;
 
   void visualizeBin(void);
   void visualizePose(geometry_msgs::Pose grasp_pose,
                       geometry_msgs::Pose approach_pose);
   void broadcastPoseTF(geometry_msgs::Pose grasp_pose);
+  void visualizePile(void);
 
   ros::Publisher marker_pub_;
+  ros::Publisher pile_pub_;
 
   ConfigData config_;
+
+  // Requests without own seed take consecutive streams of node seed
+  std::string random_engine_;
+  uint64_t seed_;
+  std::atomic<uint64_t> stream_;
+
+  // Pile of parts, poses are sampled uniformly in the bin when not set
+  std::shared_ptr<PileGenerator> pile_;
+  double max_grasp_tilt_;
+
+  // Grasp and approach poses are checked against the map when loaded
+  ReachabilityMap reachability_map_;
+  int max_resample_rounds_;
+  int max_batch_size_;
+
+  // Ranks batch candidates, best first
+  std::shared_ptr<GraspScorer> scorer_;
 };
 
 #endif // BIN_POSE_EMULATOR_H
@@ -0,0 +1,74 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef GRASP_SCORER_H
+#define GRASP_SCORER_H
+
+#include <bin_pose_emulator/config_data.h>
+#include <bin_pose_emulator/pose_batch.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Spheres the approach path must keep clear of, pile parts in pile mode
+struct ScoringObstacles
+{
+  std::vector<double> x, y, z;
+  std::vector<uint32_t> part_ids;  // obstacle is skipped for grasps of the same part
+  double radius;
+};
+
+struct ScoringWeights
+{
+  double wall;
+  double tilt;
+  double height;
+  double clearance;
+};
+
+// Ranks grasp candidates by cheap geometric features, each normalized to 0..1:
+//  - wall: horizontal distance of the grasp point to bin walls over wall_margin
+//  - tilt: deviation of tool Z axis from default orientation, zero at max_tilt
+//  - height: grasp height above bin bottom over bin height
+//  - clearance: distance of the approach segment to obstacles and bin walls
+//    over clearance_margin, walls count only below the bin rim
+// Score is the weighted mean of the features, 1 is the best. Features are
+// computed in branch free loops over the arrays which the compiler vectorizes.
+class GraspScorer
+{
+public:
+  GraspScorer(const ConfigData& config, const ScoringWeights& weights, double max_tilt, double wall_margin,
+              double clearance_margin);
+  ~GraspScorer();
+
+  void score(const GraspBatch& grasps, const ScoringObstacles& obstacles, std::vector<double>& scores) const;
+
+  // Candidate indices by descending score, equal scores keep candidate order
+  static void rank(const std::vector<double>& scores, std::vector<std::size_t>& ranking);
+
+private:
+  ConfigData config_;
+  ScoringWeights weights_;
+  double cos_max_tilt_;
+  double wall_margin_;
+  double clearance_margin_;
+
+  // Tool Z axis of default orientation
+  double default_axis_[3];
+};
+
+#endif  // GRASP_SCORER_H
@@ -0,0 +1,94 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef PILE_GENERATOR_H
+#define PILE_GENERATOR_H
+
+#include <tf/tf.h>
+#include <geometry_msgs/Pose.h>
+#include <bin_pose_emulator/config_data.h>
+#include <bin_pose_emulator/random_engine.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Box shaped part resting in the bin
+struct PilePart
+{
+  uint32_t id;
+  tf::Vector3 center;
+  tf::Matrix3x3 rotation;
+  double yaw;
+};
+
+// Grasp of the top face of an exposed part
+struct PileGrasp
+{
+  uint32_t part_id;
+  geometry_msgs::Pose grasp_pose;
+  double tilt;  // angle between grasped face normal and vertical axis
+};
+
+// Pile of parts built by dropping boxes one by one from above the pile
+// until the first contact. Overlaps are checked by separating axis test
+// against neighbours found in a spatial hash, no physics is simulated.
+// Part sizes have to be positive.
+class PileGenerator
+{
+public:
+  PileGenerator(const ConfigData& config, const tf::Vector3& part_size, std::size_t num_of_parts,
+                double max_part_tilt, double max_grasp_tilt);
+  ~PileGenerator();
+
+  // Drops new pile of parts, returns number of parts that fit into the bin
+  std::size_t generate(RandomEngine& engine);
+
+  // Parts with free approach path and acceptable tilt of the top face
+  void exposedGrasps(std::vector<PileGrasp>& grasps) const;
+
+  bool remove(uint32_t part_id);
+  std::size_t size() const;
+  const std::vector<PilePart>& parts() const;
+  tf::Vector3 partSize() const;
+
+  // Separating axis test of two parts and slab test of a segment against a part
+  bool overlaps(const PilePart& a, const PilePart& b) const;
+  bool segmentHitsPart(const tf::Vector3& from, const tf::Vector3& to, const PilePart& part) const;
+
+private:
+  bool drop(PilePart& part);
+  tf::Vector3 aabbHalfExtents(const PilePart& part) const;
+  void neighbours(const tf::Vector3& min, const tf::Vector3& max, std::vector<std::size_t>& indices) const;
+  int64_t cellKey(int x, int y, int z) const;
+  void insertIntoHash(std::size_t index);
+  void rebuildHash();
+
+  ConfigData config_;
+  tf::Vector3 half_size_;
+  std::size_t num_of_parts_;
+  double max_part_tilt_;
+  double max_grasp_tilt_;
+  tf::Quaternion default_orientation_;
+
+  std::vector<PilePart> parts_;
+  uint32_t next_id_;
+
+  double cell_size_;
+  std::unordered_map<int64_t, std::vector<std::size_t> > hash_;
+};
+
+#endif  // PILE_GENERATOR_H
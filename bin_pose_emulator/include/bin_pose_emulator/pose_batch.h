@@ -0,0 +1,71 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef POSE_BATCH_H
+#define POSE_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sampled grasp poses, one array per degree of freedom
+struct PoseSamples
+{
+  std::vector<double> x, y, z;
+  std::vector<double> roll, pitch, yaw;
+};
+
+// Grasp candidates, one array per pose component
+struct GraspBatch
+{
+  std::vector<double> x, y, z;
+  std::vector<double> qx, qy, qz, qw;
+  std::vector<uint32_t> part_ids;  // 0 when not generated from a pile
+
+  std::size_t size() const
+  {
+    return x.size();
+  }
+  void resize(std::size_t count);
+};
+
+// Approach and deapproach poses of a grasp batch, both keep grasp orientation
+// and deapproach pose differs from grasp pose only in height
+struct ApproachBatch
+{
+  std::vector<double> approach_x, approach_y, approach_z;
+  std::vector<double> deapproach_z;
+
+  void resize(std::size_t count);
+};
+
+//-----------------------------------------------------------------------------------------
+// Batch kernels, AVX when compiled with -mavx, SSE2 on other x86-64 builds and
+// scalar code elsewhere. Sine and cosine use one polynomial in all of them, so a
+// pose does not depend on its position in the batch. Scalar code is selected
+// with vectorized set to false, e.g. for benchmarks.
+
+// Converts samples to quaternions, same convention as tf::Quaternion::setRPY
+void rpyToQuaternion(const PoseSamples& samples, GraspBatch& grasps, bool vectorized = true);
+
+// Offsets grasp poses by approach_distance against tool Z axis and by deapproach_height up
+void deriveApproachPoses(const GraspBatch& grasps, double approach_distance, double deapproach_height,
+                         ApproachBatch& poses, bool vectorized = true);
+
+// Instruction set of vectorized kernels, "avx", "sse2" or "scalar"
+const char* poseKernelInstructionSet();
+
+#endif  // POSE_BATCH_H
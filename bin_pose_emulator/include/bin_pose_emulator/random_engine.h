@@ -0,0 +1,74 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef RANDOM_ENGINE_H
+#define RANDOM_ENGINE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Uniform random source of bin pose emulator. Engines are cheap to create,
+// every request seeds its own instance so callbacks stay reentrant.
+class RandomEngine
+{
+public:
+  virtual ~RandomEngine() {}
+
+  // Same seed and stream always produce the same sequence
+  virtual void seed(uint64_t seed, uint64_t stream) = 0;
+
+  // Fills samples with uniform values in [0, 1)
+  virtual void uniform(double* samples, std::size_t count) = 0;
+};
+
+typedef std::shared_ptr<RandomEngine> RandomEnginePtr;
+
+// xoshiro256** (Blackman, Vigna), state initialized by splitmix64
+// from seed and stream as recommended by the authors
+class XoshiroEngine : public RandomEngine
+{
+public:
+  XoshiroEngine();
+
+  void seed(uint64_t seed, uint64_t stream);
+  void uniform(double* samples, std::size_t count);
+
+private:
+  uint64_t next();
+
+  uint64_t state_[4];
+};
+
+// Counter based engine, n-th value is splitmix64 finalizer of (key, n),
+// streams are selected by key without any state advancing
+class CounterEngine : public RandomEngine
+{
+public:
+  CounterEngine();
+
+  void seed(uint64_t seed, uint64_t stream);
+  void uniform(double* samples, std::size_t count);
+
+private:
+  uint64_t key_;
+  uint64_t counter_;
+};
+
+// Returns engine by name ("xoshiro" or "counter"), NULL for unknown name
+RandomEnginePtr createRandomEngine(const std::string& name);
+
+#endif  // RANDOM_ENGINE_H
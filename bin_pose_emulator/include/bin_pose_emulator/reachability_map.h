@@ -0,0 +1,93 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef REACHABILITY_MAP_H
+#define REACHABILITY_MAP_H
+
+#include <bin_pose_emulator/config_data.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Discretization of tool poses. Position is voxelized over the bin volume,
+// orientation is binned by polar angle of tool Z axis from vertical down
+// direction, its azimuth and roll of the tool around its Z axis.
+struct ReachabilityGrid
+{
+  double min[3];
+  double voxel_size;
+  uint32_t dimensions[3];
+
+  double max_polar;
+  uint32_t polar_bins;
+  uint32_t azimuth_bins;
+  uint32_t roll_bins;
+};
+
+// Precomputed reachability and IK solutions of tool poses. File layout is
+// a fixed header followed by 64 byte aligned arrays, one reachability flag
+// per cell and one float array per joint, so the file is memory mapped as
+// is and a lookup costs a few arithmetic operations and a couple of reads.
+class ReachabilityMap
+{
+public:
+  ReachabilityMap();
+  ~ReachabilityMap();
+
+  // Grid over bin volume extended by approach and deapproach distance
+  static ReachabilityGrid gridFromConfig(const ConfigData& config, double voxel_size, double max_polar,
+                                         uint32_t polar_bins, uint32_t azimuth_bins, uint32_t roll_bins);
+
+  void create(const ReachabilityGrid& grid, const std::vector<std::string>& joint_names);
+  // Checksum is not verified by default, hashing the whole file would defeat mapping it
+  bool load(const std::string& filepath, bool verify_checksum = false);
+  bool save(const std::string& filepath);
+  bool empty() const;
+
+  const ReachabilityGrid& grid() const;
+  std::size_t size() const;
+  std::size_t orientationBins() const;
+  const std::vector<std::string>& jointNames() const;
+
+  // Cell of the pose, false outside of the map
+  bool cellIndex(double x, double y, double z, double qx, double qy, double qz, double qw, std::size_t& index) const;
+  void cellPose(std::size_t index, double position[3], double orientation[4]) const;
+
+  // Poses outside of the map are unreachable
+  bool reachable(double x, double y, double z, double qx, double qy, double qz, double qw) const;
+  bool solution(double x, double y, double z, double qx, double qy, double qz, double qw,
+                std::vector<double>& joints) const;
+  void setSolution(std::size_t index, const std::vector<double>& joints);
+  void setUnreachable(std::size_t index);
+
+private:
+  bool attach(uint8_t* base, std::size_t size, bool verify_checksum);
+  void unmap();
+
+  ReachabilityGrid grid_;
+  std::vector<std::string> joint_names_;
+
+  // Cell arrays point either to the mapped file or to buffer_ while building
+  uint8_t* reachable_;
+  std::vector<float*> joints_;
+  std::vector<uint8_t> buffer_;
+
+  void* mapping_;
+  std::size_t mapping_size_;
+};
+
+#endif  // REACHABILITY_MAP_H
@@ -16,14 +16,89 @@ limitations under the License.
 
 #include "bin_pose_emulator/bin_pose_emulator.h"
 
-BinPoseEmulator::BinPoseEmulator(ros::NodeHandle* nh, std::string filepath)
+BinPoseEmulator::BinPoseEmulator(ros::NodeHandle* nh, std::string filepath, ros::NodeHandle pnh) : stream_(0)
 {
   parseConfig(filepath); // parse yaml config file
-  srandom(time(NULL));   // initialize random generator
+
+  // Initialize random generator, zero seed selects a random one
+  int seed;
+  pnh.param<std::string>("random_engine", random_engine_, "xoshiro");
+  pnh.param<int>("seed", seed, 0);
+  seed_ = (seed != 0) ? static_cast<uint32_t>(seed) : std::random_device()();
+
+  if (!createRandomEngine(random_engine_))
+  {
+    ROS_WARN("BIN POSE EMULATOR: Unknown random engine %s, using xoshiro", random_engine_.c_str());
+    random_engine_ = "xoshiro";
+  }
+  ROS_INFO("BIN POSE EMULATOR: Random engine %s, seed %lu", random_engine_.c_str(),
+           static_cast<unsigned long>(seed_));
 
   marker_pub_ =
       nh->advertise<visualization_msgs::Marker>("bin_pose_visualization", 1);
 
+  // Upper bound of poses sampled by one batch request
+  pnh.param<int>("max_batch_size", max_batch_size_, 10000);
+  max_batch_size_ = std::max(max_batch_size_, 1);
+
+  // Reachability map pre-filter
+  std::string reachability_map;
+  bool verify_reachability_map;
+  pnh.param<int>("max_resample_rounds", max_resample_rounds_, 10);
+  max_resample_rounds_ = std::max(max_resample_rounds_, 1);
+  pnh.param<bool>("verify_reachability_map", verify_reachability_map, false);
+  if (pnh.getParam("reachability_map", reachability_map) && !reachability_map.empty())
+  {
+    if (reachability_map_.load(reachability_map, verify_reachability_map))
+      ROS_INFO("BIN POSE EMULATOR: Loaded reachability map with %zu cells", reachability_map_.size());
+    else
+      ROS_ERROR("BIN POSE EMULATOR: Not able to load reachability map %s", reachability_map.c_str());
+  }
+
+  // Pile generator mode
+  std::string generator;
+  pnh.param<std::string>("generator", generator, "uniform");
+
+  if (generator == "pile")
+  {
+    int pile_parts;
+    double part_size_x, part_size_y, part_size_z, max_part_tilt;
+    pnh.param<int>("pile_parts", pile_parts, 30);
+    pnh.param<double>("part_size_x", part_size_x, 0.08);
+    pnh.param<double>("part_size_y", part_size_y, 0.04);
+    pnh.param<double>("part_size_z", part_size_z, 0.02);
+    pnh.param<double>("max_part_tilt", max_part_tilt, 0.3);
+    pnh.param<double>("max_grasp_tilt", max_grasp_tilt_,
+                      std::min(config_.roll_range, config_.pitch_range) / 2);
+
+    // Drop step and spatial hash cells are derived from part size
+    if (!(part_size_x > 0 && part_size_y > 0 && part_size_z > 0))
+      ROS_ERROR("BIN POSE EMULATOR: Part sizes have to be positive, using uniform generator");
+    else
+    {
+      pile_.reset(new PileGenerator(config_, tf::Vector3(part_size_x, part_size_y, part_size_z),
+                                    std::max(pile_parts, 0), max_part_tilt, max_grasp_tilt_));
+      pile_pub_ = nh->advertise<visualization_msgs::MarkerArray>("bin_pile_visualization", 1, true);
+
+      std::size_t parts = pile_->generate(*requestEngine(0));
+      ROS_INFO("BIN POSE EMULATOR: Generated pile of %zu parts", parts);
+      visualizePile();
+    }
+  }
+
+  // Grasp scoring, tilt is measured up to max grasp tilt in pile mode or orientation range otherwise
+  ScoringWeights weights;
+  double wall_margin, clearance_margin;
+  pnh.param<double>("wall_weight", weights.wall, 1.0);
+  pnh.param<double>("tilt_weight", weights.tilt, 1.0);
+  pnh.param<double>("height_weight", weights.height, 1.0);
+  pnh.param<double>("clearance_weight", weights.clearance, 1.0);
+  pnh.param<double>("wall_margin", wall_margin, 0.05);
+  pnh.param<double>("clearance_margin", clearance_margin, 0.05);
+
+  double max_tilt = pile_ ? max_grasp_tilt_ : hypot(config_.roll_range, config_.pitch_range) / 2;
+  scorer_.reset(new GraspScorer(config_, weights, max_tilt, wall_margin, clearance_margin));
+
   ROS_WARN("BIN POSE EMULATOR: Ready!");
 }
 
@@ -36,26 +111,56 @@ bool BinPoseEmulator::callback(bin_pose_msgs::bin_pose::Request& req,
   //-----------------------------------------------------------------------------------------
   // Generate random Grasp pose
   geometry_msgs::Pose grasp_pose;
-  grasp_pose.position.x = randGen(config_.bin_center_x - config_.bin_size_x / 2,
-                                  config_.bin_center_x + config_.bin_size_x / 2);
-  grasp_pose.position.y = randGen(config_.bin_center_y - config_.bin_size_y / 2,
-                                  config_.bin_center_y + config_.bin_size_y / 2);
-  grasp_pose.position.z = randGen(config_.bin_center_z - config_.bin_size_z / 2,
-                                  config_.bin_center_z + config_.bin_size_z / 2);
-
-  double grasp_roll = randGen(config_.roll_default - config_.roll_range / 2,
-                              config_.roll_default + config_.roll_range / 2);
-  double grasp_pitch = randGen(config_.pitch_default - config_.pitch_range / 2,
-                               config_.pitch_default + config_.pitch_range / 2);
-  double grasp_yaw = randGen(config_.yaw_default - config_.yaw_range / 2,
-                             config_.yaw_default + config_.yaw_range / 2);
-
   tf::Quaternion grasp_orientation;
-  grasp_orientation.setRPY(grasp_roll, grasp_pitch, grasp_yaw);
-  grasp_pose.orientation.x = grasp_orientation.getX();
-  grasp_pose.orientation.y = grasp_orientation.getY();
-  grasp_pose.orientation.z = grasp_orientation.getZ();
-  grasp_pose.orientation.w = grasp_orientation.getW();
+
+  if (pile_)
+  {
+    // Random exposed part, single service has no pick feedback so it is removed right away
+    std::vector<PileGrasp> grasps;
+    if (!exposedPileGrasps(grasps))
+      return false;
+
+    double u;
+    requestEngine(0)->uniform(&u, 1);
+    const PileGrasp& grasp = grasps[std::min(static_cast<std::size_t>(u * grasps.size()), grasps.size() - 1)];
+    grasp_pose = grasp.grasp_pose;
+    tf::quaternionMsgToTF(grasp_pose.orientation, grasp_orientation);
+
+    pile_->remove(grasp.part_id);
+    visualizePile();
+  }
+  else
+  {
+    // Resample unreachable poses, the last one is used when none is reachable
+    RandomEnginePtr engine = requestEngine(0);
+    for (int attempt = 0; attempt < max_resample_rounds_; attempt++)
+    {
+      PoseSamples samples;
+      samplePoses(*engine, 1, samples);
+
+      grasp_pose.position.x = samples.x[0];
+      grasp_pose.position.y = samples.y[0];
+      grasp_pose.position.z = samples.z[0];
+
+      double grasp_roll = samples.roll[0];
+      double grasp_pitch = samples.pitch[0];
+      double grasp_yaw = samples.yaw[0];
+
+      grasp_orientation.setRPY(grasp_roll, grasp_pitch, grasp_yaw);
+      grasp_pose.orientation.x = grasp_orientation.getX();
+      grasp_pose.orientation.y = grasp_orientation.getY();
+      grasp_pose.orientation.z = grasp_orientation.getZ();
+      grasp_pose.orientation.w = grasp_orientation.getW();
+
+      double q[4] = { grasp_pose.orientation.x, grasp_pose.orientation.y, grasp_pose.orientation.z,
+                      grasp_pose.orientation.w };
+      if (isReachable(grasp_pose.position.x, grasp_pose.position.y, grasp_pose.position.z, q))
+        break;
+
+      if (attempt + 1 == max_resample_rounds_)
+        ROS_WARN("BIN POSE EMULATOR: No reachable grasp pose found, returning unreachable one");
+    }
+  }
 
   res.grasp_pose = grasp_pose;
 
@@ -93,40 +198,255 @@ bool BinPoseEmulator::callback(bin_pose_msgs::bin_pose::Request& req,
   return true;
 }
 
-double BinPoseEmulator::randGen(double fMin, double fMax)
+bool BinPoseEmulator::batchCallback(bin_pose_msgs::bin_pose_batch::Request& req,
+                                    bin_pose_msgs::bin_pose_batch::Response& res)
+{
+  // Candidates are ranked by score, pile mode ranks all exposed parts and returns the best ones
+  std::size_t count = req.count;
+  if (count == 0)
+    return true;
+
+  if (count > static_cast<std::size_t>(max_batch_size_))
+  {
+    ROS_ERROR("BIN POSE EMULATOR: Requested %zu grasp poses, max_batch_size is %d", count, max_batch_size_);
+    return false;
+  }
+
+  GraspBatch grasps;
+  ScoringObstacles obstacles;
+  obstacles.radius = 0;
+
+  if (pile_)
+  {
+    //-----------------------------------------------------------------------------------------
+    // Grasp poses of exposed pile parts, other parts are obstacles of the approach path
+    std::vector<PileGrasp> pile_grasps;
+    if (!exposedPileGrasps(pile_grasps))
+      return false;
+
+    count = pile_grasps.size();
+    grasps.resize(count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+      const geometry_msgs::Pose& pose = pile_grasps[i].grasp_pose;
+      grasps.x[i] = pose.position.x;
+      grasps.y[i] = pose.position.y;
+      grasps.z[i] = pose.position.z;
+      grasps.qx[i] = pose.orientation.x;
+      grasps.qy[i] = pose.orientation.y;
+      grasps.qz[i] = pose.orientation.z;
+      grasps.qw[i] = pose.orientation.w;
+      grasps.part_ids[i] = pile_grasps[i].part_id;
+    }
+
+    // Parts are approximated by inscribed spheres
+    tf::Vector3 part_size = pile_->partSize();
+    const std::vector<PilePart>& parts = pile_->parts();
+    obstacles.radius = std::min(part_size.x(), std::min(part_size.y(), part_size.z())) / 2;
+    for (std::size_t i = 0; i < parts.size(); i++)
+    {
+      obstacles.x.push_back(parts[i].center.x());
+      obstacles.y.push_back(parts[i].center.y());
+      obstacles.z.push_back(parts[i].center.z());
+      obstacles.part_ids.push_back(parts[i].id);
+    }
+  }
+  else
+  {
+    //-----------------------------------------------------------------------------------------
+    // Generate random Grasp poses, unreachable ones are replaced in following rounds
+    RandomEnginePtr engine = requestEngine(req.seed);
+    for (int round = 0; grasps.size() < count && round < max_resample_rounds_; round++)
+    {
+      PoseSamples samples;
+      samplePoses(*engine, count - grasps.size(), samples);
+
+      GraspBatch sampled;
+      rpyToQuaternion(samples, sampled);
+
+      for (std::size_t i = 0; i < sampled.size(); i++)
+      {
+        double q[4] = { sampled.qx[i], sampled.qy[i], sampled.qz[i], sampled.qw[i] };
+        if (!isReachable(sampled.x[i], sampled.y[i], sampled.z[i], q))
+          continue;
+
+        grasps.x.push_back(sampled.x[i]);
+        grasps.y.push_back(sampled.y[i]);
+        grasps.z.push_back(sampled.z[i]);
+        grasps.qx.push_back(q[0]);
+        grasps.qy.push_back(q[1]);
+        grasps.qz.push_back(q[2]);
+        grasps.qw.push_back(q[3]);
+      }
+    }
+
+    count = grasps.size();
+    grasps.part_ids.assign(count, 0);
+    if (count == 0)
+    {
+      ROS_WARN("BIN POSE EMULATOR: No reachable grasp pose found");
+      return false;
+    }
+  }
+
+  //------------------------------------------------------------------------------------------
+  // Score candidates, the most promising grasp is planned first
+  std::vector<double> scores;
+  std::vector<std::size_t> ranking;
+  scorer_->score(grasps, obstacles, scores);
+  GraspScorer::rank(scores, ranking);
+
+  //------------------------------------------------------------------------------------------
+  // Calculate Approach and Deapproach poses of all candidates
+  ApproachBatch poses;
+  deriveApproachPoses(grasps, config_.approach_distance, config_.deapproach_height, poses);
+
+  //------------------------------------------------------------------------------------------
+  // Compose response in ranked order
+  std::size_t response_count = std::min<std::size_t>(req.count, count);
+  res.grasp_poses.resize(response_count);
+  res.approach_poses.resize(response_count);
+  res.deapproach_poses.resize(response_count);
+  res.scores.resize(response_count);
+  res.part_ids.resize(response_count);
+
+  for (std::size_t k = 0; k < response_count; k++)
+  {
+    std::size_t i = ranking[k];
+
+    geometry_msgs::Pose& grasp_pose = res.grasp_poses[k];
+    grasp_pose.position.x = grasps.x[i];
+    grasp_pose.position.y = grasps.y[i];
+    grasp_pose.position.z = grasps.z[i];
+    grasp_pose.orientation.x = grasps.qx[i];
+    grasp_pose.orientation.y = grasps.qy[i];
+    grasp_pose.orientation.z = grasps.qz[i];
+    grasp_pose.orientation.w = grasps.qw[i];
+
+    geometry_msgs::Pose& approach_pose = res.approach_poses[k];
+    approach_pose.position.x = poses.approach_x[i];
+    approach_pose.position.y = poses.approach_y[i];
+    approach_pose.position.z = poses.approach_z[i];
+    approach_pose.orientation = grasp_pose.orientation;
+
+    geometry_msgs::Pose& deapproach_pose = res.deapproach_poses[k];
+    deapproach_pose = grasp_pose;
+    deapproach_pose.position.z = poses.deapproach_z[i];
+
+    res.scores[k] = scores[i];
+    res.part_ids[k] = grasps.part_ids[i];
+  }
+
+  visualizeBin();
+  visualizePose(res.grasp_poses[0], res.approach_poses[0]);
+  broadcastPoseTF(res.grasp_poses[0]);
+
+  return true;
+}
+
+bool BinPoseEmulator::pickResultCallback(bin_pose_msgs::bin_pose_pick_result::Request& req,
+                                         bin_pose_msgs::bin_pose_pick_result::Response& res)
 {
-  double f = (double)rand() / RAND_MAX;
-  return fMin + f * (fMax - fMin);
+  res.success = true;
+  if (pile_ && req.success)
+  {
+    res.success = pile_->remove(req.part_id);
+    visualizePile();
+  }
+
+  res.remaining_parts = pile_ ? pile_->size() : 0;
+  return true;
 }
 
-bool BinPoseEmulator::parseConfig(std::string filepath)
+bool BinPoseEmulator::exposedPileGrasps(std::vector<PileGrasp>& grasps)
 {
-  try
+  for (int attempt = 0; attempt < 2; attempt++)
   {
-    YAML::Node config_file = YAML::LoadFile(filepath);
-    config_.bin_center_x = config_file["bin_center_x"].as<float>();
-    config_.bin_center_y = config_file["bin_center_y"].as<float>();
-    config_.bin_center_z = config_file["bin_center_z"].as<float>();
+    // Bin emptied or no part can be grasped, refill it
+    if (attempt > 0)
+    {
+      std::size_t parts = pile_->generate(*requestEngine(0));
+      ROS_INFO("BIN POSE EMULATOR: No exposed part left, generated new pile of %zu parts", parts);
+      visualizePile();
+    }
+
+    pile_->exposedGrasps(grasps);
+
+    std::size_t reachable = 0;
+    for (std::size_t i = 0; i < grasps.size(); i++)
+    {
+      const geometry_msgs::Pose& pose = grasps[i].grasp_pose;
+      double q[4] = { pose.orientation.x, pose.orientation.y, pose.orientation.z, pose.orientation.w };
+      if (isReachable(pose.position.x, pose.position.y, pose.position.z, q))
+        grasps[reachable++] = grasps[i];
+    }
+    grasps.resize(reachable);
+
+    if (!grasps.empty())
+      return true;
+  }
+  return false;
+}
+
+bool BinPoseEmulator::isReachable(double x, double y, double z, const double q[4]) const
+{
+  if (reachability_map_.empty())
+    return true;
+
+  // Approach pose lies on tool Z axis, the third column of the rotation matrix
+  double ax = x - config_.approach_distance * 2 * (q[0] * q[2] + q[3] * q[1]);
+  double ay = y - config_.approach_distance * 2 * (q[1] * q[2] - q[3] * q[0]);
+  double az = z - config_.approach_distance * (1 - 2 * (q[0] * q[0] + q[1] * q[1]));
+
+  return reachability_map_.reachable(x, y, z, q[0], q[1], q[2], q[3]) &&
+         reachability_map_.reachable(ax, ay, az, q[0], q[1], q[2], q[3]);
+}
 
-    config_.bin_size_x = config_file["bin_size_x"].as<float>();
-    config_.bin_size_y = config_file["bin_size_y"].as<float>();
-    config_.bin_size_z = config_file["bin_size_z"].as<float>();
+RandomEnginePtr BinPoseEmulator::requestEngine(uint32_t request_seed)
+{
+  RandomEnginePtr engine = createRandomEngine(random_engine_);
 
-    config_.roll_default = config_file["roll_default"].as<float>();
-    config_.pitch_default = config_file["pitch_default"].as<float>();
-    config_.yaw_default = config_file["yaw_default"].as<float>();
+  // Seeded requests are reproducible on their own, others follow node seed
+  if (request_seed != 0)
+    engine->seed(request_seed, 0);
+  else
+    engine->seed(seed_, stream_++);
 
-    config_.roll_range = config_file["roll_range"].as<float>();
-    config_.pitch_range = config_file["pitch_range"].as<float>();
-    config_.yaw_range = config_file["yaw_range"].as<float>();
+  return engine;
+}
 
-    config_.approach_distance = config_file["approach_distance"].as<float>();
-    config_.deapproach_height = config_file["deapproach_height"].as<float>();
+void BinPoseEmulator::samplePoses(RandomEngine& engine, std::size_t count, PoseSamples& samples)
+{
+  // All six degrees of freedom are drawn at once, pose i uses values 6i..6i+5
+  // so the first poses do not depend on the requested count
+  std::vector<double> uniform(6 * count);
+  engine.uniform(uniform.data(), uniform.size());
+
+  const double centers[6] = { config_.bin_center_x, config_.bin_center_y, config_.bin_center_z,
+                              config_.roll_default, config_.pitch_default, config_.yaw_default };
+  const double ranges[6] = { config_.bin_size_x, config_.bin_size_y, config_.bin_size_z,
+                             config_.roll_range, config_.pitch_range, config_.yaw_range };
+  std::vector<double>* dofs[6] = { &samples.x, &samples.y, &samples.z,
+                                   &samples.roll, &samples.pitch, &samples.yaw };
+
+  for (int d = 0; d < 6; d++)
+  {
+    std::vector<double>& dof = *dofs[d];
+    dof.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+      dof[i] = centers[d] + (uniform[6 * i + d] - 0.5) * ranges[d];
   }
-  catch (YAML::ParserException& e)
+}
+
+bool BinPoseEmulator::parseConfig(std::string filepath)
+{
+  if (!loadConfigData(filepath, config_))
   {
     ROS_ERROR("Bin pose emulator: Error reading yaml config file");
+    return false;
   }
+  return true;
 }
 
 void BinPoseEmulator::visualizeBin(void)
@@ -199,6 +519,50 @@ void BinPoseEmulator::visualizePose(geometry_msgs::Pose grasp_pose,
   marker_pub_.publish(marker);
 }
 
+void BinPoseEmulator::visualizePile(void)
+{
+  visualization_msgs::MarkerArrayPtr markers(new visualization_msgs::MarkerArray());
+
+  // Remove parts picked since last update
+  visualization_msgs::Marker clear;
+  clear.header.frame_id = "/base_link";
+  clear.ns = "pile";
+  clear.action = visualization_msgs::Marker::DELETEALL;
+  markers->markers.push_back(clear);
+
+  tf::Vector3 part_size = pile_->partSize();
+  const std::vector<PilePart>& parts = pile_->parts();
+  for (std::size_t i = 0; i < parts.size(); i++)
+  {
+    visualization_msgs::Marker marker;
+    marker.header.frame_id = "/base_link";
+    marker.header.stamp = ros::Time::now();
+
+    marker.ns = "pile";
+    marker.id = parts[i].id;
+    marker.type = visualization_msgs::Marker::CUBE;
+    marker.action = visualization_msgs::Marker::ADD;
+
+    tf::Quaternion orientation;
+    parts[i].rotation.getRotation(orientation);
+    tf::pointTFToMsg(parts[i].center, marker.pose.position);
+    tf::quaternionTFToMsg(orientation, marker.pose.orientation);
+
+    marker.scale.x = part_size.x();
+    marker.scale.y = part_size.y();
+    marker.scale.z = part_size.z();
+
+    marker.color.r = 0.2f;
+    marker.color.g = 0.6f;
+    marker.color.b = 0.9f;
+    marker.color.a = 1.0;
+
+    markers->markers.push_back(marker);
+  }
+
+  pile_pub_.publish(markers);
+}
+
 void BinPoseEmulator::broadcastPoseTF(geometry_msgs::Pose grasp_pose)
 {
   static tf::TransformBroadcaster br;
@@ -213,24 +577,3 @@ void BinPoseEmulator::broadcastPoseTF(geometry_msgs::Pose grasp_pose)
   br.sendTransform(tf::StampedTransform(transform, ros::Time::now(),
                                         "base_link", "current_goal"));
 }
-
-int main(int argc, char* argv[])
-{
-  ros::init(argc, argv, "bin_pose_emulator");
-  ros::NodeHandle nh;
-
-  // Get config filepath from ROS Param server
-  std::string filepath;
-  nh.getParam("filepath", filepath);
-
-  // Create emulator object
-  BinPoseEmulator emulator(&nh, filepath);
-
-  // Advertise service
-  ros::ServiceServer service =
-      nh.advertiseService("bin_pose", &BinPoseEmulator::callback, &emulator);
-
-  ros::spin();
-
-  return EXIT_SUCCESS;
-}
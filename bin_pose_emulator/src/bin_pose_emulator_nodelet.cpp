@@ -0,0 +1,55 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Bin pose emulator loadable into a nodelet manager together with the other
+// emulator nodes, topics are then passed as shared pointers without
+// serialization. Standalone executable is built from bin_pose_emulator_node.cpp.
+
+#include "bin_pose_emulator/bin_pose_emulator.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+
+namespace bin_pose_emulator
+{
+class BinPoseEmulatorNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    // Single threaded queue, callbacks are not reentrant same as in the standalone node
+    ros::NodeHandle& nh = getNodeHandle();
+
+    std::string filepath;
+    nh.getParam("filepath", filepath);
+    emulator_.reset(new BinPoseEmulator(&nh, filepath, getPrivateNodeHandle()));
+
+    service_ = nh.advertiseService("bin_pose", &BinPoseEmulator::callback, emulator_.get());
+    batch_service_ = nh.advertiseService("bin_pose_batch", &BinPoseEmulator::batchCallback, emulator_.get());
+    pick_result_service_ =
+        nh.advertiseService("bin_pose_pick_result", &BinPoseEmulator::pickResultCallback, emulator_.get());
+  }
+
+  std::shared_ptr<BinPoseEmulator> emulator_;
+  ros::ServiceServer service_;
+  ros::ServiceServer batch_service_;
+  ros::ServiceServer pick_result_service_;
+};
+}  // namespace bin_pose_emulator
+
+PLUGINLIB_EXPORT_CLASS(bin_pose_emulator::BinPoseEmulatorNodelet, nodelet::Nodelet)
@@ -0,0 +1,50 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/config_data.h"
+
+#include <yaml-cpp/yaml.h>
+
+bool loadConfigData(const std::string& filepath, ConfigData& config)
+{
+  try
+  {
+    YAML::Node config_file = YAML::LoadFile(filepath);
+    config.bin_center_x = config_file["bin_center_x"].as<float>();
+    config.bin_center_y = config_file["bin_center_y"].as<float>();
+    config.bin_center_z = config_file["bin_center_z"].as<float>();
+
+    config.bin_size_x = config_file["bin_size_x"].as<float>();
+    config.bin_size_y = config_file["bin_size_y"].as<float>();
+    config.bin_size_z = config_file["bin_size_z"].as<float>();
+
+    config.roll_default = config_file["roll_default"].as<float>();
+    config.pitch_default = config_file["pitch_default"].as<float>();
+    config.yaw_default = config_file["yaw_default"].as<float>();
+
+    config.roll_range = config_file["roll_range"].as<float>();
+    config.pitch_range = config_file["pitch_range"].as<float>();
+    config.yaw_range = config_file["yaw_range"].as<float>();
+
+    config.approach_distance = config_file["approach_distance"].as<float>();
+    config.deapproach_height = config_file["deapproach_height"].as<float>();
+  }
+  catch (YAML::Exception& e)
+  {
+    return false;
+  }
+  return true;
+}
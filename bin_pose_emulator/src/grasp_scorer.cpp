@@ -0,0 +1,215 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/grasp_scorer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+struct BinGeometry
+{
+  double center_x, center_y;
+  double half_x, half_y;
+  double bottom, rim, inv_height;
+  double approach_distance;
+};
+
+struct FeatureWeights
+{
+  double default_x, default_y, default_z;  // tool Z axis of default orientation
+  double cos_max_tilt, inv_tilt_range;
+  double inv_wall_margin;
+  double wall, tilt, height;
+};
+
+// Value based min and clamp, compiled to vector min/max without branches
+inline double minimum(double a, double b)
+{
+  return a < b ? a : b;
+}
+
+inline double clamp01(double value)
+{
+  return minimum(value < 0 ? 0 : value, 1);
+}
+
+//-----------------------------------------------------------------------------------------
+// Kernels work on restrict qualified arrays, otherwise alias checks of all
+// input and output pairs keep the compiler from vectorizing them
+
+// Weighted wall, tilt and height features, approach segments and wall clearance of approach points.
+// Tool Z axis is the third column of the rotation matrix
+void poseFeatures(const BinGeometry& bin, const FeatureWeights& features, std::size_t count,
+                  const double* __restrict__ x, const double* __restrict__ y, const double* __restrict__ z,
+                  const double* __restrict__ qx, const double* __restrict__ qy, const double* __restrict__ qz,
+                  const double* __restrict__ qw, double* __restrict__ dx, double* __restrict__ dy,
+                  double* __restrict__ dz, double* __restrict__ clearance, double* __restrict__ out)
+{
+  const BinGeometry b = bin;
+  const FeatureWeights f = features;
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double axis_x = 2 * (qx[i] * qz[i] + qw[i] * qy[i]);
+    double axis_y = 2 * (qy[i] * qz[i] - qw[i] * qx[i]);
+    double axis_z = 1 - 2 * (qx[i] * qx[i] + qy[i] * qy[i]);
+
+    double cos_tilt = axis_x * f.default_x + axis_y * f.default_y + axis_z * f.default_z;
+    double tilt = clamp01((cos_tilt - f.cos_max_tilt) * f.inv_tilt_range);
+
+    double wall_distance = minimum(b.half_x - fabs(x[i] - b.center_x), b.half_y - fabs(y[i] - b.center_y));
+    double wall = clamp01(wall_distance * f.inv_wall_margin);
+
+    double height = clamp01((z[i] - b.bottom) * b.inv_height);
+
+    double segment_x = -b.approach_distance * axis_x;
+    double segment_y = -b.approach_distance * axis_y;
+    double segment_z = -b.approach_distance * axis_z;
+    dx[i] = segment_x;
+    dy[i] = segment_y;
+    dz[i] = segment_z;
+
+    // Approach point below the rim has to keep off the walls
+    double approach_wall = minimum(b.half_x - fabs(x[i] + segment_x - b.center_x),
+                                   b.half_y - fabs(y[i] + segment_y - b.center_y));
+    clearance[i] = z[i] + segment_z < b.rim ? approach_wall : std::numeric_limits<double>::infinity();
+
+    out[i] = f.wall * wall + f.tilt * tilt + f.height * height;
+  }
+}
+
+// Squared distance of approach segments to an obstacle center, grasped part itself is
+// not an obstacle. Pile part ids start at 1, so candidates without a part never match
+void obstacleDistances(double ox, double oy, double oz, double obstacle_id, double inv_length2, std::size_t count,
+                       const double* __restrict__ x, const double* __restrict__ y, const double* __restrict__ z,
+                       const double* __restrict__ dx, const double* __restrict__ dy, const double* __restrict__ dz,
+                       const double* __restrict__ part_ids, double* __restrict__ distance2)
+{
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double px = ox - x[i], py = oy - y[i], pz = oz - z[i];
+    double t = clamp01((px * dx[i] + py * dy[i] + pz * dz[i]) * inv_length2);
+    double ex = px - t * dx[i], ey = py - t * dy[i], ez = pz - t * dz[i];
+    double d2 = minimum(distance2[i], ex * ex + ey * ey + ez * ez);
+    distance2[i] = part_ids[i] == obstacle_id ? distance2[i] : d2;
+  }
+}
+
+// Clearance feature and weighted mean of all features
+void combineFeatures(double radius, double inv_clearance_margin, double weight_clearance, double inv_weight_sum,
+                     std::size_t count, const double* __restrict__ clearance,
+                     const double* __restrict__ obstacle_distance2, double* __restrict__ out)
+{
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double free_distance = minimum(clearance[i], sqrt(obstacle_distance2[i]) - radius);
+    double free = clamp01(free_distance * inv_clearance_margin);
+    out[i] = (out[i] + weight_clearance * free) * inv_weight_sum;
+  }
+}
+}  // namespace
+
+GraspScorer::GraspScorer(const ConfigData& config, const ScoringWeights& weights, double max_tilt,
+                         double wall_margin, double clearance_margin)
+  : config_(config)
+  , weights_(weights)
+  , cos_max_tilt_(cos(std::min(std::max(max_tilt, 0.0), M_PI)))
+  , wall_margin_(std::max(wall_margin, 1e-6))
+  , clearance_margin_(std::max(clearance_margin, 1e-6))
+{
+  // RPY to quaternion, same convention as tf::Quaternion::setRPY
+  double cr = cos(config.roll_default / 2), sr = sin(config.roll_default / 2);
+  double cp = cos(config.pitch_default / 2), sp = sin(config.pitch_default / 2);
+  double cy = cos(config.yaw_default / 2), sy = sin(config.yaw_default / 2);
+  double qx = sr * cp * cy - cr * sp * sy, qy = cr * sp * cy + sr * cp * sy;
+  double qz = cr * cp * sy - sr * sp * cy, qw = cr * cp * cy + sr * sp * sy;
+
+  default_axis_[0] = 2 * (qx * qz + qw * qy);
+  default_axis_[1] = 2 * (qy * qz - qw * qx);
+  default_axis_[2] = 1 - 2 * (qx * qx + qy * qy);
+}
+
+GraspScorer::~GraspScorer()
+{
+}
+
+void GraspScorer::score(const GraspBatch& grasps, const ScoringObstacles& obstacles,
+                        std::vector<double>& scores) const
+{
+  const std::size_t count = grasps.size();
+  scores.resize(count);
+  if (count == 0)
+    return;
+
+  BinGeometry bin;
+  bin.center_x = config_.bin_center_x;
+  bin.center_y = config_.bin_center_y;
+  bin.half_x = config_.bin_size_x / 2;
+  bin.half_y = config_.bin_size_y / 2;
+  bin.bottom = config_.bin_center_z - config_.bin_size_z / 2;
+  bin.rim = bin.bottom + config_.bin_size_z;
+  bin.inv_height = config_.bin_size_z > 0 ? 1 / config_.bin_size_z : 0;
+  bin.approach_distance = config_.approach_distance;
+
+  FeatureWeights features;
+  features.default_x = default_axis_[0];
+  features.default_y = default_axis_[1];
+  features.default_z = default_axis_[2];
+  features.cos_max_tilt = cos_max_tilt_;
+  features.inv_tilt_range = 1 / std::max(1 - cos_max_tilt_, 1e-9);
+  features.inv_wall_margin = 1 / wall_margin_;
+  features.wall = weights_.wall;
+  features.tilt = weights_.tilt;
+  features.height = weights_.height;
+
+  // Approach segment from grasp point against tool Z axis, clearance to walls and obstacles.
+  // Part ids as doubles keep the obstacle loop free of mixed type selects
+  std::vector<double> buffer(6 * count);
+  double* dx = buffer.data();
+  double* dy = dx + count;
+  double* dz = dy + count;
+  double* clearance = dz + count;
+  double* obstacle_distance2 = clearance + count;
+  double* part_ids = obstacle_distance2 + count;
+  std::fill(obstacle_distance2, obstacle_distance2 + count, std::numeric_limits<double>::infinity());
+  std::copy(grasps.part_ids.begin(), grasps.part_ids.end(), part_ids);
+
+  poseFeatures(bin, features, count, grasps.x.data(), grasps.y.data(), grasps.z.data(), grasps.qx.data(),
+               grasps.qy.data(), grasps.qz.data(), grasps.qw.data(), dx, dy, dz, clearance, scores.data());
+
+  // Obstacle by obstacle, so the inner loop runs over candidate arrays
+  const double distance = config_.approach_distance;
+  const double inv_length2 = distance > 0 ? 1 / (distance * distance) : 0;
+  for (std::size_t j = 0; j < obstacles.x.size(); j++)
+    obstacleDistances(obstacles.x[j], obstacles.y[j], obstacles.z[j], obstacles.part_ids[j], inv_length2, count,
+                      grasps.x.data(), grasps.y.data(), grasps.z.data(), dx, dy, dz, part_ids, obstacle_distance2);
+
+  double weight_sum = weights_.wall + weights_.tilt + weights_.height + weights_.clearance;
+  combineFeatures(obstacles.radius, 1 / clearance_margin_, weights_.clearance, weight_sum > 0 ? 1 / weight_sum : 1,
+                  count, clearance, obstacle_distance2, scores.data());
+}
+
+void GraspScorer::rank(const std::vector<double>& scores, std::vector<std::size_t>& ranking)
+{
+  ranking.resize(scores.size());
+  for (std::size_t i = 0; i < ranking.size(); i++)
+    ranking[i] = i;
+  std::stable_sort(ranking.begin(), ranking.end(),
+                   [&scores](std::size_t a, std::size_t b) { return scores[a] > scores[b]; });
+}
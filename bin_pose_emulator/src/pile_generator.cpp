@@ -0,0 +1,378 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/pile_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+PileGenerator::PileGenerator(const ConfigData& config, const tf::Vector3& part_size, std::size_t num_of_parts,
+                             double max_part_tilt, double max_grasp_tilt)
+  : config_(config)
+  , half_size_(part_size / 2)
+  , num_of_parts_(num_of_parts)
+  , max_part_tilt_(max_part_tilt)
+  , max_grasp_tilt_(max_grasp_tilt)
+  , next_id_(1)
+{
+  default_orientation_.setRPY(config_.roll_default, config_.pitch_default, config_.yaw_default);
+
+  // Every part overlaps at most 8 cells
+  cell_size_ = 2 * half_size_.length();
+}
+
+PileGenerator::~PileGenerator()
+{
+}
+
+std::size_t PileGenerator::generate(RandomEngine& engine)
+{
+  parts_.clear();
+  hash_.clear();
+
+  // Resting on one of six faces, index is (axis, sign)
+  const double rest_rpy[6][3] = { { 0, -M_PI / 2, 0 }, { M_PI / 2, 0, 0 }, { 0, 0, 0 },
+                                  { 0, M_PI / 2, 0 },  { -M_PI / 2, 0, 0 }, { M_PI, 0, 0 } };
+
+  // Parts that do not fit are retried at other places
+  std::size_t attempts = 0;
+  while (parts_.size() < num_of_parts_ && attempts++ < 10 * num_of_parts_)
+  {
+    double u[6];
+    engine.uniform(u, 6);
+
+    int face = std::min(static_cast<int>(u[2] * 6), 5);
+    tf::Matrix3x3 rest;
+    rest.setRPY(rest_rpy[face][0], rest_rpy[face][1], rest_rpy[face][2]);
+
+    double tilt_direction = u[4] * 2 * M_PI;
+    tf::Matrix3x3 tilt(tf::Quaternion(tf::Vector3(cos(tilt_direction), sin(tilt_direction), 0),
+                                      u[3] * max_part_tilt_));
+
+    PilePart part;
+    part.id = next_id_;
+    part.yaw = u[5] * 2 * M_PI - M_PI;
+    tf::Matrix3x3 yaw;
+    yaw.setRPY(0, 0, part.yaw);
+    part.rotation = yaw * tilt * rest;
+
+    // Whole part has to be between bin walls
+    tf::Vector3 extents = aabbHalfExtents(part);
+    double free_x = config_.bin_size_x - 2 * extents.x();
+    double free_y = config_.bin_size_y - 2 * extents.y();
+    if (free_x < 0 || free_y < 0)
+      continue;
+
+    part.center.setX(config_.bin_center_x - free_x / 2 + u[0] * free_x);
+    part.center.setY(config_.bin_center_y - free_y / 2 + u[1] * free_y);
+
+    if (!drop(part))
+      continue;
+
+    parts_.push_back(part);
+    next_id_++;
+    insertIntoHash(parts_.size() - 1);
+  }
+
+  return parts_.size();
+}
+
+void PileGenerator::exposedGrasps(std::vector<PileGrasp>& grasps) const
+{
+  grasps.clear();
+  const tf::Vector3 vertical(0, 0, 1);
+
+  for (std::size_t p = 0; p < parts_.size(); p++)
+  {
+    const PilePart& part = parts_[p];
+
+    // Top face is the one with normal closest to vertical axis
+    int axis = 0;
+    for (int i = 1; i < 3; i++)
+      if (fabs(part.rotation[2][i]) > fabs(part.rotation[2][axis]))
+        axis = i;
+
+    tf::Vector3 normal = part.rotation.getColumn(axis);
+    if (normal.z() < 0)
+      normal = -normal;
+
+    double tilt = acos(std::min(1.0, normal.z()));
+    if (tilt > max_grasp_tilt_)
+      continue;
+
+    // Approach along face normal and vertical deapproach have to be free
+    tf::Vector3 grasp_point = part.center + normal * half_size_[axis];
+    tf::Vector3 start = grasp_point + normal * 1e-3;
+    tf::Vector3 approach_point = grasp_point + normal * config_.approach_distance;
+    tf::Vector3 deapproach_point = grasp_point + vertical * config_.deapproach_height;
+
+    tf::Vector3 min = start, max = start;
+    min.setMin(approach_point);
+    min.setMin(deapproach_point);
+    max.setMax(approach_point);
+    max.setMax(deapproach_point);
+
+    std::vector<std::size_t> indices;
+    neighbours(min, max, indices);
+
+    bool blocked = false;
+    for (std::size_t i = 0; i < indices.size() && !blocked; i++)
+    {
+      if (indices[i] == p)
+        continue;
+      blocked = segmentHitsPart(start, approach_point, parts_[indices[i]]) ||
+                segmentHitsPart(start, deapproach_point, parts_[indices[i]]);
+    }
+    if (blocked)
+      continue;
+
+    // Default tool orientation tilted to the face normal and turned by part yaw
+    tf::Quaternion align(tf::Quaternion::getIdentity());
+    tf::Vector3 align_axis = vertical.cross(normal);
+    if (align_axis.length() > 1e-9)
+      align = tf::Quaternion(align_axis.normalized(), tilt);
+
+    tf::Quaternion yaw;
+    yaw.setRPY(0, 0, part.yaw);
+    tf::Quaternion orientation = align * yaw * default_orientation_;
+
+    PileGrasp grasp;
+    grasp.part_id = part.id;
+    grasp.tilt = tilt;
+    grasp.grasp_pose.position.x = grasp_point.x();
+    grasp.grasp_pose.position.y = grasp_point.y();
+    grasp.grasp_pose.position.z = grasp_point.z();
+    grasp.grasp_pose.orientation.x = orientation.x();
+    grasp.grasp_pose.orientation.y = orientation.y();
+    grasp.grasp_pose.orientation.z = orientation.z();
+    grasp.grasp_pose.orientation.w = orientation.w();
+    grasps.push_back(grasp);
+  }
+}
+
+bool PileGenerator::remove(uint32_t part_id)
+{
+  for (std::size_t i = 0; i < parts_.size(); i++)
+  {
+    if (parts_[i].id == part_id)
+    {
+      // Parts above are left in place, the pile does not collapse
+      parts_.erase(parts_.begin() + i);
+      rebuildHash();
+      return true;
+    }
+  }
+  return false;
+}
+
+std::size_t PileGenerator::size() const
+{
+  return parts_.size();
+}
+
+const std::vector<PilePart>& PileGenerator::parts() const
+{
+  return parts_;
+}
+
+tf::Vector3 PileGenerator::partSize() const
+{
+  return half_size_ * 2;
+}
+
+bool PileGenerator::drop(PilePart& part)
+{
+  tf::Vector3 extents = aabbHalfExtents(part);
+  double bottom = config_.bin_center_z - config_.bin_size_z / 2;
+  double top = config_.bin_center_z + config_.bin_size_z / 2;
+
+  // Only parts in the column below the bin rim can support the dropped one
+  std::vector<std::size_t> indices;
+  neighbours(tf::Vector3(part.center.x() - extents.x(), part.center.y() - extents.y(), bottom),
+             tf::Vector3(part.center.x() + extents.x(), part.center.y() + extents.y(), top + 2 * cell_size_),
+             indices);
+
+  // Start above all parts of the column, no enclosed pocket below the pile surface is reachable
+  double lowest = bottom + extents.z();
+  double z = lowest;
+  for (std::size_t i = 0; i < indices.size(); i++)
+  {
+    const PilePart& other = parts_[indices[i]];
+    z = std::max(z, other.center.z() + aabbHalfExtents(other).z() + extents.z());
+  }
+
+  // Fall until the first contact or the bin floor
+  double step = std::min(half_size_.x(), std::min(half_size_.y(), half_size_.z())) / 2;
+  while (z > lowest)
+  {
+    double next = std::max(z - step, lowest);
+    part.center.setZ(next);
+
+    bool overlap = false;
+    for (std::size_t i = 0; i < indices.size() && !overlap; i++)
+      overlap = overlaps(part, parts_[indices[i]]);
+
+    if (overlap)
+      break;
+    z = next;
+  }
+
+  // Bottom of the part has to stay in the bin
+  part.center.setZ(z);
+  return z - extents.z() <= top;
+}
+
+bool PileGenerator::overlaps(const PilePart& a, const PilePart& b) const
+{
+  // Separating axis test of two oriented boxes of the same size
+  const double h[3] = { half_size_.x(), half_size_.y(), half_size_.z() };
+  const double epsilon = 1e-9;
+
+  tf::Vector3 a_axes[3], b_axes[3];
+  for (int i = 0; i < 3; i++)
+  {
+    a_axes[i] = a.rotation.getColumn(i);
+    b_axes[i] = b.rotation.getColumn(i);
+  }
+
+  double r[3][3], abs_r[3][3], t[3];
+  tf::Vector3 translation = b.center - a.center;
+  for (int i = 0; i < 3; i++)
+  {
+    t[i] = translation.dot(a_axes[i]);
+    for (int j = 0; j < 3; j++)
+    {
+      r[i][j] = a_axes[i].dot(b_axes[j]);
+      abs_r[i][j] = fabs(r[i][j]) + epsilon;
+    }
+  }
+
+  // Axes of a
+  for (int i = 0; i < 3; i++)
+    if (fabs(t[i]) > h[i] + h[0] * abs_r[i][0] + h[1] * abs_r[i][1] + h[2] * abs_r[i][2])
+      return false;
+
+  // Axes of b
+  for (int j = 0; j < 3; j++)
+  {
+    double projection = fabs(t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j]);
+    if (projection > h[0] * abs_r[0][j] + h[1] * abs_r[1][j] + h[2] * abs_r[2][j] + h[j])
+      return false;
+  }
+
+  // Cross products of axes
+  for (int i = 0; i < 3; i++)
+  {
+    int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; j++)
+    {
+      int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+      double ra = h[i1] * abs_r[i2][j] + h[i2] * abs_r[i1][j];
+      double rb = h[j1] * abs_r[i][j2] + h[j2] * abs_r[i][j1];
+      if (fabs(t[i2] * r[i1][j] - t[i1] * r[i2][j]) > ra + rb)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool PileGenerator::segmentHitsPart(const tf::Vector3& from, const tf::Vector3& to, const PilePart& part) const
+{
+  // Slab test in part frame
+  tf::Matrix3x3 inverse = part.rotation.transpose();
+  tf::Vector3 origin = inverse * (from - part.center);
+  tf::Vector3 direction = inverse * (to - from);
+
+  double t_min = 0, t_max = 1;
+  for (int i = 0; i < 3; i++)
+  {
+    if (fabs(direction[i]) < 1e-12)
+    {
+      if (fabs(origin[i]) > half_size_[i])
+        return false;
+      continue;
+    }
+
+    double t1 = (-half_size_[i] - origin[i]) / direction[i];
+    double t2 = (half_size_[i] - origin[i]) / direction[i];
+    t_min = std::max(t_min, std::min(t1, t2));
+    t_max = std::min(t_max, std::max(t1, t2));
+    if (t_min > t_max)
+      return false;
+  }
+  return true;
+}
+
+tf::Vector3 PileGenerator::aabbHalfExtents(const PilePart& part) const
+{
+  tf::Vector3 extents;
+  for (int i = 0; i < 3; i++)
+  {
+    tf::Vector3 row = part.rotation.getRow(i);
+    extents[i] = fabs(row.x()) * half_size_.x() + fabs(row.y()) * half_size_.y() + fabs(row.z()) * half_size_.z();
+  }
+  return extents;
+}
+
+void PileGenerator::neighbours(const tf::Vector3& min, const tf::Vector3& max, std::vector<std::size_t>& indices) const
+{
+  indices.clear();
+  int min_cell[3], max_cell[3];
+  for (int i = 0; i < 3; i++)
+  {
+    min_cell[i] = static_cast<int>(floor(min[i] / cell_size_));
+    max_cell[i] = static_cast<int>(floor(max[i] / cell_size_));
+  }
+
+  for (int x = min_cell[0]; x <= max_cell[0]; x++)
+    for (int y = min_cell[1]; y <= max_cell[1]; y++)
+      for (int z = min_cell[2]; z <= max_cell[2]; z++)
+      {
+        auto cell = hash_.find(cellKey(x, y, z));
+        if (cell != hash_.end())
+          indices.insert(indices.end(), cell->second.begin(), cell->second.end());
+      }
+
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+}
+
+int64_t PileGenerator::cellKey(int x, int y, int z) const
+{
+  // 21 bits per axis
+  const int64_t mask = (1 << 21) - 1;
+  return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+void PileGenerator::insertIntoHash(std::size_t index)
+{
+  tf::Vector3 extents = aabbHalfExtents(parts_[index]);
+  tf::Vector3 min = parts_[index].center - extents;
+  tf::Vector3 max = parts_[index].center + extents;
+
+  for (int x = floor(min.x() / cell_size_); x <= floor(max.x() / cell_size_); x++)
+    for (int y = floor(min.y() / cell_size_); y <= floor(max.y() / cell_size_); y++)
+      for (int z = floor(min.z() / cell_size_); z <= floor(max.z() / cell_size_); z++)
+        hash_[cellKey(x, y, z)].push_back(index);
+}
+
+void PileGenerator::rebuildHash()
+{
+  hash_.clear();
+  for (std::size_t p = 0; p < parts_.size(); p++)
+    insertIntoHash(p);
+}
@@ -0,0 +1,291 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/pose_batch.h"
+
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void GraspBatch::resize(std::size_t count)
+{
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  qx.resize(count);
+  qy.resize(count);
+  qz.resize(count);
+  qw.resize(count);
+  part_ids.resize(count, 0);
+}
+
+void ApproachBatch::resize(std::size_t count)
+{
+  approach_x.resize(count);
+  approach_y.resize(count);
+  approach_z.resize(count);
+  deapproach_z.resize(count);
+}
+
+namespace
+{
+//-----------------------------------------------------------------------------------------
+// Lanes of one register, kernels are written once against this interface.
+// Masks have all bits of a lane set or cleared, select takes b where mask is set
+
+struct ScalarLanes
+{
+  typedef double Vec;
+  typedef bool Mask;
+  static const std::size_t width = 1;
+
+  static Vec load(const double* p) { return *p; }
+  static void store(double* p, Vec a) { *p = a; }
+  static Vec set(double a) { return a; }
+  static Vec add(Vec a, Vec b) { return a + b; }
+  static Vec sub(Vec a, Vec b) { return a - b; }
+  static Vec mul(Vec a, Vec b) { return a * b; }
+  static Vec abs(Vec a) { return fabs(a); }
+  static Vec trunc(Vec a) { return std::trunc(a); }
+  static Mask equal(Vec a, Vec b) { return a == b; }
+  static Mask less(Vec a, Vec b) { return a < b; }
+  static Mask greaterEqual(Vec a, Vec b) { return a >= b; }
+  static Mask either(Mask a, Mask b) { return a || b; }
+  static Vec select(Mask mask, Vec a, Vec b) { return mask ? b : a; }
+  static Vec negateIf(Mask mask, Vec a) { return mask ? -a : a; }
+};
+
+#if defined(__SSE2__)
+struct Sse2Lanes
+{
+  typedef __m128d Vec;
+  typedef __m128d Mask;
+  static const std::size_t width = 2;
+
+  static Vec load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, Vec a) { _mm_storeu_pd(p, a); }
+  static Vec set(double a) { return _mm_set1_pd(a); }
+  static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+  static Vec abs(Vec a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+  // SSE2 has no rounding instruction, round trip through int32 is exact below 2^31
+  static Vec trunc(Vec a) { return _mm_cvtepi32_pd(_mm_cvttpd_epi32(a)); }
+  static Mask equal(Vec a, Vec b) { return _mm_cmpeq_pd(a, b); }
+  static Mask less(Vec a, Vec b) { return _mm_cmplt_pd(a, b); }
+  static Mask greaterEqual(Vec a, Vec b) { return _mm_cmpge_pd(a, b); }
+  static Mask either(Mask a, Mask b) { return _mm_or_pd(a, b); }
+  static Vec select(Mask mask, Vec a, Vec b) { return _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a)); }
+  static Vec negateIf(Mask mask, Vec a) { return _mm_xor_pd(a, _mm_and_pd(mask, _mm_set1_pd(-0.0))); }
+};
+#endif
+
+#if defined(__AVX__)
+struct AvxLanes
+{
+  typedef __m256d Vec;
+  typedef __m256d Mask;
+  static const std::size_t width = 4;
+
+  static Vec load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, Vec a) { _mm256_storeu_pd(p, a); }
+  static Vec set(double a) { return _mm256_set1_pd(a); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+  static Vec abs(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+  static Vec trunc(Vec a) { return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+  static Mask equal(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+  static Mask less(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  static Mask greaterEqual(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+  static Mask either(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+  static Vec select(Mask mask, Vec a, Vec b) { return _mm256_blendv_pd(a, b, mask); }
+  static Vec negateIf(Mask mask, Vec a) { return _mm256_xor_pd(a, _mm256_and_pd(mask, _mm256_set1_pd(-0.0))); }
+};
+#endif
+
+#if defined(__AVX__)
+typedef AvxLanes NativeLanes;
+const char* const NATIVE_INSTRUCTION_SET = "avx";
+#elif defined(__SSE2__)
+typedef Sse2Lanes NativeLanes;
+const char* const NATIVE_INSTRUCTION_SET = "sse2";
+#else
+typedef ScalarLanes NativeLanes;
+const char* const NATIVE_INSTRUCTION_SET = "scalar";
+#endif
+
+//-----------------------------------------------------------------------------------------
+// Sine and cosine, Cephes polynomials on argument reduced to [-pi/4, pi/4].
+// Pi/4 is split in three parts so the reduction stays exact for angles of a few turns
+
+const double DP1 = 7.85398125648498535156E-1;
+const double DP2 = 3.77489470793079817668E-8;
+const double DP3 = 2.69515142907905952645E-15;
+
+const double SIN_COEFFICIENTS[6] = { 1.58962301576546568060E-10, -2.50507477628578072866E-8,
+                                     2.75573136213857245213E-6,  -1.98412698295895385996E-4,
+                                     8.33333333332211858878E-3,  -1.66666666666666307295E-1 };
+const double COS_COEFFICIENTS[6] = { -1.13585365213876817300E-11, 2.08757008419747316778E-9,
+                                     -2.75573141792967388112E-7,  2.48015872888517045348E-5,
+                                     -1.38888888888730564116E-3,  4.16666666666665929218E-2 };
+
+template <class L>
+inline typename L::Vec polynomial(typename L::Vec x, const double* coefficients)
+{
+  typename L::Vec result = L::set(coefficients[0]);
+  for (int i = 1; i < 6; i++)
+    result = L::add(L::mul(result, x), L::set(coefficients[i]));
+  return result;
+}
+
+template <class L>
+inline void sinCos(typename L::Vec x, typename L::Vec& sine, typename L::Vec& cosine)
+{
+  typedef typename L::Vec Vec;
+  typedef typename L::Mask Mask;
+
+  // Octant of |x|, odd octants are moved to the next even one with negative reduced argument
+  Vec ax = L::abs(x);
+  Vec y = L::trunc(L::mul(ax, L::set(4 / M_PI)));
+  y = L::add(y, L::sub(y, L::mul(L::set(2), L::trunc(L::mul(y, L::set(0.5))))));
+  Vec octant = L::sub(y, L::mul(L::set(8), L::trunc(L::mul(y, L::set(0.125)))));
+
+  Vec z = L::sub(L::sub(L::sub(ax, L::mul(y, L::set(DP1))), L::mul(y, L::set(DP2))), L::mul(y, L::set(DP3)));
+  Vec zz = L::mul(z, z);
+
+  Vec sin_z = L::add(z, L::mul(L::mul(z, zz), polynomial<L>(zz, SIN_COEFFICIENTS)));
+  Vec cos_z = L::add(L::sub(L::set(1), L::mul(L::set(0.5), zz)),
+                     L::mul(L::mul(zz, zz), polynomial<L>(zz, COS_COEFFICIENTS)));
+
+  // Octants 0, 2, 4, 6 give sine (sin, cos, -sin, -cos) and cosine (cos, -sin, -cos, sin)
+  Mask swap = L::either(L::equal(octant, L::set(2)), L::equal(octant, L::set(6)));
+  sine = L::negateIf(L::greaterEqual(octant, L::set(4)), L::select(swap, sin_z, cos_z));
+  sine = L::negateIf(L::less(x, L::set(0)), sine);
+  cosine = L::negateIf(L::either(L::equal(octant, L::set(2)), L::equal(octant, L::set(4))),
+                       L::select(swap, cos_z, sin_z));
+}
+
+//-----------------------------------------------------------------------------------------
+// Kernels process whole registers from begin, return index of the first unprocessed element
+
+template <class L>
+std::size_t rpyToQuaternionKernel(std::size_t begin, std::size_t count, const double* roll, const double* pitch,
+                                  const double* yaw, double* qx, double* qy, double* qz, double* qw)
+{
+  typedef typename L::Vec Vec;
+
+  std::size_t i = begin;
+  for (; i + L::width <= count; i += L::width)
+  {
+    Vec half = L::set(0.5);
+    Vec sr, cr, sp, cp, sy, cy;
+    sinCos<L>(L::mul(L::load(roll + i), half), sr, cr);
+    sinCos<L>(L::mul(L::load(pitch + i), half), sp, cp);
+    sinCos<L>(L::mul(L::load(yaw + i), half), sy, cy);
+
+    Vec cp_cy = L::mul(cp, cy), sp_sy = L::mul(sp, sy);
+    Vec sp_cy = L::mul(sp, cy), cp_sy = L::mul(cp, sy);
+
+    L::store(qx + i, L::sub(L::mul(sr, cp_cy), L::mul(cr, sp_sy)));
+    L::store(qy + i, L::add(L::mul(cr, sp_cy), L::mul(sr, cp_sy)));
+    L::store(qz + i, L::sub(L::mul(cr, cp_sy), L::mul(sr, sp_cy)));
+    L::store(qw + i, L::add(L::mul(cr, cp_cy), L::mul(sr, sp_sy)));
+  }
+  return i;
+}
+
+// Tool Z axis is the third column of the rotation matrix
+template <class L>
+std::size_t approachKernel(std::size_t begin, std::size_t count, double approach_distance, double deapproach_height,
+                           const double* x, const double* y, const double* z, const double* qx, const double* qy,
+                           const double* qz, const double* qw, double* approach_x, double* approach_y,
+                           double* approach_z, double* deapproach_z)
+{
+  typedef typename L::Vec Vec;
+
+  std::size_t i = begin;
+  for (; i + L::width <= count; i += L::width)
+  {
+    Vec distance = L::set(approach_distance);
+    Vec two_distance = L::set(2 * approach_distance);
+    Vec vx = L::load(qx + i), vy = L::load(qy + i), vz = L::load(qz + i), vw = L::load(qw + i);
+    Vec pz = L::load(z + i);
+
+    Vec axis_x = L::add(L::mul(vx, vz), L::mul(vw, vy));
+    Vec axis_y = L::sub(L::mul(vy, vz), L::mul(vw, vx));
+    Vec axis_z = L::sub(L::set(1), L::mul(L::set(2), L::add(L::mul(vx, vx), L::mul(vy, vy))));
+
+    L::store(approach_x + i, L::sub(L::load(x + i), L::mul(two_distance, axis_x)));
+    L::store(approach_y + i, L::sub(L::load(y + i), L::mul(two_distance, axis_y)));
+    L::store(approach_z + i, L::sub(pz, L::mul(distance, axis_z)));
+    L::store(deapproach_z + i, L::add(pz, L::set(deapproach_height)));
+  }
+  return i;
+}
+}  // namespace
+
+void rpyToQuaternion(const PoseSamples& samples, GraspBatch& grasps, bool vectorized)
+{
+  std::size_t count = samples.x.size();
+  grasps.resize(count);
+  grasps.x = samples.x;
+  grasps.y = samples.y;
+  grasps.z = samples.z;
+  if (count == 0)
+    return;
+
+  const double* roll = samples.roll.data();
+  const double* pitch = samples.pitch.data();
+  const double* yaw = samples.yaw.data();
+  double* qx = grasps.qx.data();
+  double* qy = grasps.qy.data();
+  double* qz = grasps.qz.data();
+  double* qw = grasps.qw.data();
+
+  // Remainder of the last register goes through scalar code with the same polynomials
+  std::size_t i = 0;
+  if (vectorized)
+    i = rpyToQuaternionKernel<NativeLanes>(0, count, roll, pitch, yaw, qx, qy, qz, qw);
+  rpyToQuaternionKernel<ScalarLanes>(i, count, roll, pitch, yaw, qx, qy, qz, qw);
+}
+
+void deriveApproachPoses(const GraspBatch& grasps, double approach_distance, double deapproach_height,
+                         ApproachBatch& poses, bool vectorized)
+{
+  std::size_t count = grasps.size();
+  poses.resize(count);
+  if (count == 0)
+    return;
+
+  std::size_t i = 0;
+  if (vectorized)
+    i = approachKernel<NativeLanes>(0, count, approach_distance, deapproach_height, grasps.x.data(),
+                                    grasps.y.data(), grasps.z.data(), grasps.qx.data(), grasps.qy.data(),
+                                    grasps.qz.data(), grasps.qw.data(), poses.approach_x.data(),
+                                    poses.approach_y.data(), poses.approach_z.data(), poses.deapproach_z.data());
+  approachKernel<ScalarLanes>(i, count, approach_distance, deapproach_height, grasps.x.data(), grasps.y.data(),
+                              grasps.z.data(), grasps.qx.data(), grasps.qy.data(), grasps.qz.data(),
+                              grasps.qw.data(), poses.approach_x.data(), poses.approach_y.data(),
+                              poses.approach_z.data(), poses.deapproach_z.data());
+}
+
+const char* poseKernelInstructionSet()
+{
+  return NATIVE_INSTRUCTION_SET;
+}
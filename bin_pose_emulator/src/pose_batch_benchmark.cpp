@@ -0,0 +1,164 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Compares batch pose kernels with tf::Quaternion::setRPY and tf::quatRotate
+// on grasp -> approach -> deapproach derivation of random poses
+
+#include <ros/ros.h>
+#include <tf/tf.h>
+#include <bin_pose_emulator/pose_batch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+typedef std::function<void(const PoseSamples&, GraspBatch&, ApproachBatch&)> PoseMethod;
+
+static double runMethod(const PoseMethod& method, const PoseSamples& samples, int repetitions, GraspBatch& grasps,
+                        ApproachBatch& poses)
+{
+  // Best of repetitions, the first one also warms up caches
+  double best = 0;
+  for (int r = 0; r < repetitions; r++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    method(samples, grasps, poses);
+    auto end = std::chrono::steady_clock::now();
+
+    double duration = std::chrono::duration<double, std::milli>(end - start).count();
+    if (r == 0 || duration < best)
+      best = duration;
+  }
+  return best;
+}
+
+static double maxDifference(const GraspBatch& grasps, const ApproachBatch& poses, const GraspBatch& reference_grasps,
+                            const ApproachBatch& reference_poses)
+{
+  double difference = 0;
+  for (std::size_t i = 0; i < grasps.size(); i++)
+  {
+    // q and -q are the same rotation
+    double sign = grasps.qw[i] * reference_grasps.qw[i] < 0 ? -1 : 1;
+    difference = std::max(difference, std::fabs(grasps.qx[i] - sign * reference_grasps.qx[i]));
+    difference = std::max(difference, std::fabs(grasps.qy[i] - sign * reference_grasps.qy[i]));
+    difference = std::max(difference, std::fabs(grasps.qz[i] - sign * reference_grasps.qz[i]));
+    difference = std::max(difference, std::fabs(grasps.qw[i] - sign * reference_grasps.qw[i]));
+    difference = std::max(difference, std::fabs(poses.approach_x[i] - reference_poses.approach_x[i]));
+    difference = std::max(difference, std::fabs(poses.approach_y[i] - reference_poses.approach_y[i]));
+    difference = std::max(difference, std::fabs(poses.approach_z[i] - reference_poses.approach_z[i]));
+    difference = std::max(difference, std::fabs(poses.deapproach_z[i] - reference_poses.deapproach_z[i]));
+  }
+  return difference;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "pose_batch_benchmark");
+  ros::NodeHandle pnh("~");
+
+  int count, repetitions, seed;
+  double approach_distance, deapproach_height;
+  pnh.param<int>("count", count, 100000);
+  pnh.param<int>("repetitions", repetitions, 20);
+  pnh.param<int>("seed", seed, 1);
+  pnh.param<double>("approach_distance", approach_distance, 0.1);
+  pnh.param<double>("deapproach_height", deapproach_height, 0.1);
+
+  //---------------------------------------------------
+  // Generate poses
+  //---------------------------------------------------
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> position(-0.5, 0.5);
+  std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+
+  PoseSamples samples;
+  for (int i = 0; i < count; i++)
+  {
+    samples.x.push_back(position(generator));
+    samples.y.push_back(position(generator));
+    samples.z.push_back(position(generator));
+    samples.roll.push_back(angle(generator));
+    samples.pitch.push_back(angle(generator));
+    samples.yaw.push_back(angle(generator));
+  }
+
+  //---------------------------------------------------
+  // Methods under test
+  //---------------------------------------------------
+  // Same computation as bin_pose_emulator single pose service
+  PoseMethod tf_method = [&](const PoseSamples& samples, GraspBatch& grasps, ApproachBatch& poses)
+  {
+    grasps.resize(samples.x.size());
+    poses.resize(samples.x.size());
+    for (std::size_t i = 0; i < samples.x.size(); i++)
+    {
+      tf::Quaternion orientation;
+      orientation.setRPY(samples.roll[i], samples.pitch[i], samples.yaw[i]);
+      tf::Vector3 axis = tf::quatRotate(orientation, tf::Vector3(0, 0, 1));
+
+      grasps.x[i] = samples.x[i];
+      grasps.y[i] = samples.y[i];
+      grasps.z[i] = samples.z[i];
+      grasps.qx[i] = orientation.getX();
+      grasps.qy[i] = orientation.getY();
+      grasps.qz[i] = orientation.getZ();
+      grasps.qw[i] = orientation.getW();
+
+      poses.approach_x[i] = samples.x[i] - approach_distance * axis.getX();
+      poses.approach_y[i] = samples.y[i] - approach_distance * axis.getY();
+      poses.approach_z[i] = samples.z[i] - approach_distance * axis.getZ();
+      poses.deapproach_z[i] = samples.z[i] + deapproach_height;
+    }
+  };
+
+  PoseMethod scalar_method = [&](const PoseSamples& samples, GraspBatch& grasps, ApproachBatch& poses)
+  {
+    rpyToQuaternion(samples, grasps, false);
+    deriveApproachPoses(grasps, approach_distance, deapproach_height, poses, false);
+  };
+
+  PoseMethod vector_method = [&](const PoseSamples& samples, GraspBatch& grasps, ApproachBatch& poses)
+  {
+    rpyToQuaternion(samples, grasps);
+    deriveApproachPoses(grasps, approach_distance, deapproach_height, poses);
+  };
+
+  //---------------------------------------------------
+  // Run
+  //---------------------------------------------------
+  GraspBatch tf_grasps, scalar_grasps, vector_grasps;
+  ApproachBatch tf_poses, scalar_poses, vector_poses;
+
+  double tf_time = runMethod(tf_method, samples, repetitions, tf_grasps, tf_poses);
+  double scalar_time = runMethod(scalar_method, samples, repetitions, scalar_grasps, scalar_poses);
+  double vector_time = runMethod(vector_method, samples, repetitions, vector_grasps, vector_poses);
+
+  ROS_INFO("POSE BATCH BENCHMARK: %d poses, best of %d runs, vectorized kernels use %s", count, repetitions,
+           poseKernelInstructionSet());
+  ROS_INFO("%-8s %9.3f ms, %7.2f ns per pose", "tf", tf_time, tf_time * 1e6 / std::max(count, 1));
+  ROS_INFO("%-8s %9.3f ms, %7.2f ns per pose, speedup %.2fx, max difference %.3g", "scalar", scalar_time,
+           scalar_time * 1e6 / std::max(count, 1), tf_time / scalar_time,
+           maxDifference(scalar_grasps, scalar_poses, tf_grasps, tf_poses));
+  ROS_INFO("%-8s %9.3f ms, %7.2f ns per pose, speedup %.2fx, max difference %.3g", poseKernelInstructionSet(),
+           vector_time, vector_time * 1e6 / std::max(count, 1), tf_time / vector_time,
+           maxDifference(vector_grasps, vector_poses, tf_grasps, tf_poses));
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/random_engine.h"
+
+namespace
+{
+const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+uint64_t mix64(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t splitmix64(uint64_t& state)
+{
+  state += GOLDEN_GAMMA;
+  return mix64(state);
+}
+
+uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+// Upper 53 bits mapped to [0, 1)
+double toUnit(uint64_t x)
+{
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+}
+
+//-----------------------------------------------------------------------------------------
+// XoshiroEngine
+//-----------------------------------------------------------------------------------------
+
+XoshiroEngine::XoshiroEngine()
+{
+  seed(0, 0);
+}
+
+void XoshiroEngine::seed(uint64_t seed, uint64_t stream)
+{
+  uint64_t splitmix_state = mix64(seed) ^ mix64(stream + GOLDEN_GAMMA);
+  for (int i = 0; i < 4; i++)
+    state_[i] = splitmix64(splitmix_state);
+}
+
+uint64_t XoshiroEngine::next()
+{
+  const uint64_t result = rotl(state_[1] * 5, 7) * 9;
+  const uint64_t t = state_[1] << 17;
+
+  state_[2] ^= state_[0];
+  state_[3] ^= state_[1];
+  state_[1] ^= state_[2];
+  state_[0] ^= state_[3];
+  state_[2] ^= t;
+  state_[3] = rotl(state_[3], 45);
+
+  return result;
+}
+
+void XoshiroEngine::uniform(double* samples, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++)
+    samples[i] = toUnit(next());
+}
+
+//-----------------------------------------------------------------------------------------
+// CounterEngine
+//-----------------------------------------------------------------------------------------
+
+CounterEngine::CounterEngine() : key_(0), counter_(0)
+{
+}
+
+void CounterEngine::seed(uint64_t seed, uint64_t stream)
+{
+  key_ = mix64(seed) ^ mix64(stream + GOLDEN_GAMMA);
+  counter_ = 0;
+}
+
+void CounterEngine::uniform(double* samples, std::size_t count)
+{
+  // Values are independent of each other, loop vectorizes
+  for (std::size_t i = 0; i < count; i++)
+    samples[i] = toUnit(mix64(key_ + (counter_ + i) * GOLDEN_GAMMA));
+  counter_ += count;
+}
+
+RandomEnginePtr createRandomEngine(const std::string& name)
+{
+  if (name == "xoshiro")
+    return RandomEnginePtr(new XoshiroEngine);
+  if (name == "counter")
+    return RandomEnginePtr(new CounterEngine);
+  return RandomEnginePtr();
+}
@@ -0,0 +1,468 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "bin_pose_emulator/reachability_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const char MAP_FILE_MAGIC[4] = { 'B', 'P', 'R', 'M' };
+const uint32_t MAP_FILE_VERSION = 2;
+const std::size_t MAP_FILE_ALIGNMENT = 64;
+
+// Offsets are relative to the file start, all arrays start at aligned offsets
+struct MapFileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t joint_count;
+  uint64_t cell_count;
+  uint64_t file_size;
+  uint64_t checksum;  // of everything behind the header
+
+  uint64_t names_offset;  // zero terminated joint names
+  uint64_t names_size;
+  uint64_t reachable_offset;  // uint8 per cell
+  uint64_t joints_offset;     // float per cell, one array per joint
+  uint64_t joints_stride;
+
+  ReachabilityGrid grid;
+};
+
+std::size_t alignOffset(std::size_t offset)
+{
+  return (offset + MAP_FILE_ALIGNMENT - 1) / MAP_FILE_ALIGNMENT * MAP_FILE_ALIGNMENT;
+}
+
+// Range check written so that crafted offsets can not overflow
+bool fitsIn(uint64_t offset, uint64_t size, uint64_t file_size)
+{
+  return offset <= file_size && size <= file_size - offset;
+}
+
+// FNV-1a over 64 bit words, tail bytes are hashed one by one
+uint64_t checksum(const uint8_t* data, std::size_t size)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * 1099511628211ULL;
+  }
+  for (; i < size; i++)
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  return hash;
+}
+
+// Reference for tool roll, world X projected to plane perpendicular to tool Z
+void rollReference(const double z[3], double reference[3])
+{
+  double axis[3] = { 1, 0, 0 };
+  if (fabs(z[0]) > 0.99)
+  {
+    axis[0] = 0;
+    axis[1] = 1;
+  }
+
+  double dot = axis[0] * z[0] + axis[1] * z[1] + axis[2] * z[2];
+  double norm = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    reference[i] = axis[i] - dot * z[i];
+    norm += reference[i] * reference[i];
+  }
+
+  norm = sqrt(norm);
+  for (int i = 0; i < 3; i++)
+    reference[i] /= norm;
+}
+
+int binIndex(double value, double range, uint32_t bins)
+{
+  return std::min(static_cast<int>(value / range * bins), static_cast<int>(bins) - 1);
+}
+}  // namespace
+
+ReachabilityMap::ReachabilityMap() : reachable_(NULL), mapping_(NULL), mapping_size_(0)
+{
+  memset(&grid_, 0, sizeof(grid_));
+}
+
+ReachabilityMap::~ReachabilityMap()
+{
+  unmap();
+}
+
+ReachabilityGrid ReachabilityMap::gridFromConfig(const ConfigData& config, double voxel_size, double max_polar,
+                                                 uint32_t polar_bins, uint32_t azimuth_bins, uint32_t roll_bins)
+{
+  ReachabilityGrid grid;
+  memset(&grid, 0, sizeof(grid));
+
+  // Same extent as IK seed cache of binpicking emulator
+  double margin = std::max(config.approach_distance, config.deapproach_height);
+  double center[3] = { config.bin_center_x, config.bin_center_y, config.bin_center_z };
+  double size[3] = { config.bin_size_x, config.bin_size_y, config.bin_size_z };
+
+  grid.voxel_size = voxel_size;
+  for (int i = 0; i < 3; i++)
+  {
+    grid.min[i] = center[i] - size[i] / 2 - margin;
+    grid.dimensions[i] = static_cast<uint32_t>(std::ceil((size[i] + 2 * margin) / voxel_size));
+  }
+
+  grid.max_polar = max_polar;
+  grid.polar_bins = std::max<uint32_t>(polar_bins, 1);
+  grid.azimuth_bins = std::max<uint32_t>(azimuth_bins, 1);
+  grid.roll_bins = std::max<uint32_t>(roll_bins, 1);
+  return grid;
+}
+
+void ReachabilityMap::create(const ReachabilityGrid& grid, const std::vector<std::string>& joint_names)
+{
+  unmap();
+
+  MapFileHeader header;
+  memset(&header, 0, sizeof(header));
+  std::copy(MAP_FILE_MAGIC, MAP_FILE_MAGIC + 4, header.magic);
+  header.version = MAP_FILE_VERSION;
+  header.header_size = alignOffset(sizeof(MapFileHeader));
+  header.joint_count = joint_names.size();
+  header.grid = grid;
+
+  grid_ = grid;
+  header.cell_count = size();
+
+  std::string names;
+  for (std::size_t i = 0; i < joint_names.size(); i++)
+    names.append(joint_names[i].c_str(), joint_names[i].size() + 1);
+
+  header.names_offset = header.header_size;
+  header.names_size = names.size();
+  header.reachable_offset = alignOffset(header.names_offset + header.names_size);
+  header.joints_offset = alignOffset(header.reachable_offset + header.cell_count);
+  header.joints_stride = alignOffset(header.cell_count * sizeof(float));
+  header.file_size = header.joints_offset + header.joint_count * header.joints_stride;
+
+  buffer_.assign(header.file_size, 0);
+  memcpy(buffer_.data(), &header, sizeof(header));
+  std::copy(names.begin(), names.end(), buffer_.begin() + header.names_offset);
+  attach(buffer_.data(), buffer_.size(), false);
+}
+
+bool ReachabilityMap::load(const std::string& filepath, bool verify_checksum)
+{
+  unmap();
+  buffer_.clear();
+
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(MapFileHeader)))
+  {
+    close(fd);
+    return false;
+  }
+
+  // Private writable mapping, pages are copied only if somebody writes to them.
+  // Mapping stays valid after the descriptor is closed.
+  void* mapping = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  mapping_ = mapping;
+  mapping_size_ = file_stat.st_size;
+
+  if (!attach(static_cast<uint8_t*>(mapping_), mapping_size_, verify_checksum))
+  {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+bool ReachabilityMap::save(const std::string& filepath)
+{
+  if (empty())
+    return false;
+
+  uint8_t* base = mapping_ ? static_cast<uint8_t*>(mapping_) : buffer_.data();
+  std::size_t file_size = mapping_ ? mapping_size_ : buffer_.size();
+
+  MapFileHeader header;
+  memcpy(&header, base, sizeof(header));
+  header.checksum = checksum(base + header.header_size, file_size - header.header_size);
+  memcpy(base, &header, sizeof(header));
+
+  // Readers never see a partially written map
+  std::string temporary = filepath + ".tmp";
+  {
+    std::ofstream file(temporary.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(base), file_size);
+    if (!file.good())
+      return false;
+  }
+  return rename(temporary.c_str(), filepath.c_str()) == 0;
+}
+
+bool ReachabilityMap::empty() const
+{
+  return reachable_ == NULL;
+}
+
+const ReachabilityGrid& ReachabilityMap::grid() const
+{
+  return grid_;
+}
+
+std::size_t ReachabilityMap::size() const
+{
+  return static_cast<std::size_t>(grid_.dimensions[0]) * grid_.dimensions[1] * grid_.dimensions[2] *
+         orientationBins();
+}
+
+std::size_t ReachabilityMap::orientationBins() const
+{
+  return static_cast<std::size_t>(grid_.polar_bins) * grid_.azimuth_bins * grid_.roll_bins;
+}
+
+const std::vector<std::string>& ReachabilityMap::jointNames() const
+{
+  return joint_names_;
+}
+
+bool ReachabilityMap::cellIndex(double x, double y, double z, double qx, double qy, double qz, double qw,
+                                std::size_t& index) const
+{
+  const double position[3] = { x, y, z };
+  std::size_t voxel = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    double offset = (position[i] - grid_.min[i]) / grid_.voxel_size;
+    if (offset < 0 || offset >= grid_.dimensions[i])
+      return false;
+    voxel = voxel * grid_.dimensions[i] + static_cast<std::size_t>(offset);
+  }
+
+  // Tool X and Z axes, first and third column of the rotation matrix
+  double tool_x[3] = { 1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy + qw * qz), 2 * (qx * qz - qw * qy) };
+  double tool_z[3] = { 2 * (qx * qz + qw * qy), 2 * (qy * qz - qw * qx), 1 - 2 * (qx * qx + qy * qy) };
+
+  double polar = acos(std::max(-1.0, std::min(1.0, -tool_z[2])));
+  if (polar > grid_.max_polar)
+    return false;
+
+  double azimuth = atan2(tool_z[1], tool_z[0]);
+  if (azimuth < 0)
+    azimuth += 2 * M_PI;
+
+  double reference[3];
+  rollReference(tool_z, reference);
+  double cross[3] = { reference[1] * tool_x[2] - reference[2] * tool_x[1],
+                      reference[2] * tool_x[0] - reference[0] * tool_x[2],
+                      reference[0] * tool_x[1] - reference[1] * tool_x[0] };
+  double roll = atan2(cross[0] * tool_z[0] + cross[1] * tool_z[1] + cross[2] * tool_z[2],
+                      reference[0] * tool_x[0] + reference[1] * tool_x[1] + reference[2] * tool_x[2]) + M_PI;
+
+  std::size_t orientation =
+      (static_cast<std::size_t>(binIndex(polar, grid_.max_polar, grid_.polar_bins)) * grid_.azimuth_bins +
+       binIndex(azimuth, 2 * M_PI, grid_.azimuth_bins)) * grid_.roll_bins +
+      binIndex(roll, 2 * M_PI, grid_.roll_bins);
+
+  index = voxel * orientationBins() + orientation;
+  return true;
+}
+
+void ReachabilityMap::cellPose(std::size_t index, double position[3], double orientation[4]) const
+{
+  std::size_t voxel = index / orientationBins();
+  std::size_t bin = index % orientationBins();
+
+  for (int i = 2; i >= 0; i--)
+  {
+    position[i] = grid_.min[i] + (voxel % grid_.dimensions[i] + 0.5) * grid_.voxel_size;
+    voxel /= grid_.dimensions[i];
+  }
+
+  double roll = (bin % grid_.roll_bins + 0.5) / grid_.roll_bins * 2 * M_PI - M_PI;
+  bin /= grid_.roll_bins;
+  double azimuth = (bin % grid_.azimuth_bins + 0.5) / grid_.azimuth_bins * 2 * M_PI;
+  double polar = (bin / grid_.azimuth_bins + 0.5) / grid_.polar_bins * grid_.max_polar;
+
+  // Rotation matrix columns from tool Z direction and roll around it
+  double z[3] = { sin(polar) * cos(azimuth), sin(polar) * sin(azimuth), -cos(polar) };
+  double reference[3];
+  rollReference(z, reference);
+  double side[3] = { z[1] * reference[2] - z[2] * reference[1], z[2] * reference[0] - z[0] * reference[2],
+                     z[0] * reference[1] - z[1] * reference[0] };
+
+  double x[3], y[3];
+  for (int i = 0; i < 3; i++)
+    x[i] = cos(roll) * reference[i] + sin(roll) * side[i];
+  y[0] = z[1] * x[2] - z[2] * x[1];
+  y[1] = z[2] * x[0] - z[0] * x[2];
+  y[2] = z[0] * x[1] - z[1] * x[0];
+
+  // Rotation matrix to quaternion
+  double trace = x[0] + y[1] + z[2];
+  if (trace > 0)
+  {
+    double s = 2 * sqrt(trace + 1);
+    orientation[3] = s / 4;
+    orientation[0] = (y[2] - z[1]) / s;
+    orientation[1] = (z[0] - x[2]) / s;
+    orientation[2] = (x[1] - y[0]) / s;
+  }
+  else if (x[0] > y[1] && x[0] > z[2])
+  {
+    double s = 2 * sqrt(1 + x[0] - y[1] - z[2]);
+    orientation[3] = (y[2] - z[1]) / s;
+    orientation[0] = s / 4;
+    orientation[1] = (y[0] + x[1]) / s;
+    orientation[2] = (z[0] + x[2]) / s;
+  }
+  else if (y[1] > z[2])
+  {
+    double s = 2 * sqrt(1 + y[1] - x[0] - z[2]);
+    orientation[3] = (z[0] - x[2]) / s;
+    orientation[0] = (y[0] + x[1]) / s;
+    orientation[1] = s / 4;
+    orientation[2] = (z[1] + y[2]) / s;
+  }
+  else
+  {
+    double s = 2 * sqrt(1 + z[2] - x[0] - y[1]);
+    orientation[3] = (x[1] - y[0]) / s;
+    orientation[0] = (z[0] + x[2]) / s;
+    orientation[1] = (z[1] + y[2]) / s;
+    orientation[2] = s / 4;
+  }
+}
+
+bool ReachabilityMap::reachable(double x, double y, double z, double qx, double qy, double qz, double qw) const
+{
+  std::size_t index;
+  if (empty() || !cellIndex(x, y, z, qx, qy, qz, qw, index))
+    return false;
+  return reachable_[index] != 0;
+}
+
+bool ReachabilityMap::solution(double x, double y, double z, double qx, double qy, double qz, double qw,
+                               std::vector<double>& joints) const
+{
+  std::size_t index;
+  if (empty() || !cellIndex(x, y, z, qx, qy, qz, qw, index) || !reachable_[index])
+    return false;
+
+  joints.resize(joints_.size());
+  for (std::size_t i = 0; i < joints_.size(); i++)
+    joints[i] = joints_[i][index];
+  return true;
+}
+
+void ReachabilityMap::setSolution(std::size_t index, const std::vector<double>& joints)
+{
+  reachable_[index] = 1;
+  for (std::size_t i = 0; i < joints_.size() && i < joints.size(); i++)
+    joints_[i][index] = joints[i];
+}
+
+void ReachabilityMap::setUnreachable(std::size_t index)
+{
+  reachable_[index] = 0;
+  for (std::size_t i = 0; i < joints_.size(); i++)
+    joints_[i][index] = 0;
+}
+
+bool ReachabilityMap::attach(uint8_t* base, std::size_t file_size, bool verify_checksum)
+{
+  MapFileHeader header;
+  memcpy(&header, base, sizeof(header));
+
+  // Reject other versions and truncated or inconsistent files
+  if (!std::equal(header.magic, header.magic + 4, MAP_FILE_MAGIC) || header.version != MAP_FILE_VERSION ||
+      header.header_size != alignOffset(sizeof(MapFileHeader)) || header.file_size != file_size)
+    return false;
+
+  // Arrays are read in place, so they have to be aligned and fit in the file
+  if (header.names_offset != header.header_size || header.reachable_offset % MAP_FILE_ALIGNMENT != 0 ||
+      header.joints_offset % MAP_FILE_ALIGNMENT != 0 || header.joints_stride % MAP_FILE_ALIGNMENT != 0 ||
+      !fitsIn(header.names_offset, header.names_size, file_size) ||
+      !fitsIn(header.reachable_offset, header.cell_count, file_size) ||
+      header.joints_stride < header.cell_count * sizeof(float) || header.joints_offset > file_size ||
+      (header.joints_stride > 0 && header.joint_count > (file_size - header.joints_offset) / header.joints_stride))
+    return false;
+
+  // Grid has to multiply to the cell count without overflow
+  const ReachabilityGrid& grid = header.grid;
+  const uint32_t factors[6] = { grid.dimensions[0], grid.dimensions[1], grid.dimensions[2],
+                                grid.polar_bins,    grid.azimuth_bins,  grid.roll_bins };
+  uint64_t cells = 1;
+  for (int i = 0; i < 6; i++)
+  {
+    if (factors[i] == 0 || cells > header.cell_count / factors[i])
+      return false;
+    cells *= factors[i];
+  }
+  if (cells != header.cell_count || !(grid.voxel_size > 0) || !(grid.max_polar > 0))
+    return false;
+
+  if (verify_checksum && checksum(base + header.header_size, file_size - header.header_size) != header.checksum)
+    return false;
+
+  const char* names = reinterpret_cast<const char*>(base + header.names_offset);
+  std::vector<std::string> joint_names;
+  for (std::size_t offset = 0; offset < header.names_size; offset += joint_names.back().size() + 1)
+    joint_names.push_back(std::string(names + offset, strnlen(names + offset, header.names_size - offset)));
+  if (joint_names.size() != header.joint_count)
+    return false;
+
+  grid_ = grid;
+  joint_names_ = joint_names;
+  reachable_ = base + header.reachable_offset;
+  joints_.resize(header.joint_count);
+  for (std::size_t i = 0; i < header.joint_count; i++)
+    joints_[i] = reinterpret_cast<float*>(base + header.joints_offset + i * header.joints_stride);
+  return true;
+}
+
+void ReachabilityMap::unmap()
+{
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+
+  mapping_ = NULL;
+  mapping_size_ = 0;
+  reachable_ = NULL;
+  joints_.clear();
+  joint_names_.clear();
+}
@@ -0,0 +1,98 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <bin_pose_emulator/grasp_scorer.h>
+
+#include <cmath>
+#include <cstring>
+
+TEST(GraspScorer, RankOrdersByDescendingScore)
+{
+  std::vector<double> scores = { 0.2, 0.9, 0.5, 0.1 };
+  std::vector<std::size_t> ranking;
+  GraspScorer::rank(scores, ranking);
+
+  std::vector<std::size_t> expected = { 1, 2, 0, 3 };
+  EXPECT_EQ(ranking, expected);
+}
+
+TEST(GraspScorer, RankKeepsOrderOfEqualScores)
+{
+  std::vector<double> scores = { 0.5, 0.7, 0.5, 0.7, 0.5 };
+  std::vector<std::size_t> ranking;
+  GraspScorer::rank(scores, ranking);
+
+  std::vector<std::size_t> expected = { 1, 3, 0, 2, 4 };
+  EXPECT_EQ(ranking, expected);
+}
+
+TEST(GraspScorer, RankOfEmptyBatch)
+{
+  std::vector<double> scores;
+  std::vector<std::size_t> ranking(3, 0);
+  GraspScorer::rank(scores, ranking);
+  EXPECT_TRUE(ranking.empty());
+}
+
+TEST(GraspScorer, CenteredGraspRanksFirst)
+{
+  ConfigData config;
+  memset(&config, 0, sizeof(config));
+  config.bin_center_z = 0.1;
+  config.bin_size_x = 0.5;
+  config.bin_size_y = 0.4;
+  config.bin_size_z = 0.2;
+  config.pitch_default = M_PI;
+  config.approach_distance = 0.1;
+
+  ScoringWeights weights = { 1.0, 1.0, 1.0, 1.0 };
+  GraspScorer scorer(config, weights, 0.5, 0.05, 0.05);
+
+  // Same height and orientation, second grasp next to the wall
+  GraspBatch grasps;
+  grasps.resize(2);
+  const double x[2] = { 0.0, 0.24 };
+  for (std::size_t i = 0; i < 2; i++)
+  {
+    grasps.x[i] = x[i];
+    grasps.y[i] = 0;
+    grasps.z[i] = 0.05;
+    grasps.qx[i] = 0;
+    grasps.qy[i] = 1;
+    grasps.qz[i] = 0;
+    grasps.qw[i] = 0;
+    grasps.part_ids[i] = 0;
+  }
+
+  ScoringObstacles obstacles;
+  obstacles.radius = 0.05;
+
+  std::vector<double> scores;
+  scorer.score(grasps, obstacles, scores);
+  ASSERT_EQ(scores.size(), 2u);
+  EXPECT_GT(scores[0], scores[1]);
+
+  std::vector<std::size_t> ranking;
+  GraspScorer::rank(scores, ranking);
+  EXPECT_EQ(ranking.front(), 0u);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <bin_pose_emulator/pile_generator.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+class PileGeneratorTest : public ::testing::Test
+{
+protected:
+  PileGeneratorTest() : pile_(config(), tf::Vector3(0.1, 0.1, 0.1), 20, 0.3, 0.5)
+  {
+  }
+
+  static ConfigData config()
+  {
+    ConfigData config;
+    memset(&config, 0, sizeof(config));
+    config.bin_center_z = 0.1;
+    config.bin_size_x = 0.5;
+    config.bin_size_y = 0.4;
+    config.bin_size_z = 0.2;
+    config.pitch_default = M_PI;
+    config.approach_distance = 0.1;
+    config.deapproach_height = 0.1;
+    return config;
+  }
+
+  static PilePart part(double x, double y, double z, double yaw = 0)
+  {
+    PilePart part;
+    part.id = 0;
+    part.center = tf::Vector3(x, y, z);
+    part.rotation.setRPY(0, 0, yaw);
+    part.yaw = yaw;
+    return part;
+  }
+
+  PileGenerator pile_;
+};
+}  // namespace
+
+TEST_F(PileGeneratorTest, OverlapsAlignedParts)
+{
+  EXPECT_TRUE(pile_.overlaps(part(0, 0, 0), part(0, 0, 0)));
+  EXPECT_TRUE(pile_.overlaps(part(0, 0, 0), part(0.09, 0, 0)));
+  EXPECT_TRUE(pile_.overlaps(part(0, 0, 0), part(0.09, 0.09, 0.09)));
+  EXPECT_FALSE(pile_.overlaps(part(0, 0, 0), part(0.11, 0, 0)));
+  EXPECT_FALSE(pile_.overlaps(part(0, 0, 0), part(0, 0, -0.11)));
+  EXPECT_FALSE(pile_.overlaps(part(0, 0, 0), part(0.09, 0.11, 0)));
+}
+
+TEST_F(PileGeneratorTest, OverlapsRotatedParts)
+{
+  // Corner of the rotated part reaches half diagonal 0.0707 towards the other one
+  EXPECT_TRUE(pile_.overlaps(part(0, 0, 0), part(0.115, 0, 0, M_PI / 4)));
+  EXPECT_FALSE(pile_.overlaps(part(0, 0, 0), part(0.125, 0, 0, M_PI / 4)));
+  EXPECT_TRUE(pile_.overlaps(part(0.115, 0, 0, M_PI / 4), part(0, 0, 0)));
+  EXPECT_FALSE(pile_.overlaps(part(0.125, 0, 0, M_PI / 4), part(0, 0, 0)));
+
+  // Diagonal distance of two parts rotated by the same angle
+  EXPECT_TRUE(pile_.overlaps(part(0, 0, 0, M_PI / 4), part(0.07, 0.07, 0, M_PI / 4)));
+  EXPECT_FALSE(pile_.overlaps(part(0, 0, 0, M_PI / 4), part(0.075, 0.075, 0, M_PI / 4)));
+}
+
+TEST_F(PileGeneratorTest, OverlapsEdgeToEdge)
+{
+  // Top edge of a crosses bottom edge of b, parts touch only near the crossing
+  PilePart a = part(0, 0, 0);
+  a.rotation.setRPY(M_PI / 4, 0, 0);
+  PilePart b = part(0, 0, 0.14);
+  b.rotation.setRPY(0, M_PI / 4, 0);
+  EXPECT_TRUE(pile_.overlaps(a, b));
+
+  b.center.setZ(0.145);
+  EXPECT_FALSE(pile_.overlaps(a, b));
+}
+
+TEST_F(PileGeneratorTest, SegmentHitsPart)
+{
+  PilePart box = part(0, 0, 0);
+  EXPECT_TRUE(pile_.segmentHitsPart(tf::Vector3(0, 0, 1), tf::Vector3(0, 0, -1), box));
+  EXPECT_TRUE(pile_.segmentHitsPart(tf::Vector3(0.01, 0.01, 0.01), tf::Vector3(0.02, 0.02, 0.02), box));
+  EXPECT_TRUE(pile_.segmentHitsPart(tf::Vector3(-1, 0.04, 0), tf::Vector3(1, 0.04, 0), box));
+
+  // Misses beside, above and short of the part
+  EXPECT_FALSE(pile_.segmentHitsPart(tf::Vector3(-1, 0.06, 0), tf::Vector3(1, 0.06, 0), box));
+  EXPECT_FALSE(pile_.segmentHitsPart(tf::Vector3(0, 0, 1), tf::Vector3(0, 0, 0.06), box));
+  EXPECT_FALSE(pile_.segmentHitsPart(tf::Vector3(-1, 0, 1), tf::Vector3(1, 0, 0.5), box));
+}
+
+TEST_F(PileGeneratorTest, SegmentHitsRotatedPart)
+{
+  // Corner of the rotated part sticks out of the axis aligned box
+  PilePart box = part(0, 0, 0, M_PI / 4);
+  EXPECT_TRUE(pile_.segmentHitsPart(tf::Vector3(0.065, -1, 0), tf::Vector3(0.065, 1, 0), box));
+  EXPECT_FALSE(pile_.segmentHitsPart(tf::Vector3(0.075, -1, 0), tf::Vector3(0.075, 1, 0), box));
+}
+
+TEST_F(PileGeneratorTest, GeneratedPartsDoNotOverlap)
+{
+  XoshiroEngine engine;
+  engine.seed(1, 0);
+  ASSERT_GT(pile_.generate(engine), 0u);
+
+  const std::vector<PilePart>& parts = pile_.parts();
+  for (std::size_t i = 0; i < parts.size(); i++)
+    for (std::size_t j = i + 1; j < parts.size(); j++)
+      EXPECT_FALSE(pile_.overlaps(parts[i], parts[j])) << "parts " << i << " and " << j;
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <tf/tf.h>
+#include <bin_pose_emulator/pose_batch.h>
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+const double TOLERANCE = 1e-12;
+
+// Odd sizes leave a remainder for the scalar tail of every register width
+const std::size_t BATCH_SIZES[] = { 1, 3, 5, 7, 13, 101 };
+
+PoseSamples randomSamples(std::size_t count, unsigned int seed)
+{
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<double> position(-1.0, 1.0);
+  std::uniform_real_distribution<double> angle(-4 * M_PI, 4 * M_PI);
+
+  PoseSamples samples;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    samples.x.push_back(position(generator));
+    samples.y.push_back(position(generator));
+    samples.z.push_back(position(generator));
+    samples.roll.push_back(angle(generator));
+    samples.pitch.push_back(angle(generator));
+    samples.yaw.push_back(angle(generator));
+  }
+  return samples;
+}
+
+void expectMatchesTf(const PoseSamples& samples, bool vectorized)
+{
+  const double approach_distance = 0.1, deapproach_height = 0.15;
+
+  GraspBatch grasps;
+  rpyToQuaternion(samples, grasps, vectorized);
+  ApproachBatch poses;
+  deriveApproachPoses(grasps, approach_distance, deapproach_height, poses, vectorized);
+
+  ASSERT_EQ(grasps.size(), samples.x.size());
+  for (std::size_t i = 0; i < grasps.size(); i++)
+  {
+    SCOPED_TRACE(i);
+    tf::Quaternion expected;
+    expected.setRPY(samples.roll[i], samples.pitch[i], samples.yaw[i]);
+
+    EXPECT_EQ(grasps.x[i], samples.x[i]);
+    EXPECT_EQ(grasps.y[i], samples.y[i]);
+    EXPECT_EQ(grasps.z[i], samples.z[i]);
+    EXPECT_NEAR(grasps.qx[i], expected.x(), TOLERANCE);
+    EXPECT_NEAR(grasps.qy[i], expected.y(), TOLERANCE);
+    EXPECT_NEAR(grasps.qz[i], expected.z(), TOLERANCE);
+    EXPECT_NEAR(grasps.qw[i], expected.w(), TOLERANCE);
+
+    // Approach point lies against tool Z axis, deapproach point above the grasp
+    tf::Vector3 grasp(samples.x[i], samples.y[i], samples.z[i]);
+    tf::Vector3 approach = grasp - approach_distance * tf::quatRotate(expected, tf::Vector3(0, 0, 1));
+    EXPECT_NEAR(poses.approach_x[i], approach.x(), TOLERANCE);
+    EXPECT_NEAR(poses.approach_y[i], approach.y(), TOLERANCE);
+    EXPECT_NEAR(poses.approach_z[i], approach.z(), TOLERANCE);
+    EXPECT_NEAR(poses.deapproach_z[i], samples.z[i] + deapproach_height, TOLERANCE);
+  }
+}
+}  // namespace
+
+TEST(PoseBatch, VectorizedKernelsMatchTf)
+{
+  for (std::size_t size : BATCH_SIZES)
+  {
+    SCOPED_TRACE(size);
+    expectMatchesTf(randomSamples(size, size), true);
+  }
+}
+
+TEST(PoseBatch, ScalarKernelsMatchTf)
+{
+  for (std::size_t size : BATCH_SIZES)
+  {
+    SCOPED_TRACE(size);
+    expectMatchesTf(randomSamples(size, size), false);
+  }
+}
+
+TEST(PoseBatch, PoseDoesNotDependOnBatchPosition)
+{
+  // Same pose converted alone and as the remainder of a larger batch
+  PoseSamples batch = randomSamples(7, 42);
+  PoseSamples single;
+  single.x.push_back(batch.x.back());
+  single.y.push_back(batch.y.back());
+  single.z.push_back(batch.z.back());
+  single.roll.push_back(batch.roll.back());
+  single.pitch.push_back(batch.pitch.back());
+  single.yaw.push_back(batch.yaw.back());
+
+  GraspBatch batch_grasps, single_grasps;
+  rpyToQuaternion(batch, batch_grasps);
+  rpyToQuaternion(single, single_grasps);
+
+  EXPECT_EQ(batch_grasps.qx.back(), single_grasps.qx[0]);
+  EXPECT_EQ(batch_grasps.qy.back(), single_grasps.qy[0]);
+  EXPECT_EQ(batch_grasps.qz.back(), single_grasps.qz[0]);
+  EXPECT_EQ(batch_grasps.qw.back(), single_grasps.qw[0]);
+}
+
+TEST(PoseBatch, EmptyBatch)
+{
+  GraspBatch grasps;
+  rpyToQuaternion(PoseSamples(), grasps);
+  EXPECT_EQ(grasps.size(), 0u);
+
+  ApproachBatch poses;
+  deriveApproachPoses(grasps, 0.1, 0.1, poses);
+  EXPECT_TRUE(poses.approach_x.empty());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,221 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <bin_pose_emulator/reachability_map.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+// Header field offsets of map file version 2
+const std::size_t VERSION_OFFSET = 4;
+const std::size_t REACHABLE_OFFSET = 56;
+const std::size_t JOINTS_STRIDE = 72;
+
+class ReachabilityMapTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    memset(&config_, 0, sizeof(config_));
+    config_.bin_center_z = 0.1;
+    config_.bin_size_x = 0.4;
+    config_.bin_size_y = 0.3;
+    config_.bin_size_z = 0.2;
+    config_.approach_distance = 0.1;
+    config_.deapproach_height = 0.1;
+
+    joint_names_ = { "joint_1", "joint_2", "joint_3" };
+    filepath_ = "/tmp/test_reachability_map_" + std::to_string(getpid()) + ".bin";
+  }
+
+  virtual void TearDown()
+  {
+    remove(filepath_.c_str());
+  }
+
+  void build(ReachabilityMap& map)
+  {
+    map.create(ReachabilityMap::gridFromConfig(config_, 0.05, M_PI / 2, 2, 4, 4), joint_names_);
+    for (std::size_t index = 0; index < map.size(); index += 7)
+      map.setSolution(index, { 0.1, -0.2, static_cast<double>(index) });
+  }
+
+  std::vector<char> readFile()
+  {
+    std::ifstream file(filepath_.c_str(), std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  void writeFile(const std::vector<char>& data)
+  {
+    std::ofstream file(filepath_.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+  }
+
+  template <class T>
+  void patch(std::size_t offset, T value)
+  {
+    std::vector<char> data = readFile();
+    memcpy(data.data() + offset, &value, sizeof(value));
+    writeFile(data);
+  }
+
+  ConfigData config_;
+  std::vector<std::string> joint_names_;
+  std::string filepath_;
+};
+}  // namespace
+
+TEST_F(ReachabilityMapTest, CreatedMapIsUnreachable)
+{
+  ReachabilityMap map;
+  EXPECT_TRUE(map.empty());
+
+  map.create(ReachabilityMap::gridFromConfig(config_, 0.05, M_PI / 2, 2, 4, 4), joint_names_);
+  ASSERT_FALSE(map.empty());
+  EXPECT_EQ(map.jointNames(), joint_names_);
+
+  double position[3], orientation[4];
+  map.cellPose(0, position, orientation);
+  EXPECT_FALSE(map.reachable(position[0], position[1], position[2], orientation[0], orientation[1], orientation[2],
+                             orientation[3]));
+}
+
+TEST_F(ReachabilityMapTest, CellPoseMapsBackToCell)
+{
+  ReachabilityMap map;
+  build(map);
+
+  for (std::size_t index = 0; index < map.size(); index += 13)
+  {
+    double position[3], orientation[4];
+    map.cellPose(index, position, orientation);
+
+    std::size_t found;
+    ASSERT_TRUE(map.cellIndex(position[0], position[1], position[2], orientation[0], orientation[1], orientation[2],
+                              orientation[3], found));
+    EXPECT_EQ(found, index);
+  }
+}
+
+TEST_F(ReachabilityMapTest, SaveLoadRoundTrip)
+{
+  ReachabilityMap built;
+  build(built);
+  ASSERT_TRUE(built.save(filepath_));
+
+  ReachabilityMap loaded;
+  ASSERT_TRUE(loaded.load(filepath_, true));
+  EXPECT_EQ(loaded.size(), built.size());
+  EXPECT_EQ(loaded.jointNames(), joint_names_);
+
+  for (std::size_t index = 0; index < built.size(); index += 5)
+  {
+    double position[3], orientation[4];
+    built.cellPose(index, position, orientation);
+
+    std::vector<double> joints;
+    bool reachable = loaded.solution(position[0], position[1], position[2], orientation[0], orientation[1],
+                                     orientation[2], orientation[3], joints);
+    ASSERT_EQ(reachable, index % 7 == 0);
+    if (reachable)
+    {
+      ASSERT_EQ(joints.size(), 3u);
+      EXPECT_FLOAT_EQ(joints[0], 0.1);
+      EXPECT_FLOAT_EQ(joints[1], -0.2);
+      EXPECT_FLOAT_EQ(joints[2], index);
+    }
+  }
+}
+
+TEST_F(ReachabilityMapTest, RejectsTruncatedFile)
+{
+  ReachabilityMap built;
+  build(built);
+  ASSERT_TRUE(built.save(filepath_));
+
+  std::vector<char> data = readFile();
+  data.resize(data.size() - 1);
+  writeFile(data);
+
+  ReachabilityMap loaded;
+  EXPECT_FALSE(loaded.load(filepath_));
+  EXPECT_TRUE(loaded.empty());
+
+  data.resize(16);
+  writeFile(data);
+  EXPECT_FALSE(loaded.load(filepath_));
+}
+
+TEST_F(ReachabilityMapTest, RejectsCorruptHeader)
+{
+  ReachabilityMap built;
+  build(built);
+  ASSERT_TRUE(built.save(filepath_));
+
+  ReachabilityMap loaded;
+  patch<char>(0, 'X');
+  EXPECT_FALSE(loaded.load(filepath_));
+
+  ASSERT_TRUE(built.save(filepath_));
+  patch<uint32_t>(VERSION_OFFSET, 1);
+  EXPECT_FALSE(loaded.load(filepath_));
+
+  ASSERT_TRUE(built.save(filepath_));
+  std::vector<char> data = readFile();
+  uint64_t reachable_offset;
+  memcpy(&reachable_offset, data.data() + REACHABLE_OFFSET, sizeof(reachable_offset));
+  patch<uint64_t>(REACHABLE_OFFSET, reachable_offset + 1);
+  EXPECT_FALSE(loaded.load(filepath_));
+
+  // Aligned stride, three joint arrays wrap around to 128 bytes
+  ASSERT_TRUE(built.save(filepath_));
+  patch<uint64_t>(JOINTS_STRIDE, 64 * (((1ull << 58) + 2) / 3));
+  EXPECT_FALSE(loaded.load(filepath_));
+  EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(ReachabilityMapTest, ChecksumDetectsCorruptData)
+{
+  ReachabilityMap built;
+  build(built);
+  ASSERT_TRUE(built.save(filepath_));
+
+  std::vector<char> data = readFile();
+  data.back() ^= 1;
+  writeFile(data);
+
+  // Data is checked only on request
+  ReachabilityMap loaded;
+  EXPECT_TRUE(loaded.load(filepath_));
+  EXPECT_FALSE(loaded.load(filepath_, true));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
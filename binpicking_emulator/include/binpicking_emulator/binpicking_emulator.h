@@ -24,12 +24,25 @@ limitations under the License.
 #include <visualization_msgs/Marker.h>
 #include <tf/transform_broadcaster.h>
 #include <bin_pose_msgs/bin_pose.h>
+#include <bin_pose_msgs/bin_pose_batch.h>
+#include <bin_pose_msgs/bin_pose_pick_result.h>
+#include <bin_pose_emulator/reachability_map.h>
 #include <photoneo_msgs/operations.h>
 #include <photoneo_msgs/operation.h>
 #include <photoneo_msgs/initialize_pose.h>
 #include <photoneo_msgs/add_point.h>
 #include <photoneo_msgs/trigger_with_id.h>
 #include <pho_robot_loader/constants.h>
+#include <binpicking_emulator/trajectory_cache.h>
+#include <binpicking_emulator/ik_seed_cache.h>
+#include <binpicking_emulator/latency_model.h>
+#include <binpicking_emulator/sim_clock.h>
+#include <binpicking_emulator/trajectory_visualizer.h>
+#include <binpicking_emulator/planning_backend.h>
+#include <binpicking_emulator/planning_workers.h>
+#include <binpicking_emulator/cartesian_interpolator.h>
+#include <binpicking_emulator/trajectory_processor.h>
+#include <binpicking_emulator/metrics.h>
 
 // MoveIt!
 #include <moveit/robot_state/robot_state.h>
@@ -38,10 +51,131 @@ limitations under the License.
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Grasp candidate provided by bin pose emulator
+struct GraspCandidate
+{
+  geometry_msgs::Pose grasp_pose;
+  geometry_msgs::Pose approach_pose;
+  geometry_msgs::Pose deapproach_pose;
+
+  // Pile part being grasped, 0 when not known
+  uint32_t part_id;
+};
+
+// Wall time spent planning each leg of a pick, seconds
+struct PickTiming
+{
+  PickTiming() : start(0), approach(0), grasp(0), deapproach(0), end(0) {}
+
+  double start;
+  double approach;
+  double grasp;
+  double deapproach;
+  double end;
+};
+
+// Planned legs of a single grasp candidate
+struct PickPlan
+{
+  moveit_msgs::RobotTrajectory approach_trajectory;
+  moveit_msgs::RobotTrajectory grasp_trajectory;
+  moveit_msgs::RobotTrajectory deapproach_trajectory;
+  moveit_msgs::RobotTrajectory end_trajectory;
+
+  // Joint space path length of all legs, lower is better
+  double score;
+  uint32_t part_id;
+
+  PickTiming timing;
+};
+
+// Grasp candidates of one trajectory request shared with planning workers.
+// In "first" selection mode the request returns on first success, workers
+// still planning other candidates stop after their current leg
+struct CandidateBatch
+{
+  CandidateBatch(const robot_state::RobotState& start, const std::vector<GraspCandidate>& grasp_candidates,
+                 const std::vector<double>& end_joints)
+    : start_state(start)
+    , candidates(grasp_candidates)
+    , end_pose_from_robot(end_joints)
+    , plans(grasp_candidates.size())
+    , succeeded(grasp_candidates.size(), 0)
+    , next_candidate(0)
+    , first_succeeded(-1)
+    , cancelled(false)
+    , active_workers(0)
+  {
+  }
+
+  robot_state::RobotState start_state;
+  std::vector<GraspCandidate> candidates;
+  std::vector<double> end_pose_from_robot;
+
+  std::vector<PickPlan> plans;
+  std::vector<char> succeeded;
+  std::atomic<std::size_t> next_candidate;
+  std::atomic<int> first_succeeded;
+  std::atomic<bool> cancelled;
+
+  // Guards active_workers, done is notified on first success and when all workers finished
+  std::mutex mutex;
+  std::condition_variable done;
+  std::size_t active_workers;
+};
+
+// Next pick planned in background after scan
+struct SpeculativePlan
+{
+  SpeculativePlan() : cancelled(false)
+  {
+  }
+
+  std::vector<double> start_joints;
+  PickPlan plan;
+  std::future<bool> success;
+
+  // Set when the robot is not in the predicted state, planning stops at the next leg
+  std::atomic<bool> cancelled;
+};
+
+// State of a single robot cell served by the emulator
+struct VisionSystemContext
+{
+  int id;
+  std::vector<double> start_pose_from_robot;
+  std::vector<double> end_pose_from_robot;
+
+  // Planning backends and poses are guarded by planning mutex. Backend of
+  // each worker is used by the start leg only after its last batch finished
+  std::vector<PlanningBackendPtr> planning_backends;
+  std::shared_ptr<PlanningWorkers> planning_workers;
+  std::shared_ptr<CandidateBatch> last_batch;
+  std::mutex planning_mutex;
+
+  // Also guards last batch, lets it be cancelled while planning mutex is held
+  std::mutex batch_mutex;
+
+  std::shared_ptr<SpeculativePlan> speculative_plan;
+  std::mutex speculation_mutex;
+};
+
 class BinpickingEmulator
 {
 public:
-  BinpickingEmulator(ros::NodeHandle* nh);
+  // Private params are read from pnh, nodelets pass their private node handle
+  BinpickingEmulator(ros::NodeHandle* nh, ros::NodeHandle pnh = ros::NodeHandle("~"));
   ~BinpickingEmulator();
 
   bool binPickingScanCallback(photoneo_msgs::trigger_with_id::Request& req, photoneo_msgs::trigger_with_id::Response& res);
@@ -55,22 +189,112 @@ public:
   bool binPickingPickFailedCallback(photoneo_msgs::trigger_with_id::Request& req, photoneo_msgs::trigger_with_id::Response& res);
   bool changeSolutionCallback(photoneo_msgs::trigger_with_id::Request& req, photoneo_msgs::trigger_with_id::Response& res);
 
+  // Fast forward mode, emulated delays advance the clock instead of sleeping
+  void setSimClock(const std::shared_ptr<SimClock>& clock);
+
+  // Plans pick cycle without service round-trip, used by benchmarks
+  bool planPickCycle(int vision_system_id, const robot_state::RobotState& start_state, PickPlan& plan);
+  robot_state::RobotState getCurrentState();
+
 private:
   // Variables
-  ros::Publisher trajectory_pub_;
+  ros::NodeHandle nh_;
   ros::ServiceClient bin_pose_client_;
+  ros::ServiceClient bin_pose_batch_client_;
+  ros::ServiceClient bin_pose_pick_result_client_;
 
   robot_model_loader::RobotModelLoaderPtr robot_model_loader_;
+
+  // Planning backend, either move_group or in_process
+  std::string planning_backend_;
+  double planning_time_;
   moveit::planning_interface::MoveGroupInterfacePtr group_;
+  planning_scene_monitor::PlanningSceneMonitorPtr scene_monitor_;
+  planning_pipeline::PlanningPipelinePtr planning_pipeline_;
 
   int num_of_joints_;
-  std::vector<double> start_pose_from_robot_;
-  std::vector<double> end_pose_from_robot_;
 
-  int trajectory_marker_index_;
+  // Per vision system state
+  std::map<int, std::shared_ptr<VisionSystemContext> > contexts_;
+  std::mutex contexts_mutex_;
+
+  std::shared_ptr<TrajectoryVisualizer> visualizer_;
+
+  // Emulated vision and calibration delays
+  LatencyModel latency_model_;
+
+  // Multi candidate planning
+  int num_of_candidates_;
+  bool select_first_success_;
+  int planning_threads_;
+
+  // Non zero seed makes candidate stream reproducible
+  int candidate_seed_;
+  std::atomic<unsigned int> candidate_requests_;
+
+  // Speculative planning
+  bool speculative_planning_;
+  double speculation_tolerance_;
+
+  // Trajectory cache
+  std::shared_ptr<TrajectoryCache> trajectory_cache_;
+  std::shared_ptr<PlanningSceneFingerprint> scene_fingerprint_;
+  std::string trajectory_cache_file_;
+
+  // IK seed cache
+  std::shared_ptr<IkSeedCache> ik_seed_cache_;
+  std::string ik_seed_cache_file_;
+  double ik_timeout_;
+  std::mutex ik_mutex_;
+
+  // Precomputed IK solutions, seeds IK when the seed cache misses
+  std::shared_ptr<ReachabilityMap> reachability_map_;
+
+  // Latency of planning legs, IK, bin pose calls and visualization
+  Metrics metrics_;
+  ros::Publisher statistics_pub_;
+  ros::WallTimer statistics_timer_;
+  std::string statistics_file_;
+
+  // Cartesian legs, Jacobian interpolator replaces computeCartesianPath when set
+  std::shared_ptr<CartesianInterpolator> cartesian_interpolator_;
+  double cartesian_step_;
+
+  // Simplification and time parameterization of approach and end legs
+  std::shared_ptr<TrajectoryProcessor> trajectory_processor_;
 
   // Functions
-  void visualizeTrajectory(trajectory_msgs::JointTrajectory trajectory);
+  std::shared_ptr<VisionSystemContext> getContext(int vision_system_id);
+  std::shared_ptr<VisionSystemContext> createContext(int vision_system_id);
+  PlanningBackendPtr createPlanningBackend();
+  void publishStatistics(const ros::WallTimerEvent& event);
+  bool planPickCycle(VisionSystemContext& context, const robot_state::RobotState& start_state, PickPlan& plan,
+                     const std::atomic<bool>* cancel = nullptr);
+  void startSpeculativePlanning(VisionSystemContext& context);
+  bool takeSpeculativePlan(VisionSystemContext& context, const robot_state::RobotState& current_state,
+                           PickPlan& plan);
+  void discardSpeculativePlan(VisionSystemContext& context);
+  bool getCandidates(std::vector<GraspCandidate>& candidates);
+  void reportPick(const PickPlan& plan);
+  bool planCandidates(VisionSystemContext& context, const robot_state::RobotState& start_state,
+                      const std::vector<GraspCandidate>& candidates, PickPlan& plan,
+                      const std::atomic<bool>* cancel = nullptr);
+  void cancelBatch(CandidateBatch& batch);
+  void planBatch(CandidateBatch& batch, PlanningBackend& backend);
+  void waitForBatch(CandidateBatch& batch);
+  bool planPick(PlanningBackend& backend, const CandidateBatch& batch, const GraspCandidate& candidate,
+                PickPlan& plan);
+  bool planJointMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                       const std::vector<double>& joint_target, moveit_msgs::RobotTrajectory& trajectory);
+  bool planApproachMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                          const geometry_msgs::Pose& approach_pose, moveit_msgs::RobotTrajectory& trajectory);
+  bool planCartesianMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                           const geometry_msgs::Pose& from, const geometry_msgs::Pose& to,
+                           moveit_msgs::RobotTrajectory& trajectory);
+  void postProcess(PickPlan& plan);
+  void composeOperations(PickPlan& plan, photoneo_msgs::operations::Response& res);
+  void composeError(photoneo_msgs::operations::Response& res);
+  double jointPathLength(const trajectory_msgs::JointTrajectory& trajectory);
 
 };  // class
 
@@ -0,0 +1,49 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef BINPICKING_EMULATOR_SERVICES_H
+#define BINPICKING_EMULATOR_SERVICES_H
+
+#include <binpicking_emulator/binpicking_emulator.h>
+#include <binpicking_emulator/service_log.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Vision system services of the emulator, shared by the standalone node and the nodelet
+class BinpickingEmulatorServices
+{
+public:
+  // Served requests are recorded to record_file for service_replayer when not empty
+  BinpickingEmulatorServices(ros::NodeHandle* nh, BinpickingEmulator* emulator, const std::string& record_file);
+
+  // Clock of fast forward mode enabled by ~fast_forward, null when disabled
+  // or when /use_sim_time is not set
+  static std::shared_ptr<SimClock> createSimClock(ros::NodeHandle* nh, ros::NodeHandle pnh);
+
+  // Blocks until Moveit and bin pose emulator services are available, waits are
+  // in wall time so they do not depend on /clock. Returns false when interrupted
+  // by shutdown or by cancel flag
+  static bool waitForDependencies(double startup_delay, const std::atomic<bool>* cancel = nullptr);
+
+private:
+  std::shared_ptr<ServiceLogWriter> recorder_;
+  std::vector<ros::ServiceServer> services_;
+};
+
+#endif  // BINPICKING_EMULATOR_SERVICES_H
@@ -0,0 +1,81 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef CARTESIAN_INTERPOLATOR_H
+#define CARTESIAN_INTERPOLATOR_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/Pose.h>
+#include <moveit_msgs/RobotTrajectory.h>
+
+// MoveIt!
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <Eigen/Geometry>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Straight line tool motion for short approach/grasp/deapproach legs.
+// Every waypoint is reached by damped least squares Jacobian steps from
+// the previous solution, seeded IK is used only when stepping does not
+// converge. Interpolation stops at the first joint jump. The start state
+// has to be at the start pose of the path, otherwise nothing is achieved.
+class CartesianInterpolator
+{
+public:
+  CartesianInterpolator(const robot_model::RobotModelConstPtr& robot_model, const std::string& group_name,
+                        const std::string& tip_link, double position_step, double orientation_step,
+                        double jump_threshold, double ik_timeout, std::mutex& kinematics_mutex);
+  ~CartesianInterpolator();
+
+  // Returns fraction of the path achieved, same as computeCartesianPath
+  double interpolate(const robot_state::RobotState& start_state, const geometry_msgs::Pose& from,
+                     const geometry_msgs::Pose& target, moveit_msgs::RobotTrajectory& trajectory);
+
+  std::size_t ikFallbacks() const
+  {
+    return ik_fallbacks_;
+  }
+
+private:
+  bool stepTo(robot_state::RobotState& state, const Eigen::Affine3d& target);
+  bool solveIK(robot_state::RobotState& state, const Eigen::Affine3d& target);
+
+  robot_model::RobotModelConstPtr robot_model_;
+  const robot_model::JointModelGroup* joint_model_group_;
+  const robot_model::LinkModel* tip_link_;
+  std::string group_name_;
+
+  double position_step_;
+  double orientation_step_;
+  double jump_threshold_;
+  int max_iterations_;
+  double position_tolerance_;
+  double orientation_tolerance_;
+  double damping_;
+  double ik_timeout_;
+  double start_position_tolerance_;
+  double start_orientation_tolerance_;
+
+  std::mutex& kinematics_mutex_;
+  std::atomic<std::size_t> ik_fallbacks_;
+};
+
+#endif  // CARTESIAN_INTERPOLATOR_H
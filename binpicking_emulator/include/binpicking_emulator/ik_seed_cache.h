@@ -0,0 +1,67 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef IK_SEED_CACHE_H
+#define IK_SEED_CACHE_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/Pose.h>
+#include <bin_pose_emulator/config_data.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct IkSeed
+{
+  double position[3];
+  double orientation[4];  // x, y, z, w
+  std::vector<double> joints;
+};
+
+// Voxel grid over the bin volume storing successful IK solutions
+// of tool poses, used as seeds for the following IK queries.
+// Seeds hold one position per joint in joint_names, files of other joints are rejected
+class IkSeedCache
+{
+public:
+  IkSeedCache(const ConfigData& config, double voxel_size, std::size_t seeds_per_voxel,
+              const std::vector<std::string>& joint_names);
+  ~IkSeedCache();
+
+  bool nearest(const geometry_msgs::Pose& pose, std::vector<double>& joints);
+  void insert(const geometry_msgs::Pose& pose, const std::vector<double>& joints);
+
+  bool load(const std::string& filepath);
+  bool save(const std::string& filepath);
+
+  std::size_t size();
+
+private:
+  bool voxelIndex(double x, double y, double z, int index[3]) const;
+  void insertSeed(const IkSeed& seed);
+
+  double min_[3];
+  double voxel_size_;
+  int dimensions_[3];
+  std::size_t seeds_per_voxel_;
+  std::vector<std::string> joint_names_;
+
+  std::mutex mutex_;
+  std::vector<std::vector<IkSeed> > voxels_;
+};
+
+#endif  // IK_SEED_CACHE_H
@@ -0,0 +1,97 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef LATENCY_MODEL_H
+#define LATENCY_MODEL_H
+
+#include <ros/ros.h>
+#include <yaml-cpp/yaml.h>
+#include <binpicking_emulator/sim_clock.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace LATENCY
+{
+namespace SERVICE
+{
+const std::string SCAN = "scan";
+const std::string BIN_LOCATOR = "bin_locator";
+const std::string CALIBRATION_ADD_POINT = "calibration_add_point";
+const std::string CALIBRATION_SET_TO_SCANNER = "calibration_set_to_scanner";
+const std::string CALIBRATION_RESET = "calibration_reset";
+const std::string CALIBRATION_START = "calibration_start";
+const std::string PICK_FAILED = "pick_failed";
+const std::string CHANGE_SOLUTION = "change_solution";
+
+const std::vector<std::string> ALL = { SCAN, BIN_LOCATOR, CALIBRATION_ADD_POINT, CALIBRATION_SET_TO_SCANNER,
+                                       CALIBRATION_RESET, CALIBRATION_START, PICK_FAILED, CHANGE_SOLUTION };
+}
+}
+
+struct LatencyDistribution
+{
+  enum Type
+  {
+    FIXED,
+    UNIFORM,
+    NORMAL,
+    LOGNORMAL,
+    TRACE
+  };
+
+  Type type;
+  double a;  // value, min, mean or mu
+  double b;  // max, stddev or sigma
+  std::vector<double> trace;
+  std::size_t trace_index;
+};
+
+// Emulated processing time of vision and calibration services
+class LatencyModel
+{
+public:
+  LatencyModel();
+  ~LatencyModel();
+
+  // Applies the file only when it is valid as a whole, unknown services are rejected
+  bool load(const std::string& filepath);
+  void setFixed(const std::string& service, double seconds);
+  void setZeroLatency(bool zero_latency);
+  void setSeed(unsigned int seed);
+
+  // Delays advance the simulated clock instead of sleeping, null restores sleeping
+  void setClock(const std::shared_ptr<SimClock>& clock);
+
+  double sample(const std::string& service);
+  void sleep(const std::string& service);
+
+private:
+  bool parseDistribution(const YAML::Node& node, LatencyDistribution& distribution);
+  bool loadTrace(const std::string& filepath, std::vector<double>& trace);
+
+  bool zero_latency_;
+  std::shared_ptr<SimClock> clock_;
+  std::map<std::string, LatencyDistribution> distributions_;
+  std::mt19937 generator_;
+  std::mutex mutex_;
+};
+
+#endif  // LATENCY_MODEL_H
@@ -0,0 +1,109 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace METRICS
+{
+enum Metric
+{
+  TRAJECTORY_SERVICE,
+  START_LEG,
+  APPROACH_LEG,
+  GRASP_LEG,
+  DEAPPROACH_LEG,
+  END_LEG,
+  IK,
+  BIN_POSE_CALL,
+  VISUALIZATION,
+  POST_PROCESSING,
+  COUNT
+};
+}
+
+// Exact percentile of samples, p in [0, 1] rounded to the nearest rank, 0 if empty
+double percentile(std::vector<double> values, double p);
+
+struct LatencySummary
+{
+  uint64_t count;
+  double mean;  // seconds
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+// Lock free histogram with power of two microsecond buckets,
+// percentiles are reported as bucket upper bounds
+class LatencyHistogram
+{
+public:
+  static const int BUCKETS = 40;
+
+  LatencyHistogram();
+
+  void record(double seconds);
+  LatencySummary summary() const;
+
+private:
+  std::atomic<uint64_t> buckets_[BUCKETS];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_ns_;
+  std::atomic<uint64_t> max_ns_;
+};
+
+// Records lifetime of the scope to histogram, optionally also to elapsed
+class ScopedTimer
+{
+public:
+  ScopedTimer(LatencyHistogram& histogram, double* elapsed = NULL);
+  ~ScopedTimer();
+
+private:
+  LatencyHistogram& histogram_;
+  double* elapsed_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+class Metrics
+{
+public:
+  LatencyHistogram& operator[](METRICS::Metric metric)
+  {
+    return histograms_[metric];
+  }
+
+  static const char* name(METRICS::Metric metric);
+
+  void toDiagnostics(diagnostic_msgs::DiagnosticArray& array) const;
+  std::string dump() const;
+
+private:
+  LatencyHistogram histograms_[METRICS::COUNT];
+};
+
+#endif  // METRICS_H
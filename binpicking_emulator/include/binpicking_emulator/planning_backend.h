@@ -0,0 +1,126 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef PLANNING_BACKEND_H
+#define PLANNING_BACKEND_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/Pose.h>
+#include <moveit_msgs/RobotTrajectory.h>
+#include <moveit_msgs/GetMotionPlan.h>
+#include <moveit_msgs/Constraints.h>
+
+// MoveIt!
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_pipeline/planning_pipeline.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+
+#include <memory>
+#include <mutex>
+
+// Plans single legs of the pick, start state is always given explicitly.
+// Every planning thread owns its own backend instance.
+class PlanningBackend
+{
+public:
+  virtual ~PlanningBackend() {}
+
+  virtual bool planToJointTarget(const robot_state::RobotState& start_state, const std::vector<double>& joint_target,
+                                 moveit_msgs::RobotTrajectory& trajectory) = 0;
+  virtual bool planToStateTarget(const robot_state::RobotState& start_state, const robot_state::RobotState& goal_state,
+                                 moveit_msgs::RobotTrajectory& trajectory) = 0;
+  virtual bool planToPoseTarget(const robot_state::RobotState& start_state, const geometry_msgs::Pose& pose_target,
+                                moveit_msgs::RobotTrajectory& trajectory) = 0;
+  virtual double computeCartesianPath(const robot_state::RobotState& start_state,
+                                      const std::vector<geometry_msgs::Pose>& waypoints, double eef_step,
+                                      moveit_msgs::RobotTrajectory& trajectory) = 0;
+  virtual std::string getEndEffectorLink() = 0;
+};
+
+typedef std::shared_ptr<PlanningBackend> PlanningBackendPtr;
+
+// Plans through move_group node
+class MoveGroupBackend : public PlanningBackend
+{
+public:
+  MoveGroupBackend(ros::NodeHandle& nh, const std::string& group_name, const std::string& planner_id,
+                   double goal_tolerance);
+  ~MoveGroupBackend();
+
+  bool planToJointTarget(const robot_state::RobotState& start_state, const std::vector<double>& joint_target,
+                         moveit_msgs::RobotTrajectory& trajectory);
+  bool planToStateTarget(const robot_state::RobotState& start_state, const robot_state::RobotState& goal_state,
+                         moveit_msgs::RobotTrajectory& trajectory);
+  bool planToPoseTarget(const robot_state::RobotState& start_state, const geometry_msgs::Pose& pose_target,
+                        moveit_msgs::RobotTrajectory& trajectory);
+  double computeCartesianPath(const robot_state::RobotState& start_state,
+                              const std::vector<geometry_msgs::Pose>& waypoints, double eef_step,
+                              moveit_msgs::RobotTrajectory& trajectory);
+  std::string getEndEffectorLink();
+
+private:
+  bool plan(moveit_msgs::RobotTrajectory& trajectory);
+
+  moveit::planning_interface::MoveGroupInterfacePtr group_;
+  ros::ServiceClient plan_client_;
+};
+
+// Plans by direct calls of planning pipeline loaded in the emulator process.
+// Plans run on a private copy of the monitored scene, recloned when the
+// monitor reports an update, so planning never holds the scene lock.
+// Kinematics solver of the group is shared, pose goals sampled by IK in the
+// pipeline are serialized with kinematics_mutex like other IK calls.
+class PipelineBackend : public PlanningBackend
+{
+public:
+  PipelineBackend(const planning_scene_monitor::PlanningSceneMonitorPtr& scene_monitor,
+                  const planning_pipeline::PlanningPipelinePtr& pipeline, const std::string& group_name,
+                  const std::string& planner_id, double goal_tolerance, double planning_time,
+                  std::mutex& kinematics_mutex);
+  ~PipelineBackend();
+
+  bool planToJointTarget(const robot_state::RobotState& start_state, const std::vector<double>& joint_target,
+                         moveit_msgs::RobotTrajectory& trajectory);
+  bool planToStateTarget(const robot_state::RobotState& start_state, const robot_state::RobotState& goal_state,
+                         moveit_msgs::RobotTrajectory& trajectory);
+  bool planToPoseTarget(const robot_state::RobotState& start_state, const geometry_msgs::Pose& pose_target,
+                        moveit_msgs::RobotTrajectory& trajectory);
+  double computeCartesianPath(const robot_state::RobotState& start_state,
+                              const std::vector<geometry_msgs::Pose>& waypoints, double eef_step,
+                              moveit_msgs::RobotTrajectory& trajectory);
+  std::string getEndEffectorLink();
+
+private:
+  bool plan(const robot_state::RobotState& start_state, const moveit_msgs::Constraints& goal,
+            moveit_msgs::RobotTrajectory& trajectory);
+  robot_state::RobotState toSceneState(const robot_state::RobotState& state);
+  planning_scene::PlanningSceneConstPtr sceneSnapshot();
+
+  planning_scene_monitor::PlanningSceneMonitorPtr scene_monitor_;
+  planning_scene::PlanningScenePtr scene_snapshot_;
+  ros::Time snapshot_time_;
+  planning_pipeline::PlanningPipelinePtr pipeline_;
+  const robot_state::JointModelGroup* joint_model_group_;
+
+  std::string group_name_;
+  std::string planner_id_;
+  double goal_tolerance_;
+  double planning_time_;
+  std::mutex& kinematics_mutex_;
+};
+
+#endif  // PLANNING_BACKEND_H
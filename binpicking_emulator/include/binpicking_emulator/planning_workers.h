@@ -0,0 +1,49 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef PLANNING_WORKERS_H
+#define PLANNING_WORKERS_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent planning threads of one vision system. Each worker owns one
+// planning backend, so tasks are posted to a given worker and run in order.
+// Pending tasks are finished before the workers are joined on destruction.
+class PlanningWorkers
+{
+public:
+  PlanningWorkers(std::size_t count);
+  ~PlanningWorkers();
+
+  void post(std::size_t worker, const std::function<void()>& task);
+  std::size_t size() const;
+
+private:
+  void run(std::size_t worker);
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<std::deque<std::function<void()> > > tasks_;
+  bool running_;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // PLANNING_WORKERS_H
@@ -0,0 +1,126 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef SERVICE_LOG_H
+#define SERVICE_LOG_H
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <photoneo_msgs/operations.h>
+#include <photoneo_msgs/initialize_pose.h>
+#include <photoneo_msgs/trigger_with_id.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace RECORDED_SERVICE
+{
+enum Service
+{
+  INITIALIZE,
+  SCAN,
+  TRAJECTORY,
+  PICK_FAILED,
+  CHANGE_SOLUTION,
+  COUNT
+};
+
+const char* name(Service service);
+
+// Outcome reported to the vision system, used by recorder and replayer alike.
+// Trajectory requests fail with an ERROR operation instead of a success flag
+bool succeeded(const photoneo_msgs::operations::Response& res);
+bool succeeded(const photoneo_msgs::initialize_pose::Response& res);
+bool succeeded(const photoneo_msgs::trigger_with_id::Response& res);
+}
+
+// Served request with its response, messages are kept in ROS wire format
+struct ServiceRecord
+{
+  RECORDED_SERVICE::Service service;
+  bool success;  // served and succeeded() by response
+  uint32_t vision_system_id;
+  int64_t stamp;     // nanoseconds since start of recording
+  int64_t duration;  // nanoseconds spent in callback
+  std::vector<uint8_t> request;
+  std::vector<uint8_t> response;
+};
+
+template <class Message>
+std::vector<uint8_t> serializeMessage(const Message& message)
+{
+  std::vector<uint8_t> buffer(ros::serialization::serializationLength(message));
+  ros::serialization::OStream stream(buffer.data(), buffer.size());
+  ros::serialization::serialize(stream, message);
+  return buffer;
+}
+
+template <class Message>
+void deserializeMessage(const std::vector<uint8_t>& buffer, Message& message)
+{
+  ros::serialization::IStream stream(const_cast<uint8_t*>(buffer.data()), buffer.size());
+  ros::serialization::deserialize(stream, message);
+}
+
+// Appends records to a binary log, every record is flushed at once
+// so the log stays readable when the emulator is killed
+class ServiceLogWriter
+{
+public:
+  ServiceLogWriter();
+
+  bool open(const std::string& filepath);
+  int64_t now() const;
+
+  template <class Request, class Response>
+  void write(RECORDED_SERVICE::Service service, uint32_t vision_system_id, int64_t stamp, bool success,
+             const Request& req, const Response& res)
+  {
+    ServiceRecord record;
+    record.service = service;
+    record.success = success;
+    record.vision_system_id = vision_system_id;
+    record.stamp = stamp;
+    record.duration = now() - stamp;
+    record.request = serializeMessage(req);
+    record.response = serializeMessage(res);
+    write(record);
+  }
+
+  void write(const ServiceRecord& record);
+
+private:
+  std::chrono::steady_clock::time_point start_;
+  std::mutex mutex_;
+  std::ofstream file_;
+};
+
+// Reads records in order, truncated last record is ignored
+class ServiceLogReader
+{
+public:
+  bool open(const std::string& filepath);
+  bool next(ServiceRecord& record);
+
+private:
+  std::ifstream file_;
+};
+
+#endif  // SERVICE_LOG_H
@@ -0,0 +1,60 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <rosgraph_msgs/Clock.h>
+
+#include <memory>
+#include <mutex>
+
+// Publishes /clock when the emulation runs in fast forward mode. Emulated
+// service delays move the clock forward at once instead of sleeping, in
+// between the clock follows wall time and is published at clock_publish_rate
+// in Hz. With zero clock_publish_rate time moves only by emulated delays, so for a seeded latency model and
+// the same request sequence every stamp is reproducible. Delays of
+// concurrently served vision systems are applied one after another.
+// Wall time ticks run on an own spinner, so the clock moves also while
+// the process waits for its dependencies and before the main spinner starts.
+class SimClock
+{
+public:
+  SimClock(ros::NodeHandle* nh, double clock_publish_rate);
+  ~SimClock();
+
+  // Moves the clock seconds forward, returns immediately
+  void advance(double seconds);
+  ros::Time now();
+
+private:
+  void publish(const ros::Time& time);
+  void timerCallback(const ros::WallTimerEvent& event);
+
+  ros::Publisher clock_pub_;
+  ros::CallbackQueue queue_;
+  ros::WallTimer timer_;
+  std::unique_ptr<ros::AsyncSpinner> spinner_;
+
+  // Guards time_ and last_wall_time_
+  std::mutex mutex_;
+  ros::Time time_;
+  ros::WallTime last_wall_time_;
+};
+
+#endif  // SIM_CLOCK_H
@@ -0,0 +1,100 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef TRAJECTORY_CACHE_H
+#define TRAJECTORY_CACHE_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/Pose.h>
+#include <moveit_msgs/RobotTrajectory.h>
+#include <moveit_msgs/PlanningScene.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Tracks fingerprint of collision objects in the planning scene. Fingerprint
+// changes only when the world changes, so identical republished objects
+// keep cached trajectories valid, also across emulator restarts.
+// Diffs apply only on top of a full scene, it is requested from move_group
+// at startup and get() fails until one was received.
+class PlanningSceneFingerprint
+{
+public:
+  PlanningSceneFingerprint(ros::NodeHandle* nh);
+  ~PlanningSceneFingerprint();
+
+  bool get(uint64_t& fingerprint);
+
+private:
+  void sceneCallback(const moveit_msgs::PlanningSceneConstPtr& msg);
+  void requestScene();
+  void applyScene(const moveit_msgs::PlanningScene& scene);
+
+  ros::Subscriber scene_sub_;
+  ros::ServiceClient scene_client_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, uint64_t> object_hashes_;
+  uint64_t fingerprint_;
+  bool complete_;
+};
+
+// LRU cache of planned trajectories keyed by quantized start state,
+// quantized goal and planning scene fingerprint
+class TrajectoryCache
+{
+public:
+  TrajectoryCache(std::size_t capacity, double joint_resolution, double position_resolution,
+                  double orientation_resolution);
+  ~TrajectoryCache();
+
+  std::string jointGoalKey(const std::vector<double>& start, const std::vector<double>& goal,
+                           uint64_t scene_fingerprint) const;
+  std::string poseGoalKey(const std::vector<double>& start, const geometry_msgs::Pose& goal,
+                          uint64_t scene_fingerprint) const;
+
+  bool get(const std::string& key, moveit_msgs::RobotTrajectory& trajectory);
+  void put(const std::string& key, const moveit_msgs::RobotTrajectory& trajectory);
+
+  bool load(const std::string& filepath);
+  bool save(const std::string& filepath);
+
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+private:
+  typedef std::pair<std::string, moveit_msgs::RobotTrajectory> Entry;
+
+  void appendQuantized(std::string& key, double value, double resolution) const;
+  void insert(const std::string& key, const moveit_msgs::RobotTrajectory& trajectory);
+
+  std::size_t capacity_;
+  double joint_resolution_;
+  double position_resolution_;
+  double orientation_resolution_;
+
+  std::mutex mutex_;
+  std::list<Entry> entries_;  // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+  std::size_t hits_;
+  std::size_t misses_;
+};
+
+uint64_t fnv1aHash(const uint8_t* data, std::size_t size, uint64_t hash = 14695981039346656037ULL);
+
+#endif  // TRAJECTORY_CACHE_H
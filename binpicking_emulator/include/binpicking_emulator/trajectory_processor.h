@@ -0,0 +1,74 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef TRAJECTORY_PROCESSOR_H
+#define TRAJECTORY_PROCESSOR_H
+
+#include <ros/ros.h>
+#include <moveit_msgs/RobotTrajectory.h>
+
+// MoveIt!
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/planning_scene/planning_scene.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+typedef std::vector<std::vector<double> > JointPath;
+
+// Post-processing of free space legs before they are sent to the robot.
+// Waypoints deviating from a straight joint space segment less than the
+// tolerance are dropped, remaining path is shortcut where the straight
+// segment is collision free and time stamps are computed again. End points
+// of the leg are always kept. Every segment replacing dropped waypoints is
+// collision checked, waypoints of colliding segments are restored.
+class TrajectoryProcessor
+{
+public:
+  TrajectoryProcessor(const robot_model::RobotModelConstPtr& robot_model, const std::string& group_name,
+                      double tolerance, double collision_resolution);
+
+  // Trajectory is left unchanged without planning scene
+  void process(moveit_msgs::RobotTrajectory& trajectory, const planning_scene::PlanningSceneConstPtr& scene);
+
+  std::size_t inputPoints() const
+  {
+    return input_points_;
+  }
+
+  std::size_t outputPoints() const
+  {
+    return output_points_;
+  }
+
+private:
+  void simplify(const JointPath& path, std::size_t first, std::size_t last, std::vector<bool>& keep) const;
+  void shortcut(JointPath& path, const planning_scene::PlanningScene& scene) const;
+  bool segmentValid(const std::vector<double>& from, const std::vector<double>& to,
+                    const planning_scene::PlanningScene& scene) const;
+
+  robot_model::RobotModelConstPtr robot_model_;
+  const robot_model::JointModelGroup* joint_model_group_;
+  std::string group_name_;
+  double tolerance_;
+  double collision_resolution_;
+
+  std::atomic<std::size_t> input_points_;
+  std::atomic<std::size_t> output_points_;
+};
+
+#endif  // TRAJECTORY_PROCESSOR_H
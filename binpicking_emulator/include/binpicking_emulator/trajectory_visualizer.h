@@ -0,0 +1,69 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef TRAJECTORY_VISUALIZER_H
+#define TRAJECTORY_VISUALIZER_H
+
+#include <ros/ros.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <visualization_msgs/MarkerArray.h>
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Publishes tool path of planned trajectories from a background thread,
+// one LINE_STRIP marker per trajectory segment in namespace of the vision system
+class TrajectoryVisualizer
+{
+public:
+  TrajectoryVisualizer(ros::NodeHandle* nh, const robot_model::RobotModelConstPtr& robot_model,
+                       std::size_t queue_size, double max_rate);
+  ~TrajectoryVisualizer();
+
+  // Never blocks, drops the oldest request when queue is full
+  void visualize(int vision_system_id, const std::vector<trajectory_msgs::JointTrajectory>& segments);
+
+private:
+  struct Request
+  {
+    int vision_system_id;
+    std::vector<trajectory_msgs::JointTrajectory> segments;
+  };
+
+  void run();
+  void publish(const Request& request);
+
+  ros::Publisher trajectory_pub_;
+  robot_state::RobotState kinematic_state_;
+
+  std::size_t queue_size_;
+  std::chrono::steady_clock::duration min_period_;
+  std::chrono::steady_clock::time_point last_publish_;
+
+  std::deque<Request> queue_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool running_;
+  std::thread thread_;
+};
+
+#endif  // TRAJECTORY_VISUALIZER_H
@@ -18,14 +18,39 @@ limitations under the License.
 
 using namespace pho_robot_loader;
 
-BinpickingEmulator::BinpickingEmulator(ros::NodeHandle* nh) : trajectory_marker_index_(0)
+BinpickingEmulator::BinpickingEmulator(ros::NodeHandle* nh, ros::NodeHandle pnh) : nh_(*nh), candidate_requests_(0)
 {
-  // Initialize Moveit group
-  group_.reset(new moveit::planning_interface::MoveGroupInterface("manipulator"));
-
   // Load robot description
   robot_model_loader_.reset(new robot_model_loader::RobotModelLoader("robot_description"));
 
+  // Initialize planning backend
+  std::string pipeline_namespace;
+  pnh.param<std::string>("planning_backend", planning_backend_, "move_group");
+  pnh.param<std::string>("pipeline_namespace", pipeline_namespace, "move_group");
+  pnh.param<double>("planning_time", planning_time_, 5.0);
+
+  if (planning_backend_ == "in_process")
+  {
+    // Mirror planning scene of move_group and load its planning pipeline
+    scene_monitor_.reset(new planning_scene_monitor::PlanningSceneMonitor(robot_model_loader_));
+    scene_monitor_->startSceneMonitor("move_group/monitored_planning_scene");
+    scene_monitor_->startStateMonitor();
+    scene_monitor_->requestPlanningSceneState();
+
+    planning_pipeline_.reset(new planning_pipeline::PlanningPipeline(
+        robot_model_loader_->getModel(), ros::NodeHandle(pipeline_namespace), "planning_plugin", "request_adapters"));
+
+    ROS_INFO("BIN PICKING EMULATOR: Using in process planning pipeline");
+  }
+  else
+  {
+    if (planning_backend_ != "move_group")
+      ROS_WARN("BIN PICKING EMULATOR: Unknown planning backend %s, using move_group", planning_backend_.c_str());
+
+    planning_backend_ = "move_group";
+    group_.reset(new moveit::planning_interface::MoveGroupInterface("manipulator"));
+  }
+
   // Load num of joints
   bool num_of_joints_success = nh->getParam("photoneo_module/num_of_joints", num_of_joints_);
   if (!num_of_joints_success)
@@ -34,23 +59,230 @@ BinpickingEmulator::BinpickingEmulator(ros::NodeHandle* nh) : trajectory_marker_
     num_of_joints_ = 6;
   }
 
-  // Resize start and end pose arrays
-  start_pose_from_robot_.resize(num_of_joints_);
-  end_pose_from_robot_.resize(num_of_joints_);
-
   // Configure bin pose client
   bin_pose_client_ = nh->serviceClient<bin_pose_msgs::bin_pose>("bin_pose");
+  bin_pose_batch_client_ = nh->serviceClient<bin_pose_msgs::bin_pose_batch>("bin_pose_batch");
+  bin_pose_pick_result_client_ = nh->serviceClient<bin_pose_msgs::bin_pose_pick_result>("bin_pose_pick_result");
+
+
+  // Configure trajectory visualization
+  bool visualize_trajectory;
+  int visualization_queue_size;
+  double visualization_rate;
+  pnh.param<bool>("visualize_trajectory", visualize_trajectory, true);
+  pnh.param<int>("visualization_queue_size", visualization_queue_size, 8);
+  pnh.param<double>("visualization_rate", visualization_rate, 0);
+
+  if (visualize_trajectory)
+    visualizer_.reset(
+        new TrajectoryVisualizer(nh, robot_model_loader_->getModel(), visualization_queue_size, visualization_rate));
+
+  // Configure latency model, defaults match delays of real vision system
+  latency_model_.setFixed(LATENCY::SERVICE::SCAN, 5);
+  latency_model_.setFixed(LATENCY::SERVICE::BIN_LOCATOR, 5);
+  latency_model_.setFixed(LATENCY::SERVICE::CALIBRATION_ADD_POINT, 5);
+  latency_model_.setFixed(LATENCY::SERVICE::CALIBRATION_SET_TO_SCANNER, 2);
+  latency_model_.setFixed(LATENCY::SERVICE::CALIBRATION_RESET, 2);
+  latency_model_.setFixed(LATENCY::SERVICE::CALIBRATION_START, 2);
+  latency_model_.setFixed(LATENCY::SERVICE::PICK_FAILED, 5);
+  latency_model_.setFixed(LATENCY::SERVICE::CHANGE_SOLUTION, 5);
+
+  std::string latency_config;
+  if (pnh.getParam("latency_config", latency_config) && !latency_config.empty() &&
+      !latency_model_.load(latency_config))
+    ROS_WARN("BIN PICKING EMULATOR: Latency config %s not applied, using default delays", latency_config.c_str());
+
+  bool zero_latency;
+  if (pnh.getParam("zero_latency", zero_latency))
+    latency_model_.setZeroLatency(zero_latency);
+
+  // Speculative planning of next pick after scan
+  pnh.param<bool>("speculative_planning", speculative_planning_, false);
+  pnh.param<double>("speculation_tolerance", speculation_tolerance_, 0.01);
+
+  // Load multi candidate planning params
+  std::string candidate_selection;
+  pnh.param<int>("num_of_candidates", num_of_candidates_, 1);
+  pnh.param<int>("planning_threads", planning_threads_, 1);
+  pnh.param<std::string>("candidate_selection", candidate_selection, "first");
+  num_of_candidates_ = std::max(num_of_candidates_, 1);
+  planning_threads_ = std::max(std::min(planning_threads_, num_of_candidates_), 1);
+  select_first_success_ = (candidate_selection != "best");
+  pnh.param<int>("candidate_seed", candidate_seed_, 0);
+
+  ROS_INFO("BIN PICKING EMULATOR: Planning %d grasp candidates on %d threads per vision system, selecting %s",
+           num_of_candidates_, planning_threads_, select_first_success_ ? "first success" : "best score");
+
+  // Configure trajectory cache, zero size disables caching
+  int trajectory_cache_size;
+  double joint_resolution, position_resolution, orientation_resolution;
+  pnh.param<int>("trajectory_cache_size", trajectory_cache_size, 64);
+  pnh.param<double>("trajectory_cache_joint_resolution", joint_resolution, 0.001);
+  pnh.param<double>("trajectory_cache_position_resolution", position_resolution, 0.001);
+  pnh.param<double>("trajectory_cache_orientation_resolution", orientation_resolution, 0.001);
+  pnh.param<std::string>("trajectory_cache_file", trajectory_cache_file_, "");
+
+  if (trajectory_cache_size > 0)
+  {
+    trajectory_cache_.reset(
+        new TrajectoryCache(trajectory_cache_size, joint_resolution, position_resolution, orientation_resolution));
+    scene_fingerprint_.reset(new PlanningSceneFingerprint(nh));
 
-  // Set trajectory visualization publisher
-  trajectory_pub_ = nh->advertise<visualization_msgs::Marker>("trajectory", 1);
+    if (!trajectory_cache_file_.empty())
+      trajectory_cache_->load(trajectory_cache_file_);
+  }
 
-  // Set move group params
-  group_->setPlannerId("RRTConnectkConfigDefault");
-  group_->setGoalTolerance(0.001);
+  // Configure IK seed cache over the bin volume of bin pose emulator
+  bool ik_seed_cache;
+  double ik_seed_voxel_size;
+  int ik_seeds_per_voxel;
+  pnh.param<bool>("ik_seed_cache", ik_seed_cache, true);
+  pnh.param<double>("ik_seed_voxel_size", ik_seed_voxel_size, 0.02);
+  pnh.param<int>("ik_seeds_per_voxel", ik_seeds_per_voxel, 4);
+  pnh.param<double>("ik_timeout", ik_timeout_, 0.005);
+  pnh.param<std::string>("ik_seed_cache_file", ik_seed_cache_file_, "");
+
+  if (ik_seed_cache && ik_seed_voxel_size <= 0)
+    ROS_ERROR("BIN PICKING EMULATOR: ik_seed_voxel_size has to be positive, IK seed cache disabled");
+  else if (ik_seed_cache)
+  {
+    std::string bin_config_filepath;
+    ConfigData bin_config;
+    if (nh->getParam("filepath", bin_config_filepath) && loadConfigData(bin_config_filepath, bin_config))
+    {
+      const std::vector<std::string>& joint_names =
+          robot_model_loader_->getModel()->getJointModelGroup("manipulator")->getVariableNames();
+      ik_seed_cache_.reset(new IkSeedCache(bin_config, ik_seed_voxel_size, ik_seeds_per_voxel, joint_names));
+
+      if (!ik_seed_cache_file_.empty())
+        ik_seed_cache_->load(ik_seed_cache_file_);
+    }
+    else
+      ROS_WARN("BIN PICKING EMULATOR: Not able to load bin config from ""filepath"" param, IK seed cache disabled");
+  }
+
+  // Reachability map built by reachability_builder, joint order has to match the group
+  std::string reachability_map;
+  bool verify_reachability_map;
+  pnh.param<bool>("verify_reachability_map", verify_reachability_map, false);
+  if (pnh.getParam("reachability_map", reachability_map) && !reachability_map.empty())
+  {
+    reachability_map_.reset(new ReachabilityMap());
+    const std::vector<std::string>& joint_names =
+        robot_model_loader_->getModel()->getJointModelGroup("manipulator")->getVariableNames();
+
+    if (!reachability_map_->load(reachability_map, verify_reachability_map))
+    {
+      ROS_ERROR("BIN PICKING EMULATOR: Not able to load reachability map %s", reachability_map.c_str());
+      reachability_map_.reset();
+    }
+    else if (reachability_map_->jointNames() != joint_names)
+    {
+      ROS_ERROR("BIN PICKING EMULATOR: Reachability map %s was built for other joints", reachability_map.c_str());
+      reachability_map_.reset();
+    }
+    else
+      ROS_INFO("BIN PICKING EMULATOR: Loaded reachability map with %zu cells", reachability_map_->size());
+  }
+
+  // Configure statistics topic, zero period disables publishing
+  double statistics_period;
+  pnh.param<double>("statistics_period", statistics_period, 5.0);
+  pnh.param<std::string>("statistics_file", statistics_file_, "");
+
+  if (statistics_period > 0)
+  {
+    statistics_pub_ = pnh.advertise<diagnostic_msgs::DiagnosticArray>("statistics", 1);
+    statistics_timer_ =
+        nh->createWallTimer(ros::WallDuration(statistics_period), &BinpickingEmulator::publishStatistics, this);
+  }
+
+  // Configure interpolation of grasp and deapproach legs
+  std::string cartesian_interpolator;
+  std::string cartesian_tip_link;
+  double cartesian_orientation_step, cartesian_jump_threshold;
+  const robot_model::JointModelGroup* joint_model_group =
+      robot_model_loader_->getModel()->getJointModelGroup("manipulator");
+  pnh.param<std::string>("cartesian_interpolator", cartesian_interpolator, "moveit");
+  pnh.param<std::string>("cartesian_tip_link", cartesian_tip_link, joint_model_group->getLinkModelNames().back());
+  pnh.param<double>("cartesian_step", cartesian_step_, 0.02);
+  pnh.param<double>("cartesian_orientation_step", cartesian_orientation_step, 0.05);
+  pnh.param<double>("cartesian_jump_threshold", cartesian_jump_threshold, 0.2);
+
+  if (cartesian_interpolator == "jacobian")
+  {
+    cartesian_interpolator_.reset(new CartesianInterpolator(robot_model_loader_->getModel(), "manipulator",
+                                                            cartesian_tip_link, cartesian_step_,
+                                                            cartesian_orientation_step, cartesian_jump_threshold,
+                                                            ik_timeout_, ik_mutex_));
+    ROS_INFO("BIN PICKING EMULATOR: Using Jacobian cartesian interpolator with step %.3f m", cartesian_step_);
+  }
+
+  // Configure post-processing of free space legs, zero tolerance disables it.
+  // Simplified legs are checked for collisions, so the scene of in_process backend is required
+  double simplification_tolerance, shortcut_resolution;
+  pnh.param<double>("simplification_tolerance", simplification_tolerance, scene_monitor_ ? 0.01 : 0.0);
+  pnh.param<double>("shortcut_resolution", shortcut_resolution, 0.02);
+
+  if (simplification_tolerance > 0 && !scene_monitor_)
+    ROS_INFO("BIN PICKING EMULATOR: Trajectory post-processing requires in_process planning backend, disabled");
+  else if (simplification_tolerance > 0)
+    trajectory_processor_.reset(new TrajectoryProcessor(robot_model_loader_->getModel(), "manipulator",
+                                                        simplification_tolerance, shortcut_resolution));
+
+  // Contexts of known vision systems are created up front, others on their first request
+  std::vector<int> vision_system_ids;
+  pnh.param<std::vector<int> >("vision_system_ids", vision_system_ids, std::vector<int>());
+  for (std::size_t i = 0; i < vision_system_ids.size(); i++)
+    getContext(vision_system_ids[i]);
 }
 
 BinpickingEmulator::~BinpickingEmulator()
 {
+  for (auto it = contexts_.begin(); it != contexts_.end(); ++it)
+    discardSpeculativePlan(*it->second);
+
+  // Join planning workers while the emulator they plan with still exists
+  contexts_.clear();
+
+  statistics_timer_.stop();
+  std::string statistics = metrics_.dump();
+  ROS_INFO("BIN PICKING EMULATOR: Latency statistics\n%s", statistics.c_str());
+
+  if (!statistics_file_.empty())
+  {
+    std::ofstream file(statistics_file_.c_str());
+    file << statistics;
+  }
+
+  if (trajectory_cache_)
+  {
+    ROS_INFO("BIN PICKING EMULATOR: Trajectory cache hits: %zu, misses: %zu", trajectory_cache_->hits(),
+             trajectory_cache_->misses());
+
+    if (!trajectory_cache_file_.empty())
+      trajectory_cache_->save(trajectory_cache_file_);
+  }
+
+  if (cartesian_interpolator_)
+    ROS_INFO("BIN PICKING EMULATOR: Cartesian interpolator IK fallbacks: %zu", cartesian_interpolator_->ikFallbacks());
+
+  if (trajectory_processor_)
+    ROS_INFO("BIN PICKING EMULATOR: Post-processing kept %zu of %zu waypoints", trajectory_processor_->outputPoints(),
+             trajectory_processor_->inputPoints());
+
+  if (ik_seed_cache_)
+  {
+    ROS_INFO("BIN PICKING EMULATOR: IK seed cache holds %zu seeds", ik_seed_cache_->size());
+
+    if (!ik_seed_cache_file_.empty())
+      ik_seed_cache_->save(ik_seed_cache_file_);
+  }
+}
+
+void BinpickingEmulator::setSimClock(const std::shared_ptr<SimClock>& clock)
+{
+  latency_model_.setClock(clock);
 }
 
 bool BinpickingEmulator::binPickingScanCallback(photoneo_msgs::trigger_with_id::Request& req, photoneo_msgs::trigger_with_id::Response& res)
@@ -58,7 +290,12 @@ bool BinpickingEmulator::binPickingScanCallback(photoneo_msgs::trigger_with_id::
   ROS_INFO("BIN PICKING EMULATOR: Binpicking Scan Service called");
   ROS_INFO("BIN PICKING EMULATOR: Vision system ID %d", req.id);
 
-  ros::Duration(5).sleep();
+  latency_model_.sleep(LATENCY::SERVICE::SCAN);
+
+  // Plan next pick while robot finishes current one
+  if (speculative_planning_)
+    startSpeculativePlanning(*getContext(req.id));
+
   res.success = true;
   return true;
 }
@@ -69,307 +306,664 @@ bool BinpickingEmulator::binPickingTrajCallback(photoneo_msgs::operations::Reque
   ROS_INFO("BIN PICKING EMULATOR: Binpicking Trajectory Service called");
   ROS_INFO("BIN PICKING EMULATOR: Vision system ID %d", req.vision_system_id);
 
-  int start_traj_size, approach_traj_size, grasp_traj_size, deapproach_traj_size, end_traj_size;
-  moveit::planning_interface::MoveGroupInterface::Plan to_start_pose;
-  moveit::planning_interface::MoveGroupInterface::Plan to_approach_pose;
-  moveit_msgs::RobotTrajectory to_grasp_pose;
-  moveit_msgs::RobotTrajectory to_deapproach_pose;
-  moveit::planning_interface::MoveGroupInterface::Plan to_end_pose;
+  ScopedTimer service_timer(metrics_[METRICS::TRAJECTORY_SERVICE]);
+  std::shared_ptr<VisionSystemContext> context = getContext(req.vision_system_id);
 
   // Get current state
-  robot_state::RobotState current_state(*group_->getCurrentState());
+  robot_state::RobotState current_state = getCurrentState();
 
-  //---------------------------------------------------
-  // Set Start state
-  //---------------------------------------------------
-  group_->setJointValueTarget(start_pose_from_robot_);
-  group_->plan(to_start_pose);
-  start_traj_size = to_start_pose.trajectory_.joint_trajectory.points.size();
-  current_state.setJointGroupPositions(
-      "manipulator", to_start_pose.trajectory_.joint_trajectory.points[start_traj_size - 1].positions);
-  group_->setStartState(current_state);
+  // Use speculative plan if available, plan from current state otherwise
+  PickPlan plan;
+  if (!takeSpeculativePlan(*context, current_state, plan) && !planPickCycle(*context, current_state, plan))
+  {
+    composeError(res);
+    return true;
+  }
 
-  // Get random bin picking pose from emulator
-  bin_pose_msgs::bin_pose srv;
-  geometry_msgs::Pose approach_pose, grasp_pose, deapproach_pose;
+  postProcess(plan);
 
-  if (bin_pose_client_.call(srv))
+  // Visualize trajectories in RViz
+  if (visualizer_)
   {
-    grasp_pose = srv.response.grasp_pose;
-    approach_pose = srv.response.approach_pose;
-    deapproach_pose = srv.response.deapproach_pose;
+    ScopedTimer timer(metrics_[METRICS::VISUALIZATION]);
+    std::vector<trajectory_msgs::JointTrajectory> segments;
+    segments.push_back(plan.approach_trajectory.joint_trajectory);
+    segments.push_back(plan.grasp_trajectory.joint_trajectory);
+    segments.push_back(plan.deapproach_trajectory.joint_trajectory);
+    segments.push_back(plan.end_trajectory.joint_trajectory);
+    visualizer_->visualize(context->id, segments);
   }
 
   //---------------------------------------------------
-  // Plan trajectory from current to approach pose
+  // Compose binpicking as a sequence of operations
   //---------------------------------------------------
-  group_->setPoseTarget(approach_pose);
-  moveit::planning_interface::MoveItErrorCode success_approach = group_->plan(to_approach_pose);
-  if (success_approach)
-  {
-    // Get trajectory size from plan
-    approach_traj_size = to_approach_pose.trajectory_.joint_trajectory.points.size();
+  composeOperations(plan, res);
 
-    // SetStartState instead of trajectory execution
-    current_state.setJointGroupPositions(
-        "manipulator", to_approach_pose.trajectory_.joint_trajectory.points[approach_traj_size - 1].positions);
-    group_->setStartState(current_state);
+  // Planned pick is expected to succeed
+  reportPick(plan);
+  return true;
+}
+
+void BinpickingEmulator::publishStatistics(const ros::WallTimerEvent& event)
+{
+  diagnostic_msgs::DiagnosticArray statistics;
+  metrics_.toDiagnostics(statistics);
+  statistics_pub_.publish(statistics);
+}
 
-    // Visualize trajectory in RViz
-    visualizeTrajectory(to_approach_pose.trajectory_.joint_trajectory);
+std::shared_ptr<VisionSystemContext> BinpickingEmulator::getContext(int vision_system_id)
+{
+  {
+    std::lock_guard<std::mutex> lock(contexts_mutex_);
+    auto it = contexts_.find(vision_system_id);
+    if (it != contexts_.end())
+      return it->second;
   }
-  else
+
+  // Backends wait for move_group, create them without blocking other vision systems.
+  // Context created concurrently for the same ID is discarded
+  std::shared_ptr<VisionSystemContext> created = createContext(vision_system_id);
+
+  std::lock_guard<std::mutex> lock(contexts_mutex_);
+  std::shared_ptr<VisionSystemContext>& context = contexts_[vision_system_id];
+  if (!context)
   {
-    photoneo_msgs::operation binpicking_operation;
+    context = created;
+    ROS_INFO("BIN PICKING EMULATOR: Created planning context for vision system ID %d", vision_system_id);
+  }
+  return context;
+}
+
+std::shared_ptr<VisionSystemContext> BinpickingEmulator::createContext(int vision_system_id)
+{
+  std::shared_ptr<VisionSystemContext> context(new VisionSystemContext);
+  context->id = vision_system_id;
+  context->start_pose_from_robot.resize(num_of_joints_);
+  context->end_pose_from_robot.resize(num_of_joints_);
 
-    // Operation 1 - Error
-    binpicking_operation.operation_type = OPERATION::TYPE::ERROR;
+  for (int i = 0; i < planning_threads_; i++)
+    context->planning_backends.push_back(createPlanningBackend());
+  context->planning_workers.reset(new PlanningWorkers(context->planning_backends.size()));
 
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = ERROR::PLANNING_FAILED;
-    binpicking_operation.info = 0;
+  return context;
+}
 
-    res.operations.push_back(binpicking_operation);
+PlanningBackendPtr BinpickingEmulator::createPlanningBackend()
+{
+  if (planning_backend_ == "in_process")
+    return PlanningBackendPtr(new PipelineBackend(scene_monitor_, planning_pipeline_, "manipulator",
+                                                  "RRTConnectkConfigDefault", 0.001, planning_time_, ik_mutex_));
 
-    return true;
+  return PlanningBackendPtr(new MoveGroupBackend(nh_, "manipulator", "RRTConnectkConfigDefault", 0.001));
+}
+
+robot_state::RobotState BinpickingEmulator::getCurrentState()
+{
+  if (scene_monitor_)
+    return planning_scene_monitor::LockedPlanningSceneRO(scene_monitor_)->getCurrentState();
+
+  return *group_->getCurrentState();
+}
+
+bool BinpickingEmulator::planPickCycle(int vision_system_id, const robot_state::RobotState& start_state,
+                                       PickPlan& plan)
+{
+  if (!planPickCycle(*getContext(vision_system_id), start_state, plan))
+    return false;
+
+  reportPick(plan);
+  return true;
+}
+
+bool BinpickingEmulator::planPickCycle(VisionSystemContext& context, const robot_state::RobotState& start_state,
+                                       PickPlan& plan, const std::atomic<bool>* cancel)
+{
+  // Planning workers are shared by service and speculative planning
+  std::lock_guard<std::mutex> lock(context.planning_mutex);
+
+  // Workers of the previous request may still finish a cancelled leg on backends
+  if (context.last_batch)
+    waitForBatch(*context.last_batch);
+
+  moveit_msgs::RobotTrajectory to_start_pose;
+  robot_state::RobotState current_state(start_state);
+
+  //---------------------------------------------------
+  // Set Start state
+  //---------------------------------------------------
+  double start_time;
+  bool success;
+  {
+    ScopedTimer timer(metrics_[METRICS::START_LEG], &start_time);
+    success = planJointMotion(*context.planning_backends[0], current_state, context.start_pose_from_robot,
+                              to_start_pose);
   }
+  if (!success || (cancel && *cancel))
+    return false;
+
+  current_state.setJointGroupPositions("manipulator", to_start_pose.joint_trajectory.points.back().positions);
 
   //---------------------------------------------------
-  // Plan trajectory from approach to grasp pose
+  // Get random bin picking poses from emulator
+  //---------------------------------------------------
+  std::vector<GraspCandidate> candidates;
+  if (!getCandidates(candidates) || (cancel && *cancel))
+    return false;
+
   //---------------------------------------------------
-  std::vector<geometry_msgs::Pose> grasp_waypoints;
-  grasp_waypoints.push_back(approach_pose);
-  grasp_waypoints.push_back(grasp_pose);
+  // Plan approach, grasp, deapproach and end trajectories
+  //---------------------------------------------------
+  if (!planCandidates(context, current_state, candidates, plan, cancel))
+    return false;
 
-  double success_grasp = group_->computeCartesianPath(grasp_waypoints, 0.02, 0, to_grasp_pose, false);
-  ROS_INFO("Grasp Cartesian Path: %.2f%% achieved", success_grasp * 100.0);
+  plan.timing.start = start_time;
+  return true;
+}
 
-  if (success_grasp == 1)
+void BinpickingEmulator::startSpeculativePlanning(VisionSystemContext& context)
+{
+  std::lock_guard<std::mutex> lock(context.speculation_mutex);
+
+  // Keep plan already in flight or not yet consumed
+  if (context.speculative_plan)
+    return;
+
+  std::shared_ptr<SpeculativePlan> speculation(new SpeculativePlan);
   {
-    // Get trajectory size from plan
-    grasp_traj_size = to_grasp_pose.joint_trajectory.points.size();
+    std::lock_guard<std::mutex> planning_lock(context.planning_mutex);
+    speculation->start_joints = context.end_pose_from_robot;
+  }
 
-    // SetStartState instead of trajectory execution
-    current_state.setJointGroupPositions(
-        "manipulator", to_grasp_pose.joint_trajectory.points[grasp_traj_size - 1].positions);
-    group_->setStartState(current_state);
+  // Robot is expected to finish current pick in the end pose
+  robot_state::RobotState predicted_state = getCurrentState();
+  predicted_state.setJointGroupPositions("manipulator", speculation->start_joints);
 
-    // Visualize trajectory in RViz
-    visualizeTrajectory(to_grasp_pose.joint_trajectory);
+  PickPlan* plan = &speculation->plan;
+  VisionSystemContext* context_ptr = &context;
+  const std::atomic<bool>* cancel = &speculation->cancelled;
+  speculation->success = std::async(std::launch::async, [this, context_ptr, predicted_state, plan, cancel]()
+  {
+    return planPickCycle(*context_ptr, predicted_state, *plan, cancel);
+  });
 
+  context.speculative_plan = speculation;
+  ROS_INFO("BIN PICKING EMULATOR: Speculative planning started for vision system ID %d", context.id);
+}
+
+bool BinpickingEmulator::takeSpeculativePlan(VisionSystemContext& context, const robot_state::RobotState& current_state,
+                                             PickPlan& plan)
+{
+  std::shared_ptr<SpeculativePlan> speculation;
+  {
+    std::lock_guard<std::mutex> lock(context.speculation_mutex);
+    speculation.swap(context.speculative_plan);
   }
-  else
+
+  if (!speculation)
+    return false;
+
+  // Robot has to be in the state speculation started from, checked before waiting
+  // for the plan so that a wrong prediction does not cost a whole planning cycle
+  std::vector<double> current_joints;
+  current_state.copyJointGroupPositions("manipulator", current_joints);
+  for (std::size_t i = 0; i < current_joints.size() && i < speculation->start_joints.size(); i++)
   {
-    photoneo_msgs::operation binpicking_operation;
+    if (fabs(current_joints[i] - speculation->start_joints[i]) > speculation_tolerance_)
+    {
+      ROS_WARN("BIN PICKING EMULATOR: Speculative plan discarded, robot is not in the predicted state");
+
+      // Stop remaining legs, next cycle waits only for legs still running on the workers
+      speculation->cancelled = true;
+      {
+        std::lock_guard<std::mutex> lock(context.batch_mutex);
+        if (context.last_batch)
+          cancelBatch(*context.last_batch);
+      }
+      speculation->success.wait();
+      return false;
+    }
+  }
 
-    // Operation 1 - Error
-    binpicking_operation.operation_type = OPERATION::TYPE::ERROR;
+  bool success = speculation->success.get();
+  if (!success)
+    return false;
 
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = ERROR::PLANNING_FAILED;
-    binpicking_operation.info = 0;
+  plan = speculation->plan;
+  ROS_INFO("BIN PICKING EMULATOR: Using speculative plan");
+  return true;
+}
 
-    res.operations.push_back(binpicking_operation);
+void BinpickingEmulator::discardSpeculativePlan(VisionSystemContext& context)
+{
+  std::shared_ptr<SpeculativePlan> speculation;
+  {
+    std::lock_guard<std::mutex> lock(context.speculation_mutex);
+    speculation.swap(context.speculative_plan);
+  }
+
+  if (speculation)
+    speculation->success.wait();
+}
 
+bool BinpickingEmulator::getCandidates(std::vector<GraspCandidate>& candidates)
+{
+  // Single candidate keeps using the original bin_pose service unless seeded
+  if (num_of_candidates_ == 1 && candidate_seed_ == 0)
+  {
+    bin_pose_msgs::bin_pose srv;
+    bool success;
+    {
+      ScopedTimer timer(metrics_[METRICS::BIN_POSE_CALL]);
+      success = bin_pose_client_.call(srv);
+    }
+    if (!success)
+      return false;
+
+    GraspCandidate candidate;
+    candidate.grasp_pose = srv.response.grasp_pose;
+    candidate.approach_pose = srv.response.approach_pose;
+    candidate.deapproach_pose = srv.response.deapproach_pose;
+    candidate.part_id = 0;
+    candidates.push_back(candidate);
     return true;
   }
 
-  //---------------------------------------------------
-  // Plan trajectory from grasp to deapproach pose
-  //---------------------------------------------------
-  std::vector<geometry_msgs::Pose> deapproach_waypoints;
-  deapproach_waypoints.push_back(grasp_pose);
-  deapproach_waypoints.push_back(deapproach_pose);
+  // Multiple candidates are requested in one batch, already ranked by score
+  bin_pose_msgs::bin_pose_batch srv;
+  srv.request.count = num_of_candidates_;
+  srv.request.seed = (candidate_seed_ != 0) ? candidate_seed_ + candidate_requests_++ : 0;
+  bool success;
+  {
+    ScopedTimer timer(metrics_[METRICS::BIN_POSE_CALL]);
+    success = bin_pose_batch_client_.call(srv);
+  }
+  if (!success)
+    return false;
 
-  double success_deapproach = group_->computeCartesianPath(deapproach_waypoints, 0.02, 0, to_deapproach_pose, false);
-  ROS_INFO("Grasp Cartesian Path: %.2f%% achieved", success_deapproach * 100.0);
+  candidates.resize(srv.response.grasp_poses.size());
+  for (std::size_t i = 0; i < candidates.size(); i++)
+  {
+    candidates[i].grasp_pose = srv.response.grasp_poses[i];
+    candidates[i].approach_pose = srv.response.approach_poses[i];
+    candidates[i].deapproach_pose = srv.response.deapproach_poses[i];
+    candidates[i].part_id = i < srv.response.part_ids.size() ? srv.response.part_ids[i] : 0;
+  }
+  return !candidates.empty();
+}
 
-  if (success_deapproach == 1)
+bool BinpickingEmulator::planCandidates(VisionSystemContext& context, const robot_state::RobotState& start_state,
+                                        const std::vector<GraspCandidate>& candidates, PickPlan& plan)
+{
+  std::shared_ptr<CandidateBatch> batch(new CandidateBatch(start_state, candidates, context.end_pose_from_robot));
   {
-    // Get trajectory size from plan
-    deapproach_traj_size = to_deapproach_pose.joint_trajectory.points.size();
+    // Cancel request may have come before the batch was visible
+    std::lock_guard<std::mutex> lock(context.batch_mutex);
+    context.last_batch = batch;
+    if (cancel && *cancel)
+      batch->cancelled = true;
+  }
 
-    // SetStartState instead of trajectory execution
-    current_state.setJointGroupPositions(
-        "manipulator", to_deapproach_pose.joint_trajectory.points[deapproach_traj_size - 1].positions);
+  // Each worker takes candidates one by one until all of them are planned
+  // or, in "first" selection mode, until any of the workers succeeds
+  std::size_t num_of_workers = std::min(context.planning_backends.size(), candidates.size());
+  batch->active_workers = num_of_workers;
+  for (std::size_t w = 0; w < num_of_workers; w++)
+  {
+    PlanningBackendPtr backend = context.planning_backends[w];
+    context.planning_workers->post(w, [this, batch, backend]() { planBatch(*batch, *backend); });
+  }
 
-    group_->setStartState(current_state);
+  {
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&]() { return batch->active_workers == 0 || batch->cancelled; });
+  }
+  if (cancel && *cancel)
+    return false;
 
-    // Visualize trajectory in RViz
-    visualizeTrajectory(to_deapproach_pose.joint_trajectory);
+  // Select resulting plan
+  int selected = batch->first_succeeded;
+  if (!select_first_success_)
+  {
+    for (std::size_t i = 0; i < candidates.size(); i++)
+      if (batch->succeeded[i] && batch->plans[i].score < batch->plans[selected].score)
+        selected = i;
   }
-  else
+
+  if (selected < 0)
   {
-    photoneo_msgs::operation binpicking_operation;
+    ROS_WARN("BIN PICKING EMULATOR: Planning failed for all %zu grasp candidates", candidates.size());
+    return false;
+  }
 
-    // Operation 1 - Error
-    binpicking_operation.operation_type = OPERATION::TYPE::ERROR;
+  ROS_INFO("BIN PICKING EMULATOR: Selected grasp candidate %d of %zu", selected, candidates.size());
+  plan = batch->plans[selected];
+  plan.part_id = candidates[selected].part_id;
+  return true;
+}
 
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = ERROR::PLANNING_FAILED;
-    binpicking_operation.info = 0;
+void BinpickingEmulator::planBatch(CandidateBatch& batch, PlanningBackend& backend)
+{
+  for (std::size_t i = batch.next_candidate++; i < batch.candidates.size() && !batch.cancelled;
+       i = batch.next_candidate++)
+  {
+    if (!planPick(backend, batch, batch.candidates[i], batch.plans[i]))
+      continue;
+
+    batch.succeeded[i] = 1;
+    int none = -1;
+    if (batch.first_succeeded.compare_exchange_strong(none, static_cast<int>(i)) && select_first_success_)
+    {
+      std::lock_guard<std::mutex> lock(batch.mutex);
+      batch.cancelled = true;
+      batch.done.notify_all();
+    }
+  }
 
-    res.operations.push_back(binpicking_operation);
+  std::lock_guard<std::mutex> lock(batch.mutex);
+  batch.active_workers--;
+  batch.done.notify_all();
+}
 
-    return true;
-  }
+void BinpickingEmulator::cancelBatch(CandidateBatch& batch)
+{
+  std::lock_guard<std::mutex> lock(batch.mutex);
+  batch.cancelled = true;
+  batch.done.notify_all();
+}
+
+void BinpickingEmulator::waitForBatch(CandidateBatch& batch)
+{
+  std::unique_lock<std::mutex> lock(batch.mutex);
+  batch.done.wait(lock, [&]() { return batch.active_workers == 0; });
+}
+
+void BinpickingEmulator::reportPick(const PickPlan& plan)
+{
+  // Only parts of simulated pile are tracked by bin pose emulator
+  if (plan.part_id == 0)
+    return;
+
+  bin_pose_msgs::bin_pose_pick_result srv;
+  srv.request.part_id = plan.part_id;
+  srv.request.success = true;
+  if (!bin_pose_pick_result_client_.call(srv) || !srv.response.success)
+    ROS_WARN("BIN PICKING EMULATOR: Not able to remove part %u from pile", plan.part_id);
+}
+
+bool BinpickingEmulator::planPick(PlanningBackend& backend, const CandidateBatch& batch,
+                                  const GraspCandidate& candidate, PickPlan& plan)
+{
+  // Every candidate is planned from its own copy of the start state
+  robot_state::RobotState current_state(batch.start_state);
 
   //---------------------------------------------------
-  // Plan trajectory from deapproach to end pose
+  // Plan trajectory from current to approach pose
   //---------------------------------------------------
-  group_->setJointValueTarget(end_pose_from_robot_);
-  moveit::planning_interface::MoveItErrorCode success_end = group_->plan(to_end_pose);
-  if (success_end)
+  bool success;
   {
-    // Get trajectory size from plan
-    end_traj_size = to_end_pose.trajectory_.joint_trajectory.points.size();
+    ScopedTimer timer(metrics_[METRICS::APPROACH_LEG], &plan.timing.approach);
+    success = planApproachMotion(backend, current_state, candidate.approach_pose, plan.approach_trajectory);
+  }
+  // Other candidate already won in "first" selection mode
+  if (!success || batch.cancelled)
+    return false;
 
-    // SetStartState instead of trajectory execution
-    current_state.setJointGroupPositions("manipulator",
-                                         to_end_pose.trajectory_.joint_trajectory.points[end_traj_size - 1].positions);
-    group_->setStartState(current_state);
+  // SetStartState instead of trajectory execution
+  current_state.setJointGroupPositions("manipulator",
+                                       plan.approach_trajectory.joint_trajectory.points.back().positions);
 
-    // Visualize trajectory in RViz
-    visualizeTrajectory(to_end_pose.trajectory_.joint_trajectory);
+  //---------------------------------------------------
+  // Plan trajectory from approach to grasp pose
+  //---------------------------------------------------
+  {
+    ScopedTimer timer(metrics_[METRICS::GRASP_LEG], &plan.timing.grasp);
+    success = planCartesianMotion(backend, current_state, candidate.approach_pose, candidate.grasp_pose,
+                                  plan.grasp_trajectory);
   }
-  else
+  if (!success || batch.cancelled)
+    return false;
+
+  // SetStartState instead of trajectory execution
+  current_state.setJointGroupPositions("manipulator", plan.grasp_trajectory.joint_trajectory.points.back().positions);
+
+  //---------------------------------------------------
+  // Plan trajectory from grasp to deapproach pose
+  //---------------------------------------------------
   {
-    photoneo_msgs::operation binpicking_operation;
+    ScopedTimer timer(metrics_[METRICS::DEAPPROACH_LEG], &plan.timing.deapproach);
+    success = planCartesianMotion(backend, current_state, candidate.grasp_pose, candidate.deapproach_pose,
+                                  plan.deapproach_trajectory);
+  }
+  if (!success || batch.cancelled)
+    return false;
 
-    // Operation 1 - Error
-    binpicking_operation.operation_type = OPERATION::TYPE::ERROR;
+  // SetStartState instead of trajectory execution
+  current_state.setJointGroupPositions("manipulator",
+                                       plan.deapproach_trajectory.joint_trajectory.points.back().positions);
 
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = ERROR::PLANNING_FAILED;
-    binpicking_operation.info = 0;
+  //---------------------------------------------------
+  // Plan trajectory from deapproach to end pose
+  //---------------------------------------------------
+  {
+    ScopedTimer timer(metrics_[METRICS::END_LEG], &plan.timing.end);
+    success = planJointMotion(backend, current_state, batch.end_pose_from_robot, plan.end_trajectory);
+  }
+  if (!success)
+    return false;
 
-    res.operations.push_back(binpicking_operation);
+  plan.score = jointPathLength(plan.approach_trajectory.joint_trajectory) +
+               jointPathLength(plan.grasp_trajectory.joint_trajectory) +
+               jointPathLength(plan.deapproach_trajectory.joint_trajectory) +
+               jointPathLength(plan.end_trajectory.joint_trajectory);
+  return true;
+}
 
-    return true;
+bool BinpickingEmulator::planJointMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                                         const std::vector<double>& joint_target,
+                                         moveit_msgs::RobotTrajectory& trajectory)
+{
+  // Cache is bypassed until the full planning scene is known
+  std::string cache_key;
+  uint64_t scene_fingerprint;
+  bool cached = trajectory_cache_ && scene_fingerprint_->get(scene_fingerprint);
+  if (cached)
+  {
+    std::vector<double> start_joints;
+    start_state.copyJointGroupPositions("manipulator", start_joints);
+    cache_key = trajectory_cache_->jointGoalKey(start_joints, joint_target, scene_fingerprint);
+
+    if (trajectory_cache_->get(cache_key, trajectory))
+      return true;
   }
 
-  //---------------------------------------------------
-  // Compose binpicking as a sequence of operations
-  //---------------------------------------------------
+  if (!backend.planToJointTarget(start_state, joint_target, trajectory))
+    return false;
+
+  if (cached)
+    trajectory_cache_->put(cache_key, trajectory);
+  return true;
+}
 
-  // Check planning result
-  if ((success_approach) && (success_grasp) && (success_deapproach) && (success_end))
+bool BinpickingEmulator::planApproachMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                                            const geometry_msgs::Pose& approach_pose,
+                                            moveit_msgs::RobotTrajectory& trajectory)
+{
+  // Cache is bypassed until the full planning scene is known
+  std::string cache_key;
+  uint64_t scene_fingerprint;
+  bool cached = trajectory_cache_ && scene_fingerprint_->get(scene_fingerprint);
+  if (cached)
   {
-    photoneo_msgs::operation binpicking_operation;
+    std::vector<double> start_joints;
+    start_state.copyJointGroupPositions("manipulator", start_joints);
+    cache_key = trajectory_cache_->poseGoalKey(start_joints, approach_pose, scene_fingerprint);
 
-    // Operation 1 - Approach Trajectory
-    binpicking_operation.operation_type = OPERATION::TYPE::TRAJECTORY_CNT;
+    if (trajectory_cache_->get(cache_key, trajectory))
+      return true;
+  }
 
-    binpicking_operation.points.clear();
-    for (int i = 0; i < approach_traj_size; i++)
-      binpicking_operation.points.push_back(to_approach_pose.trajectory_.joint_trajectory.points[i]);
+  // Solve IK from the nearest known or precomputed solution and plan to joint
+  // target, fall back to pose target on cache miss, IK failure or planning failure
+  bool success = false;
+  std::vector<double> seed;
+  const geometry_msgs::Pose& p = approach_pose;
+  if ((ik_seed_cache_ && ik_seed_cache_->nearest(approach_pose, seed)) ||
+      (reachability_map_ && reachability_map_->solution(p.position.x, p.position.y, p.position.z, p.orientation.x,
+                                                        p.orientation.y, p.orientation.z, p.orientation.w, seed)))
+  {
+    robot_state::RobotState goal_state(start_state);
+    const robot_state::JointModelGroup* joint_model_group = goal_state.getJointModelGroup("manipulator");
+
+    bool ik_success = seed.size() == joint_model_group->getVariableCount();
+    if (ik_success)
+    {
+      goal_state.setJointGroupPositions(joint_model_group, seed);
+
+      // Kinematics solver instance is shared by all planning threads
+      std::lock_guard<std::mutex> lock(ik_mutex_);
+      ScopedTimer timer(metrics_[METRICS::IK]);
+      ik_success =
+          goal_state.setFromIK(joint_model_group, approach_pose, backend.getEndEffectorLink(), 1, ik_timeout_);
+    }
+
+    // Seeded IK may end up in a configuration not reachable from start state
+    if (ik_success)
+      success = backend.planToStateTarget(start_state, goal_state, trajectory);
+  }
 
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+  if (!success && !backend.planToPoseTarget(start_state, approach_pose, trajectory))
+    return false;
 
-    res.operations.push_back(binpicking_operation);
+  // Remember IK solution of approach pose
+  if (ik_seed_cache_)
+    ik_seed_cache_->insert(approach_pose, trajectory.joint_trajectory.points.back().positions);
 
-    // Operation 2 - Open Gripper
-    binpicking_operation.operation_type = OPERATION::TYPE::GRIPPER;
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = GRIPPER::OPEN;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+  if (cached)
+    trajectory_cache_->put(cache_key, trajectory);
+  return true;
+}
 
-    res.operations.push_back(binpicking_operation);
+bool BinpickingEmulator::planCartesianMotion(PlanningBackend& backend, const robot_state::RobotState& start_state,
+                                             const geometry_msgs::Pose& from, const geometry_msgs::Pose& to,
+                                             moveit_msgs::RobotTrajectory& trajectory)
+{
+  double success;
+  if (cartesian_interpolator_)
+  {
+    // Fails without motion when start state is not at from pose
+    success = cartesian_interpolator_->interpolate(start_state, from, to, trajectory);
+  }
+  else
+  {
+    std::vector<geometry_msgs::Pose> waypoints;
+    waypoints.push_back(from);
+    waypoints.push_back(to);
 
-    // Operation 3 - Grasp Trajectory
-    binpicking_operation.operation_type = OPERATION::TYPE::TRAJECTORY_FINE;
+    success = backend.computeCartesianPath(start_state, waypoints, cartesian_step_, trajectory);
+  }
+  ROS_INFO("Cartesian Path: %.2f%% achieved", success * 100.0);
 
-    binpicking_operation.points.clear();
-    for (int i = 0; i < grasp_traj_size; i++)
-      binpicking_operation.points.push_back(to_grasp_pose.joint_trajectory.points[i]);
+  return (success == 1) && !trajectory.joint_trajectory.points.empty();
+}
 
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+void BinpickingEmulator::postProcess(PickPlan& plan)
+{
+  if (!trajectory_processor_)
+    return;
 
-    res.operations.push_back(binpicking_operation);
+  ScopedTimer timer(metrics_[METRICS::POST_PROCESSING]);
 
-    // Operation 4 - Close Gripper
-    binpicking_operation.operation_type = OPERATION::TYPE::GRIPPER;
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = GRIPPER::CLOSE;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+  // Grasp and deapproach legs are straight tool motions, only free space legs are processed.
+  // Simplified legs are checked against the monitored scene, it is locked for reading meanwhile
+  planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor_);
+  trajectory_processor_->process(plan.approach_trajectory, scene);
+  trajectory_processor_->process(plan.end_trajectory, scene);
+}
 
-    res.operations.push_back(binpicking_operation);
+static void addOperation(photoneo_msgs::operations::Response& res, int operation_type, int gripper, int info,
+                         std::vector<trajectory_msgs::JointTrajectoryPoint>&& points =
+                             std::vector<trajectory_msgs::JointTrajectoryPoint>())
+{
+  res.operations.emplace_back();
+  photoneo_msgs::operation& binpicking_operation = res.operations.back();
+  binpicking_operation.operation_type = operation_type;
+  binpicking_operation.points = std::move(points);
+  binpicking_operation.gripper = gripper;
+  binpicking_operation.error = 0;
+  binpicking_operation.info = info;
+}
 
-    // Operation 5 - Deapproach trajectory
-    binpicking_operation.operation_type = OPERATION::TYPE::TRAJECTORY_FINE;
+void BinpickingEmulator::composeOperations(PickPlan& plan, photoneo_msgs::operations::Response& res)
+{
+  // Waypoints are moved out of the plan, response is the last user of trajectories
+  res.operations.reserve(res.operations.size() + 9);
 
-    binpicking_operation.points.clear();
-    for (int i = 0; i < deapproach_traj_size; i++)
-      binpicking_operation.points.push_back(to_deapproach_pose.joint_trajectory.points[i]);
+  // Operation 1 - Approach Trajectory
+  addOperation(res, OPERATION::TYPE::TRAJECTORY_CNT, 0, 0, std::move(plan.approach_trajectory.joint_trajectory.points));
 
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+  // Operation 2 - Open Gripper
+  addOperation(res, OPERATION::TYPE::GRIPPER, GRIPPER::OPEN, 0);
 
-    res.operations.push_back(binpicking_operation);
+  // Operation 3 - Grasp Trajectory
+  addOperation(res, OPERATION::TYPE::TRAJECTORY_FINE, 0, 0, std::move(plan.grasp_trajectory.joint_trajectory.points));
 
-    // Operation 6 - End Trajectory
-    binpicking_operation.operation_type = OPERATION::TYPE::TRAJECTORY_CNT;
+  // Operation 4 - Close Gripper
+  addOperation(res, OPERATION::TYPE::GRIPPER, GRIPPER::CLOSE, 0);
 
-    binpicking_operation.points.clear();
-    for (int i = 0; i < end_traj_size; i++)
-      binpicking_operation.points.push_back(to_end_pose.trajectory_.joint_trajectory.points[i]);
+  // Operation 5 - Deapproach trajectory
+  addOperation(res, OPERATION::TYPE::TRAJECTORY_FINE, 0, 0,
+               std::move(plan.deapproach_trajectory.joint_trajectory.points));
 
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 0;
+  // Operation 6 - End Trajectory
+  addOperation(res, OPERATION::TYPE::TRAJECTORY_CNT, 0, 0, std::move(plan.end_trajectory.joint_trajectory.points));
 
-    res.operations.push_back(binpicking_operation);
+  // Operation 7 - Info tool invariance
+  addOperation(res, OPERATION::TYPE::INFO, 0, 1);
 
-    // Operation 7 - Info tool invariance
-    binpicking_operation.operation_type = OPERATION::TYPE::INFO;
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 1;
+  // Operation 8 - Gripping point
+  addOperation(res, OPERATION::TYPE::INFO, 0, 2);
 
-    res.operations.push_back(binpicking_operation);
+  // Operation 9 - Gripping point invariance
+  addOperation(res, OPERATION::TYPE::INFO, 0, 3);
+}
 
-    // Operation 8 - Gripping point
-    binpicking_operation.operation_type = OPERATION::TYPE::INFO;
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 2;
+void BinpickingEmulator::composeError(photoneo_msgs::operations::Response& res)
+{
+  photoneo_msgs::operation binpicking_operation;
 
-    res.operations.push_back(binpicking_operation);
+  // Operation 1 - Error
+  binpicking_operation.operation_type = OPERATION::TYPE::ERROR;
 
-    // Operation 7 - Gripping point invariance
-    binpicking_operation.operation_type = OPERATION::TYPE::INFO;
-    binpicking_operation.points.clear();
-    binpicking_operation.gripper = 0;
-    binpicking_operation.error = 0;
-    binpicking_operation.info = 3;
+  binpicking_operation.points.clear();
+  binpicking_operation.gripper = 0;
+  binpicking_operation.error = ERROR::PLANNING_FAILED;
+  binpicking_operation.info = 0;
 
-    res.operations.push_back(binpicking_operation);
+  res.operations.push_back(binpicking_operation);
+}
 
-    return true;
+double BinpickingEmulator::jointPathLength(const trajectory_msgs::JointTrajectory& trajectory)
+{
+  double length = 0;
+  for (std::size_t i = 1; i < trajectory.points.size(); i++)
+  {
+    double squared_distance = 0;
+    for (std::size_t j = 0; j < trajectory.points[i].positions.size(); j++)
+      squared_distance += pow(trajectory.points[i].positions[j] - trajectory.points[i - 1].positions[j], 2);
+    length += sqrt(squared_distance);
   }
+  return length;
 }
 
 bool BinpickingEmulator::binLocatorCallback(photoneo_msgs::trigger_with_id::Request& req, photoneo_msgs::trigger_with_id::Response& res)
 {
   ROS_INFO("BIN PICKING EMULATOR: Bin Locator Service Called");
   ROS_INFO("BIN PICKING EMULATOR:  Vision system ID %d", req.id);
-  ros::Duration(5).sleep();  // Simulating delay
+  latency_model_.sleep(LATENCY::SERVICE::BIN_LOCATOR);  // Simulating delay
 
   res.message = "OK";
   res.success = true;
+  return true;
 }
 
 bool BinpickingEmulator::binPickingInitCallback(photoneo_msgs::initialize_pose::Request& req,
@@ -378,17 +972,24 @@ bool BinpickingEmulator::binPickingInitCallback(photoneo_msgs::initialize_pose::
   ROS_INFO("BIN PICKING EMULATOR: Binpicking Init Service called");
   ROS_INFO("BIN PICKING EMULATOR:  Vision system ID %d", req.vision_system_id);
 
+  std::shared_ptr<VisionSystemContext> context = getContext(req.vision_system_id);
   std::stringstream start_pose_string, end_pose_string;
 
-  for(int i = 0; i < num_of_joints_; i++)
   {
-    start_pose_from_robot_[i] = req.startPose.position[i];
-    end_pose_from_robot_[i] = req.endPose.position[i];
-
-    start_pose_string << req.startPose.position[i] << " ";
-    end_pose_string << req.endPose.position[i] << " ";
+    std::lock_guard<std::mutex> lock(context->planning_mutex);
+    for(int i = 0; i < num_of_joints_; i++)
+    {
+      context->start_pose_from_robot[i] = req.startPose.position[i];
+      context->end_pose_from_robot[i] = req.endPose.position[i];
+
+      start_pose_string << req.startPose.position[i] << " ";
+      end_pose_string << req.endPose.position[i] << " ";
+    }
   }
 
+  // Speculative plan targets previous start and end poses
+  discardSpeculativePlan(*context);
+
   ROS_INFO("BIN PICKING EMULATOR: START POSE: [%s] ", start_pose_string.str().c_str());
   ROS_INFO("BIN PICKING EMULATOR: END POSE: [%s]", end_pose_string.str().c_str());
 
@@ -401,7 +1002,7 @@ bool BinpickingEmulator::binPickingInitCallback(photoneo_msgs::initialize_pose::
 bool BinpickingEmulator::calibrationAddPointCallback(photoneo_msgs::add_point::Request& req, photoneo_msgs::add_point::Response& res)
 {
   ROS_INFO("BIN PICKING EMULATOR: Calibration Add Point Service called");
-  ros::Duration(5).sleep();  // Simulating delay
+  latency_model_.sleep(LATENCY::SERVICE::CALIBRATION_ADD_POINT);  // Simulating delay
 
   res.average_reprojection_error = 12.345;
   res.calibration_state = 0;
@@ -415,7 +1016,7 @@ bool BinpickingEmulator::calibrationAddPointCallback(photoneo_msgs::add_point::R
 bool BinpickingEmulator::calibrationSetToScannerCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
 {
   ROS_INFO("BIN PICKING EMULATOR: Calibration Set To Scanner Service called");
-  ros::Duration(2).sleep();   // Simulating delay
+  latency_model_.sleep(LATENCY::SERVICE::CALIBRATION_SET_TO_SCANNER);  // Simulating delay
 
   res.success = true;
   return true;
@@ -424,7 +1025,7 @@ bool BinpickingEmulator::calibrationSetToScannerCallback(std_srvs::Trigger::Requ
 bool BinpickingEmulator::calibrationResetCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
 {
   ROS_INFO("BIN PICKING EMULATOR: Calibration Reset Service called");
-  ros::Duration(2).sleep();   // Simulating delay
+  latency_model_.sleep(LATENCY::SERVICE::CALIBRATION_RESET);  // Simulating delay
 
   res.success = true;
   return true;
@@ -434,7 +1035,7 @@ bool BinpickingEmulator::calibrationStartCallback(photoneo_msgs::trigger_with_id
 {
   ROS_INFO("BIN PICKING EMULATOR: Calibration Start Service called");
   ROS_INFO("BIN PICKING EMULATOR:  Vision system ID %d", req.id);
-  ros::Duration(2).sleep();   // Simulating delay
+  latency_model_.sleep(LATENCY::SERVICE::CALIBRATION_START);  // Simulating delay
 
   res.success = true;
   return true;
@@ -444,7 +1045,7 @@ bool BinpickingEmulator::binPickingPickFailedCallback(photoneo_msgs::trigger_wit
 {
   ROS_INFO("BIN PICKING EMULATOR: Binpicking Pick Failed Service called");
   ROS_INFO("BIN PICKING EMULATOR:  Vision system ID %d", req.id);
-  ros::Duration(5).sleep();
+  latency_model_.sleep(LATENCY::SERVICE::PICK_FAILED);
 
   res.success = true;
   return true;
@@ -454,109 +1055,8 @@ bool BinpickingEmulator::changeSolutionCallback(photoneo_msgs::trigger_with_id::
 {
   ROS_INFO("BIN PICKING EMULATOR: Binpicking Pick Change Solution Service called");
   ROS_INFO("BIN PICKING EMULATOR:  Solution ID %d", req.id);
-  ros::Duration(5).sleep();
+  latency_model_.sleep(LATENCY::SERVICE::CHANGE_SOLUTION);
 
   res.success = true;
   return true;
 }
-
-void BinpickingEmulator::visualizeTrajectory(trajectory_msgs::JointTrajectory trajectory)
-{
-  visualization_msgs::Marker marker;
-
-  // Kinematic variables
-  robot_model::RobotModelPtr kinematic_model = robot_model_loader_->getModel();
-  robot_state::RobotStatePtr kinematic_state(new robot_state::RobotState(kinematic_model));
-
-  marker.header.frame_id = "/base_link";
-  marker.ns = "trajectory";
-  marker.type = visualization_msgs::Marker::SPHERE;
-  marker.action = visualization_msgs::Marker::ADD;
-
-  for (int i = 0; i < trajectory.points.size(); i++)
-  {
-    kinematic_state->setJointGroupPositions("manipulator", trajectory.points[i].positions);
-    const Eigen::Affine3d& end_effector_state = kinematic_state->getGlobalLinkTransform("tool0");
-
-    marker.header.stamp = ros::Time::now();
-    marker.id = trajectory_marker_index_++;
-
-    marker.pose.position.x = end_effector_state.translation()[0];
-    marker.pose.position.y = end_effector_state.translation()[1];
-    marker.pose.position.z = end_effector_state.translation()[2];
-
-    marker.scale.x = 0.01;
-    marker.scale.y = 0.01;
-    marker.scale.z = 0.01;
-
-    marker.color.r = 0.9f;
-    marker.color.g = 0.9f;
-    marker.color.b = 0.9f;
-    marker.color.a = 1.0;
-
-    marker.lifetime = ros::Duration(5);
-    trajectory_pub_.publish(marker);
-    ros::Duration(0.001).sleep();
-  }
-}
-
-int main(int argc, char** argv)
-{
-  ros::init(argc, argv, "binpicking_emulator");
-  ros::NodeHandle nh;
-
-  // Initial wait for Moveit to be properly loaded
-  ros::Duration(3).sleep();
-
-  // Wait for moveit services
-  bool moveit_available = ros::service::exists("/compute_ik", true);
-  while (!moveit_available)
-  {
-     ros::Duration(1).sleep();
-     ROS_WARN("BIN PICKING EMULATOR: Waiting for Moveit Config to be properly loaded!");
-     moveit_available = ros::service::exists("/compute_ik", true);
-  }
-
-  // Wait for bin_pose service
-  bool bin_pose_emulator_available = ros::service::exists("/bin_pose", true);
-  while (!bin_pose_emulator_available)
-  {
-    ros::Duration(1).sleep();
-    bin_pose_emulator_available = ros::service::exists("/bin_pose", true);
-    ROS_WARN("BIN PICKING EMULATOR: Waiting for Bin pose emulator to provide /bin_pose service ");
-  }
-
-  // Create BinpickingEmulator instance
-  BinpickingEmulator emulator(&nh);
-
-  // Advertise service
-  ros::ServiceServer bin_picking_scan_service =
-      nh.advertiseService(BINPICKING_SERVICES::SCAN, &BinpickingEmulator::binPickingScanCallback, &emulator);
-  ros::ServiceServer bin_picking_traj_service =
-      nh.advertiseService(BINPICKING_SERVICES::TRAJECTORY, &BinpickingEmulator::binPickingTrajCallback, &emulator);
-  ros::ServiceServer bin_picking_bin_locator_service = nh.advertiseService(
-      BINPICKING_SERVICES::BIN_LOCATOR, &BinpickingEmulator::binLocatorCallback, &emulator);
-  ros::ServiceServer bin_picking_init_service =
-      nh.advertiseService(BINPICKING_SERVICES::INITIALIZE, &BinpickingEmulator::binPickingInitCallback, &emulator);
-  ros::ServiceServer calibration_add_point_service =
-      nh.advertiseService(CALIBRATION_SERVICES::ADD_POINT, &BinpickingEmulator::calibrationAddPointCallback, &emulator);
-  ros::ServiceServer calibration_set_to_scanner_service =
-      nh.advertiseService(CALIBRATION_SERVICES::SET_TO_SCANNER, &BinpickingEmulator::calibrationSetToScannerCallback, &emulator);
-  ros::ServiceServer calibration_reset_service =
-      nh.advertiseService(CALIBRATION_SERVICES::RESET, &BinpickingEmulator::calibrationResetCallback, &emulator);
-  ros::ServiceServer calibration_start_service =
-      nh.advertiseService(CALIBRATION_SERVICES::START, &BinpickingEmulator::calibrationStartCallback, &emulator);
-  ros::ServiceServer bin_picking_pick_failed_service =
-      nh.advertiseService(BINPICKING_SERVICES::REMOVE_LAST_OBJECT, &BinpickingEmulator::binPickingPickFailedCallback, &emulator);
-  ros::ServiceServer change_solution_service =
-      nh.advertiseService(BINPICKING_SERVICES::CHANGE_SOLUTION, &BinpickingEmulator::changeSolutionCallback, &emulator);
-
-  ROS_WARN("BIN PICKING EMULATOR: Ready");
-
-  // Start Async Spinner with 2 threads
-  ros::AsyncSpinner spinner(2);
-  spinner.start();
-  ros::waitForShutdown();
-
-  return EXIT_SUCCESS;
-}
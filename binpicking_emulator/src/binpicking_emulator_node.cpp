@@ -0,0 +1,54 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/binpicking_emulator.h"
+#include "binpicking_emulator/binpicking_emulator_services.h"
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "binpicking_emulator");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  // Fast forward mode drives /clock, it has to run before other nodes wait on simulated time.
+  // Clock ticks on its own spinner, the main spinner starts only after dependencies are up
+  std::shared_ptr<SimClock> sim_clock = BinpickingEmulatorServices::createSimClock(&nh, pnh);
+
+  double startup_delay;
+  pnh.param<double>("startup_delay", startup_delay, 3.0);
+  if (!BinpickingEmulatorServices::waitForDependencies(startup_delay))
+    return EXIT_FAILURE;
+
+  // Create BinpickingEmulator instance
+  BinpickingEmulator emulator(&nh, pnh);
+  emulator.setSimClock(sim_clock);
+
+  // Advertise services, optionally recording served requests
+  std::string record_file;
+  pnh.param<std::string>("record_file", record_file, "");
+  BinpickingEmulatorServices services(&nh, &emulator, record_file);
+
+  ROS_WARN("BIN PICKING EMULATOR: Ready");
+
+  // Start Async Spinner, vision systems are served in parallel
+  int spinner_threads;
+  pnh.param<int>("spinner_threads", spinner_threads, 2);
+  ros::AsyncSpinner spinner(std::max(spinner_threads, 1));
+  spinner.start();
+  ros::waitForShutdown();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Binpicking emulator loadable into a nodelet manager together with bin_pose_emulator
+// and the simple utils, topics are then passed as shared pointers without serialization.
+// Service calls are serialized by roscpp also inside one manager.
+
+#include "binpicking_emulator/binpicking_emulator.h"
+#include "binpicking_emulator/binpicking_emulator_services.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace binpicking_emulator
+{
+class BinpickingEmulatorNodelet : public nodelet::Nodelet
+{
+public:
+  BinpickingEmulatorNodelet() : cancel_(false)
+  {
+  }
+
+  ~BinpickingEmulatorNodelet()
+  {
+    cancel_ = true;
+    if (startup_thread_.joinable())
+      startup_thread_.join();
+  }
+
+private:
+  virtual void onInit()
+  {
+    // Fast forward mode drives /clock, it has to run before other nodes wait on simulated time
+    sim_clock_ = BinpickingEmulatorServices::createSimClock(&getMTNodeHandle(), getMTPrivateNodeHandle());
+
+    // onInit must not block the manager, waiting for Moveit and bin pose emulator
+    // which may be loaded into the same manager afterwards
+    startup_thread_ = std::thread(&BinpickingEmulatorNodelet::startup, this);
+  }
+
+  void startup()
+  {
+    // Multi threaded queue, vision systems are served in parallel by manager worker threads
+    ros::NodeHandle& nh = getMTNodeHandle();
+    ros::NodeHandle& pnh = getMTPrivateNodeHandle();
+
+    double startup_delay;
+    pnh.param<double>("startup_delay", startup_delay, 3.0);
+    if (!BinpickingEmulatorServices::waitForDependencies(startup_delay, &cancel_))
+      return;
+
+    emulator_.reset(new BinpickingEmulator(&nh, pnh));
+    emulator_->setSimClock(sim_clock_);
+
+    std::string record_file;
+    pnh.param<std::string>("record_file", record_file, "");
+    services_.reset(new BinpickingEmulatorServices(&nh, emulator_.get(), record_file));
+
+    NODELET_WARN("BIN PICKING EMULATOR: Ready");
+  }
+
+  std::atomic<bool> cancel_;
+  std::thread startup_thread_;
+  std::shared_ptr<SimClock> sim_clock_;
+  std::shared_ptr<BinpickingEmulator> emulator_;
+  std::shared_ptr<BinpickingEmulatorServices> services_;
+};
+}  // namespace binpicking_emulator
+
+PLUGINLIB_EXPORT_CLASS(binpicking_emulator::BinpickingEmulatorNodelet, nodelet::Nodelet)
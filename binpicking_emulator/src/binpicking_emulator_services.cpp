@@ -0,0 +1,156 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/binpicking_emulator_services.h"
+
+#include <boost/function.hpp>
+
+using namespace pho_robot_loader;
+
+static uint32_t visionSystemId(const photoneo_msgs::trigger_with_id::Request& req)
+{
+  return req.id;
+}
+
+static uint32_t visionSystemId(const photoneo_msgs::operations::Request& req)
+{
+  return req.vision_system_id;
+}
+
+static uint32_t visionSystemId(const photoneo_msgs::initialize_pose::Request& req)
+{
+  return req.vision_system_id;
+}
+
+// Service callback logging every served request when recording is enabled
+template <class Request, class Response>
+static boost::function<bool(Request&, Response&)>
+recordedCallback(const std::shared_ptr<ServiceLogWriter>& recorder, RECORDED_SERVICE::Service service,
+                 bool (BinpickingEmulator::*callback)(Request&, Response&), BinpickingEmulator* emulator)
+{
+  if (!recorder)
+    return [emulator, callback](Request& req, Response& res) { return (emulator->*callback)(req, res); };
+
+  return [recorder, service, emulator, callback](Request& req, Response& res)
+  {
+    // Request may be modified by the callback, keep the received one
+    Request received(req);
+    int64_t stamp = recorder->now();
+    bool served = (emulator->*callback)(req, res);
+    recorder->write(service, visionSystemId(received), stamp, served && RECORDED_SERVICE::succeeded(res), received,
+                    res);
+    return served;
+  };
+}
+
+static bool cancelled(const std::atomic<bool>* cancel)
+{
+  return !ros::ok() || (cancel && cancel->load());
+}
+
+BinpickingEmulatorServices::BinpickingEmulatorServices(ros::NodeHandle* nh, BinpickingEmulator* emulator,
+                                                       const std::string& record_file)
+{
+  // Optionally record served pick cycle requests for service_replayer
+  if (!record_file.empty())
+  {
+    recorder_.reset(new ServiceLogWriter());
+    if (recorder_->open(record_file))
+      ROS_INFO("BIN PICKING EMULATOR: Recording service calls to %s", record_file.c_str());
+    else
+    {
+      ROS_ERROR("BIN PICKING EMULATOR: Not able to open record file %s", record_file.c_str());
+      recorder_.reset();
+    }
+  }
+
+  // Advertise services
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::SCAN, recordedCallback(recorder_, RECORDED_SERVICE::SCAN,
+                                                  &BinpickingEmulator::binPickingScanCallback, emulator)));
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::TRAJECTORY, recordedCallback(recorder_, RECORDED_SERVICE::TRAJECTORY,
+                                                        &BinpickingEmulator::binPickingTrajCallback, emulator)));
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::BIN_LOCATOR, &BinpickingEmulator::binLocatorCallback, emulator));
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::INITIALIZE, recordedCallback(recorder_, RECORDED_SERVICE::INITIALIZE,
+                                                        &BinpickingEmulator::binPickingInitCallback, emulator)));
+  services_.push_back(nh->advertiseService(
+      CALIBRATION_SERVICES::ADD_POINT, &BinpickingEmulator::calibrationAddPointCallback, emulator));
+  services_.push_back(nh->advertiseService(
+      CALIBRATION_SERVICES::SET_TO_SCANNER, &BinpickingEmulator::calibrationSetToScannerCallback, emulator));
+  services_.push_back(nh->advertiseService(
+      CALIBRATION_SERVICES::RESET, &BinpickingEmulator::calibrationResetCallback, emulator));
+  services_.push_back(nh->advertiseService(
+      CALIBRATION_SERVICES::START, &BinpickingEmulator::calibrationStartCallback, emulator));
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::REMOVE_LAST_OBJECT,
+      recordedCallback(recorder_, RECORDED_SERVICE::PICK_FAILED, &BinpickingEmulator::binPickingPickFailedCallback,
+                       emulator)));
+  services_.push_back(nh->advertiseService(
+      BINPICKING_SERVICES::CHANGE_SOLUTION,
+      recordedCallback(recorder_, RECORDED_SERVICE::CHANGE_SOLUTION, &BinpickingEmulator::changeSolutionCallback,
+                       emulator)));
+}
+
+std::shared_ptr<SimClock> BinpickingEmulatorServices::createSimClock(ros::NodeHandle* nh, ros::NodeHandle pnh)
+{
+  bool fast_forward;
+  double clock_publish_rate;
+  pnh.param<bool>("fast_forward", fast_forward, false);
+  pnh.param<double>("clock_publish_rate", clock_publish_rate, 100.0);
+
+  std::shared_ptr<SimClock> clock;
+  if (!fast_forward)
+    return clock;
+
+  // Other nodes would keep running in wall time
+  if (!ros::Time::isSimTime())
+  {
+    ROS_ERROR("BIN PICKING EMULATOR: Fast forward mode requires /use_sim_time, running in wall time");
+    return clock;
+  }
+
+  clock.reset(new SimClock(nh, clock_publish_rate));
+  return clock;
+}
+
+bool BinpickingEmulatorServices::waitForDependencies(double startup_delay, const std::atomic<bool>* cancel)
+{
+  // Initial wait for Moveit to be properly loaded
+  ros::WallTime start = ros::WallTime::now();
+  while (!cancelled(cancel) && (ros::WallTime::now() - start).toSec() < startup_delay)
+    ros::WallDuration(0.1).sleep();
+
+  // Wait for moveit services
+  while (!ros::service::waitForService("/compute_ik", 1000))
+  {
+    if (cancelled(cancel))
+      return false;
+    ROS_WARN("BIN PICKING EMULATOR: Waiting for Moveit Config to be properly loaded!");
+  }
+
+  // Wait for bin_pose service
+  while (!ros::service::waitForService("/bin_pose", 1000))
+  {
+    if (cancelled(cancel))
+      return false;
+    ROS_WARN("BIN PICKING EMULATOR: Waiting for Bin pose emulator to provide /bin_pose service ");
+  }
+
+  return !cancelled(cancel);
+}
@@ -0,0 +1,187 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Compares Jacobian cartesian interpolator with RobotState::computeCartesianPath
+// on approach -> grasp -> deapproach legs of poses generated by bin_pose_emulator
+
+#include <ros/ros.h>
+#include <bin_pose_msgs/bin_pose_batch.h>
+#include <binpicking_emulator/cartesian_interpolator.h>
+#include <binpicking_emulator/metrics.h>
+
+#include <eigen_conversions/eigen_msg.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+typedef std::function<double(const robot_state::RobotState&, const geometry_msgs::Pose&,
+                             const geometry_msgs::Pose&, moveit_msgs::RobotTrajectory&)>
+    CartesianMethod;
+
+struct BenchmarkResult
+{
+  std::vector<double> latencies;
+  std::size_t successes;
+};
+
+static bool planLeg(const CartesianMethod& method, robot_state::RobotState& state, const geometry_msgs::Pose& from,
+                    const geometry_msgs::Pose& to, BenchmarkResult& result)
+{
+  moveit_msgs::RobotTrajectory trajectory;
+  auto start = std::chrono::steady_clock::now();
+  double fraction = method(state, from, to, trajectory);
+  auto end = std::chrono::steady_clock::now();
+
+  result.latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  if (fraction < 1 || trajectory.joint_trajectory.points.empty())
+    return false;
+
+  state.setJointGroupPositions("manipulator", trajectory.joint_trajectory.points.back().positions);
+  return true;
+}
+
+static void report(const std::string& name, const BenchmarkResult& result, std::size_t picks)
+{
+  double sum = 0;
+  for (std::size_t i = 0; i < result.latencies.size(); i++)
+    sum += result.latencies[i];
+
+  ROS_INFO("%-12s success %zu/%zu, leg latency mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms", name.c_str(),
+           result.successes, picks, result.latencies.empty() ? 0 : sum / result.latencies.size(),
+           percentile(result.latencies, 0.5), percentile(result.latencies, 0.95),
+           percentile(result.latencies, 1.0));
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "cartesian_benchmark");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  int count, seed;
+  double step, orientation_step, jump_threshold, ik_timeout;
+  pnh.param<int>("count", count, 100);
+  pnh.param<int>("seed", seed, 1);
+  pnh.param<double>("cartesian_step", step, 0.02);
+  pnh.param<double>("cartesian_orientation_step", orientation_step, 0.05);
+  pnh.param<double>("cartesian_jump_threshold", jump_threshold, 0.2);
+  pnh.param<double>("ik_timeout", ik_timeout, 0.005);
+
+  robot_model_loader::RobotModelLoader robot_model_loader("robot_description");
+  robot_model::RobotModelConstPtr robot_model = robot_model_loader.getModel();
+  const robot_model::JointModelGroup* joint_model_group = robot_model->getJointModelGroup("manipulator");
+
+  std::string tip_link;
+  pnh.param<std::string>("cartesian_tip_link", tip_link, joint_model_group->getLinkModelNames().back());
+  const robot_model::LinkModel* link = robot_model->getLinkModel(tip_link);
+
+  //---------------------------------------------------
+  // Generate poses
+  //---------------------------------------------------
+  ros::ServiceClient bin_pose_batch_client = nh.serviceClient<bin_pose_msgs::bin_pose_batch>("bin_pose_batch");
+  bin_pose_batch_client.waitForExistence();
+
+  bin_pose_msgs::bin_pose_batch srv;
+  srv.request.count = count;
+  srv.request.seed = seed;
+  if (!bin_pose_batch_client.call(srv))
+  {
+    ROS_ERROR("CARTESIAN BENCHMARK: Not able to call bin_pose_batch service");
+    return 1;
+  }
+
+  //---------------------------------------------------
+  // Methods under test
+  //---------------------------------------------------
+  std::mutex kinematics_mutex;
+  CartesianInterpolator interpolator(robot_model, "manipulator", tip_link, step, orientation_step, jump_threshold,
+                                     ik_timeout, kinematics_mutex);
+
+  CartesianMethod jacobian = [&](const robot_state::RobotState& start_state, const geometry_msgs::Pose& from,
+                                 const geometry_msgs::Pose& to, moveit_msgs::RobotTrajectory& trajectory)
+  {
+    return interpolator.interpolate(start_state, from, to, trajectory);
+  };
+
+  // Same settings as binpicking_emulator, including time parameterization
+  CartesianMethod moveit = [&](const robot_state::RobotState& start_state, const geometry_msgs::Pose& from,
+                               const geometry_msgs::Pose& to, moveit_msgs::RobotTrajectory& trajectory)
+  {
+    robot_state::RobotState state(start_state);
+    EigenSTL::vector_Affine3d targets(2);
+    tf::poseMsgToEigen(from, targets[0]);
+    tf::poseMsgToEigen(to, targets[1]);
+
+    std::vector<robot_state::RobotStatePtr> states;
+    double fraction = state.computeCartesianPath(joint_model_group, states, link, targets, true, step, 0.0);
+
+    robot_trajectory::RobotTrajectory robot_trajectory(robot_model, "manipulator");
+    for (std::size_t i = 0; i < states.size(); i++)
+      robot_trajectory.addSuffixWayPoint(states[i], 0.0);
+
+    trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+    time_parameterization.computeTimeStamps(robot_trajectory);
+    robot_trajectory.getRobotTrajectoryMsg(trajectory);
+    return fraction;
+  };
+
+  //---------------------------------------------------
+  // Run
+  //---------------------------------------------------
+  BenchmarkResult jacobian_result = { std::vector<double>(), 0 };
+  BenchmarkResult moveit_result = { std::vector<double>(), 0 };
+  std::size_t picks = 0;
+
+  robot_state::RobotState default_state(robot_model);
+  default_state.setToDefaultValues();
+
+  for (std::size_t i = 0; i < srv.response.grasp_poses.size(); i++)
+  {
+    const geometry_msgs::Pose& approach = srv.response.approach_poses[i];
+    const geometry_msgs::Pose& grasp = srv.response.grasp_poses[i];
+    const geometry_msgs::Pose& deapproach = srv.response.deapproach_poses[i];
+
+    // Both methods start from the same IK solution of approach pose
+    robot_state::RobotState approach_state(default_state);
+    if (!approach_state.setFromIK(joint_model_group, approach, tip_link, 10, 0.05))
+      continue;
+    approach_state.update();
+    picks++;
+
+    robot_state::RobotState state(approach_state);
+    if (planLeg(jacobian, state, approach, grasp, jacobian_result) &&
+        planLeg(jacobian, state, grasp, deapproach, jacobian_result))
+      jacobian_result.successes++;
+
+    state = approach_state;
+    if (planLeg(moveit, state, approach, grasp, moveit_result) &&
+        planLeg(moveit, state, grasp, deapproach, moveit_result))
+      moveit_result.successes++;
+  }
+
+  ROS_INFO("CARTESIAN BENCHMARK: %zu of %zu approach poses reachable, step %.3f m", picks,
+           srv.response.grasp_poses.size(), step);
+  report("jacobian", jacobian_result, picks);
+  report("moveit", moveit_result, picks);
+  ROS_INFO("CARTESIAN BENCHMARK: Jacobian interpolator IK fallbacks: %zu", interpolator.ikFallbacks());
+
+  return 0;
+}
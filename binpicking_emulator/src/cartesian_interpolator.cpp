@@ -0,0 +1,166 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/cartesian_interpolator.h"
+
+#include <eigen_conversions/eigen_msg.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+#include <algorithm>
+#include <cmath>
+
+CartesianInterpolator::CartesianInterpolator(const robot_model::RobotModelConstPtr& robot_model,
+                                             const std::string& group_name, const std::string& tip_link,
+                                             double position_step, double orientation_step, double jump_threshold,
+                                             double ik_timeout, std::mutex& kinematics_mutex)
+  : robot_model_(robot_model)
+  , group_name_(group_name)
+  , position_step_(position_step)
+  , orientation_step_(orientation_step)
+  , jump_threshold_(jump_threshold)
+  , max_iterations_(10)
+  , position_tolerance_(1e-5)
+  , orientation_tolerance_(1e-4)
+  , damping_(1e-3)
+  , ik_timeout_(ik_timeout)
+  , start_position_tolerance_(1e-3)
+  , start_orientation_tolerance_(1e-2)
+  , kinematics_mutex_(kinematics_mutex)
+  , ik_fallbacks_(0)
+{
+  joint_model_group_ = robot_model_->getJointModelGroup(group_name);
+  tip_link_ = robot_model_->getLinkModel(tip_link);
+}
+
+CartesianInterpolator::~CartesianInterpolator()
+{
+}
+
+double CartesianInterpolator::interpolate(const robot_state::RobotState& start_state, const geometry_msgs::Pose& from,
+                                          const geometry_msgs::Pose& target, moveit_msgs::RobotTrajectory& trajectory)
+{
+  // Start state may come from a different instance of the same robot model
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+  std::vector<double> joints;
+  start_state.copyJointGroupPositions(group_name_, joints);
+  state.setJointGroupPositions(joint_model_group_, joints);
+  state.update();
+
+  Eigen::Affine3d start_pose = state.getGlobalLinkTransform(tip_link_);
+  Eigen::Affine3d from_pose, target_pose;
+  tf::poseMsgToEigen(from, from_pose);
+  tf::poseMsgToEigen(target, target_pose);
+
+  // Path is interpolated from the start state, it has to be at from pose
+  Eigen::AngleAxisd start_error(from_pose.rotation() * start_pose.rotation().transpose());
+  double start_distance = (from_pose.translation() - start_pose.translation()).norm();
+  if (start_distance > start_position_tolerance_ || start_error.angle() > start_orientation_tolerance_)
+  {
+    ROS_WARN("Cartesian interpolator: Start state is %.4f m, %.4f rad away from path start", start_distance,
+             start_error.angle());
+    trajectory = moveit_msgs::RobotTrajectory();
+    return 0.0;
+  }
+
+  Eigen::Quaterniond start_orientation(start_pose.rotation());
+  Eigen::Quaterniond target_orientation(target_pose.rotation());
+  Eigen::Vector3d translation = target_pose.translation() - start_pose.translation();
+
+  // Both position and orientation change are limited per step
+  double steps_by_position = translation.norm() / position_step_;
+  double steps_by_orientation = start_orientation.angularDistance(target_orientation) / orientation_step_;
+  std::size_t steps = std::max<std::size_t>(1, std::ceil(std::max(steps_by_position, steps_by_orientation)));
+
+  robot_trajectory::RobotTrajectory robot_trajectory(robot_model_, group_name_);
+  robot_trajectory.addSuffixWayPoint(state, 0.0);
+
+  Eigen::VectorXd previous, current;
+  state.copyJointGroupPositions(joint_model_group_, previous);
+
+  std::size_t achieved = 0;
+  for (std::size_t i = 1; i <= steps; i++)
+  {
+    double t = static_cast<double>(i) / steps;
+    Eigen::Affine3d waypoint(start_orientation.slerp(t, target_orientation));
+    waypoint.translation() = start_pose.translation() + t * translation;
+
+    if (!stepTo(state, waypoint))
+    {
+      // Restart from previous solution, stepping may have diverged
+      state.setJointGroupPositions(joint_model_group_, previous);
+      state.update();
+      if (!solveIK(state, waypoint))
+        break;
+    }
+
+    // Reject configuration flips instead of smoothing them afterwards
+    state.copyJointGroupPositions(joint_model_group_, current);
+    if ((current - previous).cwiseAbs().maxCoeff() > jump_threshold_)
+      break;
+
+    robot_trajectory.addSuffixWayPoint(state, 0.0);
+    previous = current;
+    achieved = i;
+  }
+
+  trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+  time_parameterization.computeTimeStamps(robot_trajectory);
+  robot_trajectory.getRobotTrajectoryMsg(trajectory);
+
+  return static_cast<double>(achieved) / steps;
+}
+
+bool CartesianInterpolator::stepTo(robot_state::RobotState& state, const Eigen::Affine3d& target)
+{
+  Eigen::MatrixXd jacobian;
+  Eigen::VectorXd error(6);
+  Eigen::VectorXd joints;
+  state.copyJointGroupPositions(joint_model_group_, joints);
+
+  for (int iteration = 0; iteration < max_iterations_; iteration++)
+  {
+    const Eigen::Affine3d& current = state.getGlobalLinkTransform(tip_link_);
+    Eigen::AngleAxisd rotation_error(target.rotation() * current.rotation().transpose());
+    error.head<3>() = target.translation() - current.translation();
+    error.tail<3>() = rotation_error.axis() * rotation_error.angle();
+
+    if (error.head<3>().norm() < position_tolerance_ && error.tail<3>().norm() < orientation_tolerance_)
+      return true;
+
+    // Damped least squares keeps steps bounded near singularities
+    state.getJacobian(joint_model_group_, tip_link_, Eigen::Vector3d::Zero(), jacobian);
+    Eigen::MatrixXd jjt = jacobian * jacobian.transpose();
+    jjt.diagonal().array() += damping_ * damping_;
+    joints += jacobian.transpose() * jjt.ldlt().solve(error);
+
+    state.setJointGroupPositions(joint_model_group_, joints);
+    state.enforceBounds(joint_model_group_);
+    state.update();
+    state.copyJointGroupPositions(joint_model_group_, joints);
+  }
+
+  return false;
+}
+
+bool CartesianInterpolator::solveIK(robot_state::RobotState& state, const Eigen::Affine3d& target)
+{
+  // Kinematics solver instance is shared by all planning threads
+  ik_fallbacks_++;
+  std::lock_guard<std::mutex> lock(kinematics_mutex_);
+  return state.setFromIK(joint_model_group_, target, tip_link_->getName(), 1, ik_timeout_);
+}
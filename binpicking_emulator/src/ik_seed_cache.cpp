@@ -0,0 +1,275 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/ik_seed_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+const char SEED_FILE_MAGIC[4] = { 'B', 'P', 'I', 'K' };
+const uint32_t SEED_FILE_VERSION = 2;
+
+// Upper bounds of header values, protect against huge allocations from corrupt files
+const uint32_t MAX_SEEDS = 10000000;
+const uint32_t MAX_JOINTS = 64;
+const uint32_t MAX_NAME_LENGTH = 256;
+
+// Weight of orientation difference (rad) relative to position difference (m)
+const double ORIENTATION_WEIGHT = 0.1;
+}  // namespace
+
+IkSeedCache::IkSeedCache(const ConfigData& config, double voxel_size, std::size_t seeds_per_voxel,
+                         const std::vector<std::string>& joint_names)
+  : voxel_size_(voxel_size), seeds_per_voxel_(std::max<std::size_t>(seeds_per_voxel, 1)), joint_names_(joint_names)
+{
+  // Grid stays empty on invalid voxel size, all queries miss
+  if (!(voxel_size_ > 0))
+  {
+    ROS_ERROR("IK seed cache: Voxel size has to be positive, got %f", voxel_size_);
+    std::fill(min_, min_ + 3, 0.0);
+    std::fill(dimensions_, dimensions_ + 3, 0);
+    return;
+  }
+
+  // Approach and deapproach poses lie outside of the bin, extend grid accordingly
+  double margin = std::max(config.approach_distance, config.deapproach_height);
+  double center[3] = { config.bin_center_x, config.bin_center_y, config.bin_center_z };
+  double size[3] = { config.bin_size_x, config.bin_size_y, config.bin_size_z };
+
+  for (int i = 0; i < 3; i++)
+  {
+    min_[i] = center[i] - size[i] / 2 - margin;
+    dimensions_[i] = static_cast<int>(std::ceil((size[i] + 2 * margin) / voxel_size_));
+  }
+
+  voxels_.resize(dimensions_[0] * dimensions_[1] * dimensions_[2]);
+}
+
+IkSeedCache::~IkSeedCache()
+{
+}
+
+bool IkSeedCache::nearest(const geometry_msgs::Pose& pose, std::vector<double>& joints)
+{
+  int index[3];
+  if (!voxelIndex(pose.position.x, pose.position.y, pose.position.z, index))
+    return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Search voxel of the query and its direct neighbours
+  double best_distance = std::numeric_limits<double>::max();
+  const IkSeed* best_seed = NULL;
+
+  for (int x = std::max(index[0] - 1, 0); x <= std::min(index[0] + 1, dimensions_[0] - 1); x++)
+    for (int y = std::max(index[1] - 1, 0); y <= std::min(index[1] + 1, dimensions_[1] - 1); y++)
+      for (int z = std::max(index[2] - 1, 0); z <= std::min(index[2] + 1, dimensions_[2] - 1); z++)
+      {
+        const std::vector<IkSeed>& voxel = voxels_[(x * dimensions_[1] + y) * dimensions_[2] + z];
+        for (std::size_t i = 0; i < voxel.size(); i++)
+        {
+          const IkSeed& seed = voxel[i];
+          double dx = seed.position[0] - pose.position.x;
+          double dy = seed.position[1] - pose.position.y;
+          double dz = seed.position[2] - pose.position.z;
+          double dot = seed.orientation[0] * pose.orientation.x + seed.orientation[1] * pose.orientation.y +
+                       seed.orientation[2] * pose.orientation.z + seed.orientation[3] * pose.orientation.w;
+          double angle = 2 * std::acos(std::min(std::fabs(dot), 1.0));
+
+          double distance = std::sqrt(dx * dx + dy * dy + dz * dz) + ORIENTATION_WEIGHT * angle;
+          if (distance < best_distance)
+          {
+            best_distance = distance;
+            best_seed = &seed;
+          }
+        }
+      }
+
+  if (best_seed == NULL)
+    return false;
+
+  joints = best_seed->joints;
+  return true;
+}
+
+void IkSeedCache::insert(const geometry_msgs::Pose& pose, const std::vector<double>& joints)
+{
+  IkSeed seed;
+  seed.position[0] = pose.position.x;
+  seed.position[1] = pose.position.y;
+  seed.position[2] = pose.position.z;
+  seed.orientation[0] = pose.orientation.x;
+  seed.orientation[1] = pose.orientation.y;
+  seed.orientation[2] = pose.orientation.z;
+  seed.orientation[3] = pose.orientation.w;
+  seed.joints = joints;
+  if (seed.joints.size() != joint_names_.size())
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  insertSeed(seed);
+}
+
+bool IkSeedCache::load(const std::string& filepath)
+{
+  std::ifstream file(filepath.c_str(), std::ios::binary);
+  if (!file)
+    return false;
+
+  char magic[4];
+  uint32_t version, num_of_joints, count;
+  if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, SEED_FILE_MAGIC) ||
+      !file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != SEED_FILE_VERSION ||
+      !file.read(reinterpret_cast<char*>(&num_of_joints), sizeof(num_of_joints)) || num_of_joints > MAX_JOINTS)
+  {
+    ROS_ERROR("IK seed cache: %s is not a valid seed file", filepath.c_str());
+    return false;
+  }
+
+  // Seeds of other joints would be applied to the wrong group
+  std::vector<std::string> joint_names(num_of_joints);
+  for (uint32_t j = 0; j < num_of_joints; j++)
+  {
+    uint32_t length;
+    if (!file.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_NAME_LENGTH)
+    {
+      ROS_ERROR("IK seed cache: %s is not a valid seed file", filepath.c_str());
+      return false;
+    }
+    joint_names[j].resize(length);
+    if (!file.read(&joint_names[j][0], length))
+    {
+      ROS_ERROR("IK seed cache: %s is not a valid seed file", filepath.c_str());
+      return false;
+    }
+  }
+
+  if (joint_names != joint_names_)
+  {
+    ROS_ERROR("IK seed cache: %s was built for other joints", filepath.c_str());
+    return false;
+  }
+
+  if (!file.read(reinterpret_cast<char*>(&count), sizeof(count)) || count > MAX_SEEDS)
+  {
+    ROS_ERROR("IK seed cache: %s is not a valid seed file", filepath.c_str());
+    return false;
+  }
+
+  // Read all seeds first, truncated file leaves the cache untouched
+  std::vector<IkSeed> seeds(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    IkSeed& seed = seeds[i];
+    seed.joints.resize(num_of_joints);
+    if (!file.read(reinterpret_cast<char*>(seed.position), sizeof(seed.position)) ||
+        !file.read(reinterpret_cast<char*>(seed.orientation), sizeof(seed.orientation)) ||
+        !file.read(reinterpret_cast<char*>(seed.joints.data()), num_of_joints * sizeof(double)))
+    {
+      ROS_ERROR("IK seed cache: %s is truncated", filepath.c_str());
+      return false;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < seeds.size(); i++)
+    insertSeed(seeds[i]);
+
+  ROS_INFO("IK seed cache: %zu seeds loaded from %s", seeds.size(), filepath.c_str());
+  return true;
+}
+
+bool IkSeedCache::save(const std::string& filepath)
+{
+  std::ofstream file(filepath.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file)
+  {
+    ROS_ERROR("IK seed cache: Not able to write %s", filepath.c_str());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  uint32_t count = 0;
+  for (std::size_t v = 0; v < voxels_.size(); v++)
+    count += voxels_[v].size();
+
+  file.write(SEED_FILE_MAGIC, sizeof(SEED_FILE_MAGIC));
+  file.write(reinterpret_cast<const char*>(&SEED_FILE_VERSION), sizeof(SEED_FILE_VERSION));
+
+  uint32_t num_of_joints = joint_names_.size();
+  file.write(reinterpret_cast<const char*>(&num_of_joints), sizeof(num_of_joints));
+  for (std::size_t j = 0; j < joint_names_.size(); j++)
+  {
+    uint32_t length = joint_names_[j].size();
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(joint_names_[j].data(), length);
+  }
+
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+  for (std::size_t v = 0; v < voxels_.size(); v++)
+    for (std::size_t i = 0; i < voxels_[v].size(); i++)
+    {
+      const IkSeed& seed = voxels_[v][i];
+      file.write(reinterpret_cast<const char*>(seed.position), sizeof(seed.position));
+      file.write(reinterpret_cast<const char*>(seed.orientation), sizeof(seed.orientation));
+      file.write(reinterpret_cast<const char*>(seed.joints.data()), num_of_joints * sizeof(double));
+    }
+
+  return static_cast<bool>(file);
+}
+
+std::size_t IkSeedCache::size()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::size_t count = 0;
+  for (std::size_t v = 0; v < voxels_.size(); v++)
+    count += voxels_[v].size();
+  return count;
+}
+
+bool IkSeedCache::voxelIndex(double x, double y, double z, int index[3]) const
+{
+  double position[3] = { x, y, z };
+  for (int i = 0; i < 3; i++)
+  {
+    // Checked before the cast, far or NaN positions would overflow the int
+    double offset = (position[i] - min_[i]) / voxel_size_;
+    if (!(offset >= 0 && offset < dimensions_[i]))
+      return false;
+    index[i] = static_cast<int>(offset);
+  }
+  return true;
+}
+
+void IkSeedCache::insertSeed(const IkSeed& seed)
+{
+  int index[3];
+  if (!voxelIndex(seed.position[0], seed.position[1], seed.position[2], index))
+    return;
+
+  // Voxel keeps the most recent seeds only
+  std::vector<IkSeed>& voxel = voxels_[(index[0] * dimensions_[1] + index[1]) * dimensions_[2] + index[2]];
+  if (voxel.size() >= seeds_per_voxel_)
+    voxel.erase(voxel.begin());
+  voxel.push_back(seed);
+}
@@ -0,0 +1,217 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/latency_model.h"
+
+#include <algorithm>
+#include <fstream>
+
+LatencyModel::LatencyModel() : zero_latency_(false), generator_(std::random_device()())
+{
+}
+
+LatencyModel::~LatencyModel()
+{
+}
+
+bool LatencyModel::load(const std::string& filepath)
+{
+  // Parsed completely before anything is applied, an invalid file leaves the model unchanged
+  std::map<std::string, LatencyDistribution> distributions;
+  bool has_zero_latency = false, zero_latency = false;
+  bool has_seed = false;
+  unsigned int seed = 0;
+  try
+  {
+    YAML::Node config = YAML::LoadFile(filepath);
+
+    has_zero_latency = config["zero_latency"].IsDefined();
+    if (has_zero_latency)
+      zero_latency = config["zero_latency"].as<bool>();
+
+    has_seed = config["seed"].IsDefined();
+    if (has_seed)
+      seed = config["seed"].as<unsigned int>();
+
+    YAML::Node services = config["services"];
+    for (YAML::const_iterator it = services.begin(); it != services.end(); ++it)
+    {
+      std::string service = it->first.as<std::string>();
+      if (std::find(LATENCY::SERVICE::ALL.begin(), LATENCY::SERVICE::ALL.end(), service) ==
+          LATENCY::SERVICE::ALL.end())
+      {
+        ROS_ERROR("Latency model: Unknown service %s in %s", service.c_str(), filepath.c_str());
+        return false;
+      }
+
+      LatencyDistribution distribution;
+      if (!parseDistribution(it->second, distribution))
+      {
+        ROS_ERROR("Latency model: Invalid latency definition of %s service", service.c_str());
+        return false;
+      }
+      distributions[service] = distribution;
+    }
+  }
+  catch (YAML::Exception& e)
+  {
+    ROS_ERROR("Latency model: Error reading yaml config file %s: %s", filepath.c_str(), e.what());
+    return false;
+  }
+
+  if (has_zero_latency)
+    setZeroLatency(zero_latency);
+  if (has_seed)
+    setSeed(seed);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : distributions)
+    distributions_[entry.first] = entry.second;
+  return true;
+}
+
+void LatencyModel::setFixed(const std::string& service, double seconds)
+{
+  LatencyDistribution distribution;
+  distribution.type = LatencyDistribution::FIXED;
+  distribution.a = seconds;
+  distribution.b = 0;
+  distribution.trace_index = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  distributions_[service] = distribution;
+}
+
+void LatencyModel::setZeroLatency(bool zero_latency)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  zero_latency_ = zero_latency;
+}
+
+void LatencyModel::setSeed(unsigned int seed)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  generator_.seed(seed);
+}
+
+double LatencyModel::sample(const std::string& service)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = distributions_.find(service);
+  if (zero_latency_ || it == distributions_.end())
+    return 0;
+
+  LatencyDistribution& distribution = it->second;
+  double seconds = 0;
+
+  switch (distribution.type)
+  {
+    case LatencyDistribution::FIXED:
+      seconds = distribution.a;
+      break;
+    case LatencyDistribution::UNIFORM:
+      seconds = std::uniform_real_distribution<double>(distribution.a, distribution.b)(generator_);
+      break;
+    case LatencyDistribution::NORMAL:
+      seconds = std::normal_distribution<double>(distribution.a, distribution.b)(generator_);
+      break;
+    case LatencyDistribution::LOGNORMAL:
+      seconds = std::lognormal_distribution<double>(distribution.a, distribution.b)(generator_);
+      break;
+    case LatencyDistribution::TRACE:
+      // Replay recorded latencies in a loop
+      seconds = distribution.trace[distribution.trace_index];
+      distribution.trace_index = (distribution.trace_index + 1) % distribution.trace.size();
+      break;
+  }
+
+  return std::max(seconds, 0.0);
+}
+
+void LatencyModel::setClock(const std::shared_ptr<SimClock>& clock)
+{
+  clock_ = clock;
+}
+
+void LatencyModel::sleep(const std::string& service)
+{
+  double seconds = sample(service);
+  if (seconds <= 0)
+    return;
+
+  if (clock_)
+    clock_->advance(seconds);
+  else
+    ros::Duration(seconds).sleep();
+}
+
+bool LatencyModel::parseDistribution(const YAML::Node& node, LatencyDistribution& distribution)
+{
+  std::string type = node["type"].as<std::string>();
+  distribution.a = 0;
+  distribution.b = 0;
+  distribution.trace_index = 0;
+
+  if (type == "fixed")
+  {
+    distribution.type = LatencyDistribution::FIXED;
+    distribution.a = node["value"].as<double>();
+  }
+  else if (type == "uniform")
+  {
+    distribution.type = LatencyDistribution::UNIFORM;
+    distribution.a = node["min"].as<double>();
+    distribution.b = node["max"].as<double>();
+    return distribution.a <= distribution.b;
+  }
+  else if (type == "normal")
+  {
+    distribution.type = LatencyDistribution::NORMAL;
+    distribution.a = node["mean"].as<double>();
+    distribution.b = node["stddev"].as<double>();
+    return distribution.b > 0;
+  }
+  else if (type == "lognormal")
+  {
+    distribution.type = LatencyDistribution::LOGNORMAL;
+    distribution.a = node["mu"].as<double>();
+    distribution.b = node["sigma"].as<double>();
+    return distribution.b > 0;
+  }
+  else if (type == "trace")
+  {
+    distribution.type = LatencyDistribution::TRACE;
+    return loadTrace(node["filepath"].as<std::string>(), distribution.trace);
+  }
+  else
+    return false;
+
+  return true;
+}
+
+bool LatencyModel::loadTrace(const std::string& filepath, std::vector<double>& trace)
+{
+  // Trace file holds one latency in seconds per line
+  std::ifstream file(filepath.c_str());
+  double seconds;
+  while (file >> seconds)
+    trace.push_back(seconds);
+
+  if (trace.empty())
+    ROS_ERROR("Latency model: Not able to read latency trace %s", filepath.c_str());
+  return !trace.empty();
+}
@@ -0,0 +1,202 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+double percentile(std::vector<double> values, double p)
+{
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[static_cast<std::size_t>(p * (values.size() - 1) + 0.5)];
+}
+
+//-----------------------------------------------------------------------------------------
+// LatencyHistogram
+//-----------------------------------------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_ns_(0), max_ns_(0)
+{
+  for (int i = 0; i < BUCKETS; i++)
+    buckets_[i] = 0;
+}
+
+void LatencyHistogram::record(double seconds)
+{
+  uint64_t ns = seconds > 0 ? static_cast<uint64_t>(seconds * 1e9) : 0;
+
+  // Bucket i holds durations below 2^i microseconds
+  uint64_t us = ns / 1000;
+  int bucket = 0;
+  while (us > 0 && bucket < BUCKETS - 1)
+  {
+    us >>= 1;
+    bucket++;
+  }
+
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+
+  uint64_t max = max_ns_.load(std::memory_order_relaxed);
+  while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+  {
+  }
+}
+
+LatencySummary LatencyHistogram::summary() const
+{
+  // Snapshot is not atomic as a whole, concurrent records may be partially visible
+  uint64_t buckets[BUCKETS];
+  uint64_t count = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    count += buckets[i];
+  }
+
+  LatencySummary summary;
+  summary.count = count;
+  summary.mean = count ? sum_ns_.load(std::memory_order_relaxed) * 1e-9 / count : 0;
+  summary.max = max_ns_.load(std::memory_order_relaxed) * 1e-9;
+
+  const double quantiles[3] = { 0.5, 0.9, 0.99 };
+  double* results[3] = { &summary.p50, &summary.p90, &summary.p99 };
+  for (int q = 0; q < 3; q++)
+  {
+    *results[q] = 0;
+    uint64_t rank = static_cast<uint64_t>(quantiles[q] * count);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BUCKETS && count > 0; i++)
+    {
+      cumulative += buckets[i];
+      if (cumulative > rank)
+      {
+        // Last bucket also holds all longer durations, its bound is the maximum
+        double bound = i < BUCKETS - 1 ? static_cast<double>(1ull << i) * 1e-6 : summary.max;
+        *results[q] = std::min(bound, summary.max);
+        break;
+      }
+    }
+  }
+
+  return summary;
+}
+
+//-----------------------------------------------------------------------------------------
+// ScopedTimer
+//-----------------------------------------------------------------------------------------
+
+ScopedTimer::ScopedTimer(LatencyHistogram& histogram, double* elapsed)
+  : histogram_(histogram), elapsed_(elapsed), start_(std::chrono::steady_clock::now())
+{
+}
+
+ScopedTimer::~ScopedTimer()
+{
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  histogram_.record(seconds);
+  if (elapsed_)
+    *elapsed_ = seconds;
+}
+
+//-----------------------------------------------------------------------------------------
+// Metrics
+//-----------------------------------------------------------------------------------------
+
+const char* Metrics::name(METRICS::Metric metric)
+{
+  switch (metric)
+  {
+    case METRICS::TRAJECTORY_SERVICE:
+      return "trajectory_service";
+    case METRICS::START_LEG:
+      return "start_leg";
+    case METRICS::APPROACH_LEG:
+      return "approach_leg";
+    case METRICS::GRASP_LEG:
+      return "grasp_leg";
+    case METRICS::DEAPPROACH_LEG:
+      return "deapproach_leg";
+    case METRICS::END_LEG:
+      return "end_leg";
+    case METRICS::IK:
+      return "ik";
+    case METRICS::BIN_POSE_CALL:
+      return "bin_pose_call";
+    case METRICS::VISUALIZATION:
+      return "visualization";
+    case METRICS::POST_PROCESSING:
+      return "post_processing";
+    default:
+      return "unknown";
+  }
+}
+
+void Metrics::toDiagnostics(diagnostic_msgs::DiagnosticArray& array) const
+{
+  array.header.stamp = ros::Time::now();
+  array.status.clear();
+
+  for (int m = 0; m < METRICS::COUNT; m++)
+  {
+    LatencySummary summary = histograms_[m].summary();
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = std::string("binpicking_emulator/") + name(static_cast<METRICS::Metric>(m));
+    status.message = "latency in seconds";
+
+    const char* keys[6] = { "count", "mean", "p50", "p90", "p99", "max" };
+    double values[6] = { static_cast<double>(summary.count), summary.mean, summary.p50,
+                         summary.p90, summary.p99, summary.max };
+    for (int k = 0; k < 6; k++)
+    {
+      diagnostic_msgs::KeyValue key_value;
+      key_value.key = keys[k];
+      std::ostringstream value;
+      value << values[k];
+      key_value.value = value.str();
+      status.values.push_back(key_value);
+    }
+
+    array.status.push_back(status);
+  }
+}
+
+std::string Metrics::dump() const
+{
+  std::ostringstream out;
+  char line[160];
+  snprintf(line, sizeof(line), "%-20s %10s %10s %10s %10s %10s %10s\n", "metric [ms]", "count", "mean", "p50", "p90",
+           "p99", "max");
+  out << line;
+
+  for (int m = 0; m < METRICS::COUNT; m++)
+  {
+    LatencySummary summary = histograms_[m].summary();
+    snprintf(line, sizeof(line), "%-20s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+             name(static_cast<METRICS::Metric>(m)), static_cast<unsigned long long>(summary.count),
+             summary.mean * 1e3, summary.p50 * 1e3, summary.p90 * 1e3, summary.p99 * 1e3, summary.max * 1e3);
+    out << line;
+  }
+
+  return out.str();
+}
@@ -0,0 +1,210 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Runs full pick planning cycles in process with seeded grasp candidates
+// and reports per leg latency percentiles, success rate and path length
+
+#include "binpicking_emulator/binpicking_emulator.h"
+
+#include <fstream>
+#include <numeric>
+
+struct CycleResult
+{
+  bool success;
+  double total;
+  double path_length;
+  PickTiming timing;
+};
+
+// Values of all cycles, legs and path length of successful cycles only
+struct BenchmarkSeries
+{
+  std::vector<double> total, start, approach, grasp, deapproach, end, path_length;
+};
+
+static void collectSeries(const std::vector<CycleResult>& results, BenchmarkSeries& series)
+{
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    series.total.push_back(results[i].total);
+    if (!results[i].success)
+      continue;
+
+    series.start.push_back(results[i].timing.start);
+    series.approach.push_back(results[i].timing.approach);
+    series.grasp.push_back(results[i].timing.grasp);
+    series.deapproach.push_back(results[i].timing.deapproach);
+    series.end.push_back(results[i].timing.end);
+    series.path_length.push_back(results[i].path_length);
+  }
+}
+
+static bool writeCsv(const std::string& filepath, const std::vector<CycleResult>& results)
+{
+  std::ofstream file(filepath.c_str());
+  if (!file)
+  {
+    ROS_ERROR("PICK BENCHMARK: Not able to open %s", filepath.c_str());
+    return false;
+  }
+
+  file << "cycle,success,total,start,approach,grasp,deapproach,end,path_length\n";
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const CycleResult& r = results[i];
+    file << i << "," << r.success << "," << r.total << "," << r.timing.start << "," << r.timing.approach << ","
+         << r.timing.grasp << "," << r.timing.deapproach << "," << r.timing.end << "," << r.path_length << "\n";
+  }
+
+  if (!file.good())
+  {
+    ROS_ERROR("PICK BENCHMARK: Not able to write %s", filepath.c_str());
+    return false;
+  }
+  return true;
+}
+
+static void writeStatistics(std::ostream& out, const std::string& name, const std::vector<double>& values)
+{
+  out << "    \"" << name << "\": {\"p50\": " << percentile(values, 0.5) << ", \"p90\": " << percentile(values, 0.9)
+      << ", \"p99\": " << percentile(values, 0.99) << ", \"max\": " << percentile(values, 1.0) << "}";
+}
+
+static bool writeJson(const std::string& filepath, std::size_t cycles, const BenchmarkSeries& series)
+{
+  std::ofstream file(filepath.c_str());
+  if (!file)
+  {
+    ROS_ERROR("PICK BENCHMARK: Not able to open %s", filepath.c_str());
+    return false;
+  }
+
+  const std::vector<double>& path_length = series.path_length;
+  file << "{\n  \"cycles\": " << cycles << ",\n  \"success_rate\": "
+       << (cycles ? static_cast<double>(series.start.size()) / cycles : 0) << ",\n  \"mean_path_length\": "
+       << (path_length.empty() ? 0 : std::accumulate(path_length.begin(), path_length.end(), 0.0) /
+                                         path_length.size())
+       << ",\n  \"latency\": {\n";
+  writeStatistics(file, "total", series.total);
+  file << ",\n";
+  writeStatistics(file, "start", series.start);
+  file << ",\n";
+  writeStatistics(file, "approach", series.approach);
+  file << ",\n";
+  writeStatistics(file, "grasp", series.grasp);
+  file << ",\n";
+  writeStatistics(file, "deapproach", series.deapproach);
+  file << ",\n";
+  writeStatistics(file, "end", series.end);
+  file << "\n  }\n}\n";
+
+  if (!file.good())
+  {
+    ROS_ERROR("PICK BENCHMARK: Not able to write %s", filepath.c_str());
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "pick_benchmark");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  int cycles, vision_system_id;
+  std::string csv_file, json_file;
+  std::vector<double> start_pose, end_pose;
+  pnh.param<int>("cycles", cycles, 100);
+  pnh.param<int>("vision_system_id", vision_system_id, 1);
+  pnh.param<std::string>("csv_file", csv_file, "");
+  pnh.param<std::string>("json_file", json_file, "");
+
+  // Seeded candidates unless set explicitly
+  if (!pnh.hasParam("candidate_seed"))
+    pnh.setParam("candidate_seed", 1);
+
+  ros::service::waitForService("bin_pose_batch");
+
+  // Scene and state monitors need callbacks processed during planning
+  ros::AsyncSpinner spinner(2);
+  spinner.start();
+
+  // Emulator reads its params from the private namespace of this node
+  BinpickingEmulator emulator(&nh);
+  robot_state::RobotState state = emulator.getCurrentState();
+
+  //---------------------------------------------------
+  // Initialize start and end pose
+  //---------------------------------------------------
+  std::vector<double> current_joints;
+  state.copyJointGroupPositions("manipulator", current_joints);
+  if (!pnh.getParam("start_pose", start_pose))
+    start_pose = current_joints;
+  if (!pnh.getParam("end_pose", end_pose))
+    end_pose = start_pose;
+
+  photoneo_msgs::initialize_pose::Request init_req;
+  photoneo_msgs::initialize_pose::Response init_res;
+  init_req.vision_system_id = vision_system_id;
+  init_req.startPose.position = start_pose;
+  init_req.endPose.position = end_pose;
+  emulator.binPickingInitCallback(init_req, init_res);
+
+  //---------------------------------------------------
+  // Run pick cycles
+  //---------------------------------------------------
+  std::vector<CycleResult> results;
+  for (int cycle = 0; cycle < cycles && ros::ok(); cycle++)
+  {
+    PickPlan plan;
+    std::chrono::steady_clock::time_point cycle_start = std::chrono::steady_clock::now();
+
+    CycleResult result;
+    result.success = emulator.planPickCycle(vision_system_id, state, plan);
+    result.total = std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_start).count();
+    result.path_length = result.success ? plan.score : 0;
+    result.timing = plan.timing;
+    results.push_back(result);
+
+    // Next cycle starts where the robot finished this one
+    if (result.success)
+      state.setJointGroupPositions("manipulator", plan.end_trajectory.joint_trajectory.points.back().positions);
+  }
+
+  //---------------------------------------------------
+  // Report
+  //---------------------------------------------------
+  BenchmarkSeries series;
+  collectSeries(results, series);
+
+  ROS_INFO("PICK BENCHMARK: %zu/%zu cycles succeeded", series.start.size(), results.size());
+  ROS_INFO("PICK BENCHMARK: cycle p50 %.3f s, p90 %.3f s, p99 %.3f s", percentile(series.total, 0.5),
+           percentile(series.total, 0.9), percentile(series.total, 0.99));
+  ROS_INFO("PICK BENCHMARK: p50 start %.3f s, approach %.3f s, grasp %.3f s, deapproach %.3f s, end %.3f s",
+           percentile(series.start, 0.5), percentile(series.approach, 0.5), percentile(series.grasp, 0.5),
+           percentile(series.deapproach, 0.5), percentile(series.end, 0.5));
+
+  // Failed report makes the run fail, scripts would read stale files otherwise
+  bool written = true;
+  if (!csv_file.empty())
+    written &= writeCsv(csv_file, results);
+  if (!json_file.empty())
+    written &= writeJson(json_file, results.size(), series);
+
+  return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,239 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/planning_backend.h"
+
+#include <eigen_conversions/eigen_msg.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+//-----------------------------------------------------------------------------------------
+// MoveGroupBackend
+//-----------------------------------------------------------------------------------------
+
+MoveGroupBackend::MoveGroupBackend(ros::NodeHandle& nh, const std::string& group_name, const std::string& planner_id,
+                                   double goal_tolerance)
+{
+  group_.reset(new moveit::planning_interface::MoveGroupInterface(group_name));
+  group_->setPlannerId(planner_id);
+  group_->setGoalTolerance(goal_tolerance);
+
+  plan_client_ = nh.serviceClient<moveit_msgs::GetMotionPlan>("plan_kinematic_path");
+}
+
+MoveGroupBackend::~MoveGroupBackend()
+{
+}
+
+bool MoveGroupBackend::planToJointTarget(const robot_state::RobotState& start_state,
+                                         const std::vector<double>& joint_target,
+                                         moveit_msgs::RobotTrajectory& trajectory)
+{
+  group_->setStartState(start_state);
+  group_->setJointValueTarget(joint_target);
+  return plan(trajectory);
+}
+
+bool MoveGroupBackend::planToStateTarget(const robot_state::RobotState& start_state,
+                                         const robot_state::RobotState& goal_state,
+                                         moveit_msgs::RobotTrajectory& trajectory)
+{
+  group_->setStartState(start_state);
+  group_->setJointValueTarget(goal_state);
+  return plan(trajectory);
+}
+
+bool MoveGroupBackend::planToPoseTarget(const robot_state::RobotState& start_state,
+                                        const geometry_msgs::Pose& pose_target,
+                                        moveit_msgs::RobotTrajectory& trajectory)
+{
+  group_->setStartState(start_state);
+  group_->setPoseTarget(pose_target);
+  return plan(trajectory);
+}
+
+double MoveGroupBackend::computeCartesianPath(const robot_state::RobotState& start_state,
+                                              const std::vector<geometry_msgs::Pose>& waypoints, double eef_step,
+                                              moveit_msgs::RobotTrajectory& trajectory)
+{
+  group_->setStartState(start_state);
+  return group_->computeCartesianPath(waypoints, eef_step, 0, trajectory, false);
+}
+
+std::string MoveGroupBackend::getEndEffectorLink()
+{
+  return group_->getEndEffectorLink();
+}
+
+bool MoveGroupBackend::plan(moveit_msgs::RobotTrajectory& trajectory)
+{
+  // Plan through plan_kinematic_path service, so that concurrent workers
+  // do not preempt each other on the move_group action server
+  moveit_msgs::GetMotionPlan srv;
+  group_->constructMotionPlanRequest(srv.request.motion_plan_request);
+
+  if (!plan_client_.call(srv) ||
+      srv.response.motion_plan_response.error_code.val != moveit_msgs::MoveItErrorCodes::SUCCESS)
+    return false;
+
+  trajectory = srv.response.motion_plan_response.trajectory;
+  return !trajectory.joint_trajectory.points.empty();
+}
+
+//-----------------------------------------------------------------------------------------
+// PipelineBackend
+//-----------------------------------------------------------------------------------------
+
+PipelineBackend::PipelineBackend(const planning_scene_monitor::PlanningSceneMonitorPtr& scene_monitor,
+                                 const planning_pipeline::PlanningPipelinePtr& pipeline,
+                                 const std::string& group_name, const std::string& planner_id,
+                                 double goal_tolerance, double planning_time, std::mutex& kinematics_mutex)
+  : scene_monitor_(scene_monitor)
+  , pipeline_(pipeline)
+  , group_name_(group_name)
+  , planner_id_(planner_id)
+  , goal_tolerance_(goal_tolerance)
+  , planning_time_(planning_time)
+  , kinematics_mutex_(kinematics_mutex)
+{
+  joint_model_group_ = scene_monitor_->getRobotModel()->getJointModelGroup(group_name_);
+}
+
+PipelineBackend::~PipelineBackend()
+{
+}
+
+bool PipelineBackend::planToJointTarget(const robot_state::RobotState& start_state,
+                                        const std::vector<double>& joint_target,
+                                        moveit_msgs::RobotTrajectory& trajectory)
+{
+  robot_state::RobotState goal_state = toSceneState(start_state);
+  goal_state.setJointGroupPositions(joint_model_group_, joint_target);
+  return planToStateTarget(start_state, goal_state, trajectory);
+}
+
+bool PipelineBackend::planToStateTarget(const robot_state::RobotState& start_state,
+                                        const robot_state::RobotState& goal_state,
+                                        moveit_msgs::RobotTrajectory& trajectory)
+{
+  moveit_msgs::Constraints goal =
+      kinematic_constraints::constructGoalConstraints(toSceneState(goal_state), joint_model_group_, goal_tolerance_);
+  return plan(start_state, goal, trajectory);
+}
+
+bool PipelineBackend::planToPoseTarget(const robot_state::RobotState& start_state,
+                                       const geometry_msgs::Pose& pose_target,
+                                       moveit_msgs::RobotTrajectory& trajectory)
+{
+  geometry_msgs::PoseStamped pose;
+  pose.header.frame_id = scene_monitor_->getRobotModel()->getModelFrame();
+  pose.pose = pose_target;
+
+  moveit_msgs::Constraints goal =
+      kinematic_constraints::constructGoalConstraints(getEndEffectorLink(), pose, goal_tolerance_, goal_tolerance_);
+  return plan(start_state, goal, trajectory);
+}
+
+double PipelineBackend::computeCartesianPath(const robot_state::RobotState& start_state,
+                                             const std::vector<geometry_msgs::Pose>& waypoints, double eef_step,
+                                             moveit_msgs::RobotTrajectory& trajectory)
+{
+  robot_state::RobotState state = toSceneState(start_state);
+  const robot_model::LinkModel* link = state.getLinkModel(getEndEffectorLink());
+
+  EigenSTL::vector_Affine3d targets(waypoints.size());
+  for (std::size_t i = 0; i < waypoints.size(); i++)
+    tf::poseMsgToEigen(waypoints[i], targets[i]);
+
+  // Same settings as move_group compute_cartesian_path without collision checking
+  std::vector<robot_state::RobotStatePtr> states;
+  double fraction;
+  {
+    std::lock_guard<std::mutex> lock(kinematics_mutex_);
+    fraction = state.computeCartesianPath(joint_model_group_, states, link, targets, true, eef_step, 0.0);
+  }
+
+  robot_trajectory::RobotTrajectory robot_trajectory(state.getRobotModel(), group_name_);
+  for (std::size_t i = 0; i < states.size(); i++)
+    robot_trajectory.addSuffixWayPoint(states[i], 0.0);
+
+  trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+  time_parameterization.computeTimeStamps(robot_trajectory);
+  robot_trajectory.getRobotTrajectoryMsg(trajectory);
+
+  return fraction;
+}
+
+std::string PipelineBackend::getEndEffectorLink()
+{
+  // Same default as MoveGroupInterface for groups without end effector
+  return joint_model_group_->getLinkModelNames().back();
+}
+
+bool PipelineBackend::plan(const robot_state::RobotState& start_state, const moveit_msgs::Constraints& goal,
+                           moveit_msgs::RobotTrajectory& trajectory)
+{
+  planning_interface::MotionPlanRequest request;
+  request.group_name = group_name_;
+  request.planner_id = planner_id_;
+  request.num_planning_attempts = 1;
+  request.allowed_planning_time = planning_time_;
+  robot_state::robotStateToRobotStateMsg(start_state, request.start_state);
+  request.goal_constraints.push_back(goal);
+
+  planning_scene::PlanningSceneConstPtr scene = sceneSnapshot();
+
+  planning_interface::MotionPlanResponse response;
+  bool success;
+  {
+    // Pose goals are sampled by IK of the shared kinematics solver
+    std::unique_lock<std::mutex> kinematics_lock(kinematics_mutex_, std::defer_lock);
+    if (!goal.position_constraints.empty() || !goal.orientation_constraints.empty())
+      kinematics_lock.lock();
+
+    success = pipeline_->generatePlan(scene, request, response) &&
+              response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+  if (!success)
+    return false;
+
+  response.trajectory_->getRobotTrajectoryMsg(trajectory);
+  return !trajectory.joint_trajectory.points.empty();
+}
+
+planning_scene::PlanningSceneConstPtr PipelineBackend::sceneSnapshot()
+{
+  // Scene lock is held only for the copy, scene updates are not blocked by planning
+  planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor_);
+  if (!scene_snapshot_ || scene_monitor_->getLastUpdateTime() != snapshot_time_)
+  {
+    scene_snapshot_ = planning_scene::PlanningScene::clone(scene);
+    snapshot_time_ = scene_monitor_->getLastUpdateTime();
+  }
+  return scene_snapshot_;
+}
+
+robot_state::RobotState PipelineBackend::toSceneState(const robot_state::RobotState& state)
+{
+  // State may come from a different instance of the same robot model
+  robot_state::RobotState scene_state(scene_monitor_->getRobotModel());
+  moveit_msgs::RobotState state_msg;
+  robot_state::robotStateToRobotStateMsg(state, state_msg);
+  robot_state::robotStateMsgToRobotState(state_msg, scene_state);
+  return scene_state;
+}
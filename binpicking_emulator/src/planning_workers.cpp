@@ -0,0 +1,68 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/planning_workers.h"
+
+PlanningWorkers::PlanningWorkers(std::size_t count) : tasks_(count), running_(true)
+{
+  for (std::size_t w = 0; w < count; w++)
+    threads_.push_back(std::thread(&PlanningWorkers::run, this, w));
+}
+
+PlanningWorkers::~PlanningWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+
+  for (std::size_t w = 0; w < threads_.size(); w++)
+    threads_[w].join();
+}
+
+void PlanningWorkers::post(std::size_t worker, const std::function<void()>& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_[worker].push_back(task);
+  }
+  condition_.notify_all();
+}
+
+std::size_t PlanningWorkers::size() const
+{
+  return threads_.size();
+}
+
+void PlanningWorkers::run(std::size_t worker)
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this, worker]() { return !tasks_[worker].empty() || !running_; });
+      if (tasks_[worker].empty())
+        return;
+
+      task.swap(tasks_[worker].front());
+      tasks_[worker].pop_front();
+    }
+
+    task();
+  }
+}
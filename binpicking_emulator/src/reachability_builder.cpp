@@ -0,0 +1,190 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Offline builder of the reachability map used by bin_pose_emulator to skip
+// grasp poses the robot can not reach and by binpicking_emulator to seed IK.
+// Every cell is solved by IK, voxels are distributed over all cores.
+//
+// Usage: rosrun binpicking_emulator reachability_builder [bin_config.yaml] [output_file]
+// Arguments default to "filepath" param and ~output param.
+
+#include <ros/ros.h>
+#include <bin_pose_emulator/config_data.h>
+#include <bin_pose_emulator/reachability_map.h>
+
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct BuilderSettings
+{
+  std::string group;
+  std::string tip_link;
+  double ik_timeout;
+  int ik_attempts;
+};
+
+static void buildVoxels(const robot_model::RobotModelConstPtr& robot_model, const BuilderSettings& settings,
+                        ReachabilityMap& map, std::atomic<std::size_t>& next_voxel,
+                        std::atomic<std::size_t>& reachable_cells)
+{
+  const robot_model::JointModelGroup* joint_model_group = robot_model->getJointModelGroup(settings.group);
+  const ReachabilityGrid& grid = map.grid();
+  std::size_t voxels = static_cast<std::size_t>(grid.dimensions[0]) * grid.dimensions[1] * grid.dimensions[2];
+  std::size_t orientation_bins = map.orientationBins();
+
+  // Neighbouring cells have similar solutions, previous one seeds the next IK
+  robot_state::RobotState state(robot_model);
+  state.setToDefaultValues();
+
+  for (std::size_t voxel = next_voxel++; voxel < voxels; voxel = next_voxel++)
+  {
+    for (std::size_t bin = 0; bin < orientation_bins; bin++)
+    {
+      std::size_t index = voxel * orientation_bins + bin;
+      double position[3], orientation[4];
+      map.cellPose(index, position, orientation);
+
+      geometry_msgs::Pose pose;
+      pose.position.x = position[0];
+      pose.position.y = position[1];
+      pose.position.z = position[2];
+      pose.orientation.x = orientation[0];
+      pose.orientation.y = orientation[1];
+      pose.orientation.z = orientation[2];
+      pose.orientation.w = orientation[3];
+
+      robot_state::RobotState seed(state);
+      bool reachable = state.setFromIK(joint_model_group, pose, settings.tip_link, settings.ik_attempts,
+                                       settings.ik_timeout);
+      if (!reachable)
+      {
+        state = seed;
+        map.setUnreachable(index);
+        continue;
+      }
+
+      std::vector<double> joints;
+      state.copyJointGroupPositions(joint_model_group, joints);
+      map.setSolution(index, joints);
+      reachable_cells++;
+    }
+
+    if ((voxel + 1) % 100 == 0)
+      ROS_INFO("REACHABILITY BUILDER: %zu of %zu voxels processed", voxel + 1, voxels);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "reachability_builder");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  //---------------------------------------------------
+  // Settings, ros::init already removed remapping arguments
+  //---------------------------------------------------
+  std::string filepath, output;
+  nh.getParam("filepath", filepath);
+  pnh.param<std::string>("output", output, "reachability_map.bin");
+  if (argc > 1)
+    filepath = argv[1];
+  if (argc > 2)
+    output = argv[2];
+
+  ConfigData config;
+  if (!loadConfigData(filepath, config))
+  {
+    ROS_ERROR("REACHABILITY BUILDER: Not able to load bin config %s", filepath.c_str());
+    return 1;
+  }
+
+  double voxel_size, max_polar;
+  int polar_bins, azimuth_bins, roll_bins, threads;
+  pnh.param<double>("voxel_size", voxel_size, 0.04);
+  pnh.param<double>("max_polar", max_polar, std::max(config.roll_range, config.pitch_range) / 2);
+  pnh.param<int>("polar_bins", polar_bins, 3);
+  pnh.param<int>("azimuth_bins", azimuth_bins, 8);
+  pnh.param<int>("roll_bins", roll_bins, 8);
+  pnh.param<int>("threads", threads, 0);
+
+  BuilderSettings settings;
+  pnh.param<std::string>("group", settings.group, "manipulator");
+  pnh.param<double>("ik_timeout", settings.ik_timeout, 0.005);
+  pnh.param<int>("ik_attempts", settings.ik_attempts, 3);
+
+  //---------------------------------------------------
+  // Robot models, one per thread so every thread owns its kinematics solver,
+  // zero threads selects all cores
+  //---------------------------------------------------
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::shared_ptr<robot_model_loader::RobotModelLoader> > loaders(threads);
+  for (int i = 0; i < threads; i++)
+    loaders[i].reset(new robot_model_loader::RobotModelLoader("robot_description"));
+
+  const robot_model::JointModelGroup* joint_model_group =
+      loaders[0]->getModel()->getJointModelGroup(settings.group);
+  if (!joint_model_group)
+  {
+    ROS_ERROR("REACHABILITY BUILDER: Unknown planning group %s", settings.group.c_str());
+    return 1;
+  }
+  pnh.param<std::string>("tip_link", settings.tip_link, joint_model_group->getLinkModelNames().back());
+
+  //---------------------------------------------------
+  // Build
+  //---------------------------------------------------
+  ReachabilityMap map;
+  map.create(ReachabilityMap::gridFromConfig(config, voxel_size, max_polar, polar_bins, azimuth_bins, roll_bins),
+             joint_model_group->getVariableNames());
+  ROS_INFO("REACHABILITY BUILDER: Checking %zu cells on %d threads", map.size(), threads);
+
+  std::atomic<std::size_t> next_voxel(0), reachable_cells(0);
+  ros::WallTime start = ros::WallTime::now();
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; i++)
+    workers.push_back(std::thread(buildVoxels, loaders[i]->getModel(), std::cref(settings), std::ref(map),
+                                  std::ref(next_voxel), std::ref(reachable_cells)));
+  for (std::size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  ROS_INFO("REACHABILITY BUILDER: %zu of %zu cells reachable, built in %.1f s", reachable_cells.load(), map.size(),
+           (ros::WallTime::now() - start).toSec());
+
+  if (!map.save(output))
+  {
+    ROS_ERROR("REACHABILITY BUILDER: Not able to write %s", output.c_str());
+    return 1;
+  }
+
+  // Nodes map the file without hashing it, so the written file is verified here
+  ReachabilityMap written;
+  if (!written.load(output, true))
+  {
+    ROS_ERROR("REACHABILITY BUILDER: Written map %s failed verification", output.c_str());
+    return 1;
+  }
+  ROS_INFO("REACHABILITY BUILDER: Map written to %s", output.c_str());
+
+  return 0;
+}
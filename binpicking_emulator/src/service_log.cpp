@@ -0,0 +1,153 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/service_log.h"
+
+#include <pho_robot_loader/constants.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const char LOG_FILE_MAGIC[4] = { 'B', 'P', 'S', 'L' };
+const uint32_t LOG_FILE_VERSION = 1;
+
+struct LogFileHeader
+{
+  char magic[4];
+  uint32_t version;
+};
+
+struct RecordHeader
+{
+  uint8_t service;
+  uint8_t success;
+  uint16_t reserved;
+  uint32_t vision_system_id;
+  int64_t stamp;
+  int64_t duration;
+  uint32_t request_size;
+  uint32_t response_size;
+};
+}  // namespace
+
+const char* RECORDED_SERVICE::name(Service service)
+{
+  static const char* NAMES[COUNT] = { "initialize", "scan", "trajectory", "pick_failed", "change_solution" };
+  return service < COUNT ? NAMES[service] : "unknown";
+}
+
+bool RECORDED_SERVICE::succeeded(const photoneo_msgs::operations::Response& res)
+{
+  for (std::size_t i = 0; i < res.operations.size(); i++)
+    if (res.operations[i].operation_type == pho_robot_loader::OPERATION::TYPE::ERROR)
+      return false;
+  return true;
+}
+
+bool RECORDED_SERVICE::succeeded(const photoneo_msgs::initialize_pose::Response& res)
+{
+  return res.success;
+}
+
+bool RECORDED_SERVICE::succeeded(const photoneo_msgs::trigger_with_id::Response& res)
+{
+  return res.success;
+}
+
+//-----------------------------------------------------------------------------------------
+// Writer
+//-----------------------------------------------------------------------------------------
+ServiceLogWriter::ServiceLogWriter() : start_(std::chrono::steady_clock::now())
+{
+}
+
+bool ServiceLogWriter::open(const std::string& filepath)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.open(filepath.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file_)
+    return false;
+
+  LogFileHeader header;
+  std::copy(LOG_FILE_MAGIC, LOG_FILE_MAGIC + 4, header.magic);
+  header.version = LOG_FILE_VERSION;
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.flush();
+
+  start_ = std::chrono::steady_clock::now();
+  return file_.good();
+}
+
+int64_t ServiceLogWriter::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void ServiceLogWriter::write(const ServiceRecord& record)
+{
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.service = record.service;
+  header.success = record.success;
+  header.vision_system_id = record.vision_system_id;
+  header.stamp = record.stamp;
+  header.duration = record.duration;
+  header.request_size = record.request.size();
+  header.response_size = record.response.size();
+
+  // Calls served in parallel are logged in order of completion
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.write(reinterpret_cast<const char*>(record.request.data()), record.request.size());
+  file_.write(reinterpret_cast<const char*>(record.response.data()), record.response.size());
+  file_.flush();
+}
+
+//-----------------------------------------------------------------------------------------
+// Reader
+//-----------------------------------------------------------------------------------------
+bool ServiceLogReader::open(const std::string& filepath)
+{
+  file_.open(filepath.c_str(), std::ios::binary);
+  if (!file_)
+    return false;
+
+  LogFileHeader header;
+  file_.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return file_.good() && std::equal(header.magic, header.magic + 4, LOG_FILE_MAGIC) &&
+         header.version == LOG_FILE_VERSION;
+}
+
+bool ServiceLogReader::next(ServiceRecord& record)
+{
+  RecordHeader header;
+  if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.service >= RECORDED_SERVICE::COUNT)
+    return false;
+
+  record.service = static_cast<RECORDED_SERVICE::Service>(header.service);
+  record.success = header.success != 0;
+  record.vision_system_id = header.vision_system_id;
+  record.stamp = header.stamp;
+  record.duration = header.duration;
+  record.request.resize(header.request_size);
+  record.response.resize(header.response_size);
+
+  file_.read(reinterpret_cast<char*>(record.request.data()), record.request.size());
+  file_.read(reinterpret_cast<char*>(record.response.data()), record.response.size());
+  return file_.good();
+}
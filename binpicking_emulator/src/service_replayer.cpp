@@ -0,0 +1,239 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Re-issues service calls recorded by binpicking_emulator (~record_file) to load
+// test planning with real request sequences. Calls are issued at recorded times
+// scaled by ~speed, zero speed issues them as fast as possible. With
+// ~preserve_order calls of one vision system stay in recorded order and only
+// different vision systems run in parallel on ~concurrency workers.
+//
+// Usage: rosrun binpicking_emulator service_replayer [log_file]
+
+#include <ros/ros.h>
+#include <photoneo_msgs/operations.h>
+#include <photoneo_msgs/initialize_pose.h>
+#include <photoneo_msgs/trigger_with_id.h>
+#include <pho_robot_loader/constants.h>
+#include <binpicking_emulator/metrics.h>
+#include <binpicking_emulator/service_log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace pho_robot_loader;
+
+struct ReplayResult
+{
+  std::vector<double> latencies[RECORDED_SERVICE::COUNT];
+  std::vector<double> recorded_latencies[RECORDED_SERVICE::COUNT];
+  std::size_t failures;
+  std::size_t mismatches;  // success differs from recording
+  double max_lag;          // how late calls were issued, seconds
+};
+
+template <class Service>
+static bool callService(ros::ServiceClient& client, const ServiceRecord& record)
+{
+  Service srv;
+  deserializeMessage(record.request, srv.request);
+  return client.call(srv) && RECORDED_SERVICE::succeeded(srv.response);
+}
+
+class Replayer
+{
+public:
+  Replayer(const std::vector<ServiceRecord>& records, double speed, int concurrency, bool preserve_order)
+    : records_(records), speed_(speed), concurrency_(concurrency), preserve_order_(preserve_order), next_(0)
+  {
+    result_.failures = 0;
+    result_.mismatches = 0;
+    result_.max_lag = 0;
+  }
+
+  const ReplayResult& run()
+  {
+    start_ = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < concurrency_; i++)
+      workers.push_back(std::thread(&Replayer::work, this, i));
+    for (std::size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+
+    return result_;
+  }
+
+private:
+  void work(int worker)
+  {
+    // Persistent connections, clients are not shared between threads
+    ros::NodeHandle nh;
+    ros::ServiceClient clients[RECORDED_SERVICE::COUNT];
+    clients[RECORDED_SERVICE::INITIALIZE] =
+        nh.serviceClient<photoneo_msgs::initialize_pose>(BINPICKING_SERVICES::INITIALIZE, true);
+    clients[RECORDED_SERVICE::SCAN] = nh.serviceClient<photoneo_msgs::trigger_with_id>(BINPICKING_SERVICES::SCAN, true);
+    clients[RECORDED_SERVICE::TRAJECTORY] =
+        nh.serviceClient<photoneo_msgs::operations>(BINPICKING_SERVICES::TRAJECTORY, true);
+    clients[RECORDED_SERVICE::PICK_FAILED] =
+        nh.serviceClient<photoneo_msgs::trigger_with_id>(BINPICKING_SERVICES::REMOVE_LAST_OBJECT, true);
+    clients[RECORDED_SERVICE::CHANGE_SOLUTION] =
+        nh.serviceClient<photoneo_msgs::trigger_with_id>(BINPICKING_SERVICES::CHANGE_SOLUTION, true);
+
+    if (preserve_order_)
+    {
+      for (std::size_t i = 0; i < records_.size() && ros::ok(); i++)
+        if (records_[i].vision_system_id % concurrency_ == static_cast<uint32_t>(worker))
+          replay(clients, records_[i]);
+    }
+    else
+    {
+      for (std::size_t i = next_++; i < records_.size() && ros::ok(); i = next_++)
+        replay(clients, records_[i]);
+    }
+  }
+
+  void replay(ros::ServiceClient* clients, const ServiceRecord& record)
+  {
+    // Wait for scaled recorded time
+    double lag = 0;
+    if (speed_ > 0)
+    {
+      auto scheduled = start_ + std::chrono::nanoseconds(static_cast<int64_t>(record.stamp / speed_));
+      std::this_thread::sleep_until(scheduled);
+      lag = std::chrono::duration<double>(std::chrono::steady_clock::now() - scheduled).count();
+    }
+
+    ros::ServiceClient& client = clients[record.service];
+    auto start = std::chrono::steady_clock::now();
+    bool success = false;
+    switch (record.service)
+    {
+      case RECORDED_SERVICE::INITIALIZE:
+        success = callService<photoneo_msgs::initialize_pose>(client, record);
+        break;
+      case RECORDED_SERVICE::TRAJECTORY:
+        success = callService<photoneo_msgs::operations>(client, record);
+        break;
+      default:
+        success = callService<photoneo_msgs::trigger_with_id>(client, record);
+        break;
+    }
+    double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    result_.latencies[record.service].push_back(latency);
+    result_.recorded_latencies[record.service].push_back(record.duration * 1e-9);
+    result_.max_lag = std::max(result_.max_lag, lag);
+    if (!success)
+      result_.failures++;
+    if (success != record.success)
+      result_.mismatches++;
+  }
+
+  const std::vector<ServiceRecord>& records_;
+  double speed_;
+  int concurrency_;
+  bool preserve_order_;
+
+  std::chrono::steady_clock::time_point start_;
+  std::atomic<std::size_t> next_;
+
+  std::mutex mutex_;
+  ReplayResult result_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "service_replayer");
+  ros::NodeHandle pnh("~");
+
+  std::string log_file;
+  double speed;
+  int concurrency;
+  bool preserve_order;
+  pnh.param<std::string>("log_file", log_file, "");
+  pnh.param<double>("speed", speed, 1.0);
+  pnh.param<int>("concurrency", concurrency, 1);
+  pnh.param<bool>("preserve_order", preserve_order, true);
+  if (argc > 1)
+    log_file = argv[1];
+  concurrency = std::max(concurrency, 1);
+
+  //---------------------------------------------------
+  // Load recorded calls
+  //---------------------------------------------------
+  ServiceLogReader reader;
+  if (!reader.open(log_file))
+  {
+    ROS_ERROR("SERVICE REPLAYER: Not able to open service log %s", log_file.c_str());
+    return 1;
+  }
+
+  // Records are logged in order of completion, replay in order of arrival
+  std::vector<ServiceRecord> records;
+  ServiceRecord record;
+  while (reader.next(record))
+    records.push_back(record);
+  std::stable_sort(records.begin(), records.end(),
+                   [](const ServiceRecord& a, const ServiceRecord& b) { return a.stamp < b.stamp; });
+
+  if (records.empty())
+  {
+    ROS_ERROR("SERVICE REPLAYER: No calls recorded in %s", log_file.c_str());
+    return 1;
+  }
+
+  // Shift first call to time zero
+  int64_t first_stamp = records.front().stamp;
+  for (std::size_t i = 0; i < records.size(); i++)
+    records[i].stamp -= first_stamp;
+
+  ros::service::waitForService(BINPICKING_SERVICES::TRAJECTORY);
+  ROS_INFO("SERVICE REPLAYER: Replaying %zu calls spanning %.1f s, speed %.1f, %d workers", records.size(),
+           records.back().stamp * 1e-9, speed, concurrency);
+
+  //---------------------------------------------------
+  // Replay
+  //---------------------------------------------------
+  auto start = std::chrono::steady_clock::now();
+  Replayer replayer(records, speed, concurrency, preserve_order);
+  const ReplayResult& result = replayer.run();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  ROS_INFO("SERVICE REPLAYER: %zu calls in %.2f s (%.1f calls/s), %zu failed, %zu differ from recording, "
+           "max lag %.3f s",
+           records.size(), elapsed, records.size() / elapsed, result.failures, result.mismatches, result.max_lag);
+
+  for (int i = 0; i < RECORDED_SERVICE::COUNT; i++)
+  {
+    const std::vector<double>& latencies = result.latencies[i];
+    if (latencies.empty())
+      continue;
+
+    const std::vector<double>& recorded = result.recorded_latencies[i];
+    ROS_INFO("%-16s %5zu calls, p50 %.3f s, p95 %.3f s, max %.3f s (recorded p50 %.3f s, p95 %.3f s)",
+             RECORDED_SERVICE::name(static_cast<RECORDED_SERVICE::Service>(i)), latencies.size(),
+             percentile(latencies, 0.5), percentile(latencies, 0.95), percentile(latencies, 1.0),
+             percentile(recorded, 0.5), percentile(recorded, 0.95));
+  }
+
+  return result.failures == 0 ? 0 : 1;
+}
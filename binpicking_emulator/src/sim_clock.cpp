@@ -0,0 +1,76 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/sim_clock.h"
+
+SimClock::SimClock(ros::NodeHandle* nh, double clock_publish_rate) : time_(1.0), last_wall_time_(ros::WallTime::now())
+{
+  // Latched so nodes started later get current time without waiting for next tick
+  clock_pub_ = nh->advertise<rosgraph_msgs::Clock>("/clock", 1, true);
+  publish(time_);
+
+  if (clock_publish_rate > 0)
+  {
+    ros::NodeHandle timer_nh(*nh);
+    timer_nh.setCallbackQueue(&queue_);
+    timer_ = timer_nh.createWallTimer(ros::WallDuration(1.0 / clock_publish_rate), &SimClock::timerCallback, this);
+
+    spinner_.reset(new ros::AsyncSpinner(1, &queue_));
+    spinner_->start();
+  }
+
+  ROS_INFO("BIN PICKING EMULATOR: Fast forward mode, publishing /clock %s",
+           clock_publish_rate > 0 ? "following wall time" : "advanced by emulated delays only");
+}
+
+SimClock::~SimClock()
+{
+  timer_.stop();
+  if (spinner_)
+    spinner_->stop();
+}
+
+void SimClock::advance(double seconds)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  time_ += ros::Duration(seconds);
+  publish(time_);
+}
+
+ros::Time SimClock::now()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return time_;
+}
+
+void SimClock::publish(const ros::Time& time)
+{
+  // Own time is set directly, /clock subscription of this process lags behind
+  ros::Time::setNow(time);
+
+  rosgraph_msgs::ClockPtr clock(new rosgraph_msgs::Clock());
+  clock->clock = time;
+  clock_pub_.publish(clock);
+}
+
+void SimClock::timerCallback(const ros::WallTimerEvent& event)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  ros::WallTime wall_time = ros::WallTime::now();
+  time_ += ros::Duration((wall_time - last_wall_time_).toSec());
+  last_wall_time_ = wall_time;
+  publish(time_);
+}
@@ -0,0 +1,354 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/trajectory_cache.h"
+
+#include <moveit_msgs/GetPlanningScene.h>
+
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+const char CACHE_FILE_MAGIC[4] = { 'B', 'P', 'T', 'C' };
+const uint32_t CACHE_FILE_VERSION = 2;
+
+// Upper bounds of entry sizes, protect against huge allocations from corrupt files
+const uint32_t MAX_KEY_LENGTH = 4096;
+const uint32_t MAX_MESSAGE_LENGTH = 64 * 1024 * 1024;
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value)
+{
+  return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+}  // namespace
+
+uint64_t fnv1aHash(const uint8_t* data, std::size_t size, uint64_t hash)
+{
+  for (std::size_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//-----------------------------------------------------------------------------------------
+// PlanningSceneFingerprint
+//-----------------------------------------------------------------------------------------
+
+PlanningSceneFingerprint::PlanningSceneFingerprint(ros::NodeHandle* nh) : fingerprint_(0), complete_(false)
+{
+  scene_sub_ = nh->subscribe("move_group/monitored_planning_scene", 10, &PlanningSceneFingerprint::sceneCallback, this);
+  scene_client_ = nh->serviceClient<moveit_msgs::GetPlanningScene>("get_planning_scene");
+  scene_client_.waitForExistence(ros::Duration(5.0));
+  requestScene();
+}
+
+PlanningSceneFingerprint::~PlanningSceneFingerprint()
+{
+}
+
+bool PlanningSceneFingerprint::get(uint64_t& fingerprint)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fingerprint = fingerprint_;
+    if (complete_)
+      return true;
+  }
+
+  // Full scene may not have been available at startup
+  requestScene();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  fingerprint = fingerprint_;
+  return complete_;
+}
+
+void PlanningSceneFingerprint::requestScene()
+{
+  moveit_msgs::GetPlanningScene srv;
+  srv.request.components.components = moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_NAMES |
+                                      moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY;
+  if (!scene_client_.call(srv))
+  {
+    ROS_WARN_ONCE("Trajectory cache: Not able to get planning scene, cache is bypassed until it is received");
+    return;
+  }
+
+  // Response is a full scene even when is_diff is not set by the sender
+  srv.response.scene.is_diff = false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  applyScene(srv.response.scene);
+}
+
+void PlanningSceneFingerprint::sceneCallback(const moveit_msgs::PlanningSceneConstPtr& msg)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  applyScene(*msg);
+}
+
+void PlanningSceneFingerprint::applyScene(const moveit_msgs::PlanningScene& scene)
+{
+  // Full scene replaces all known objects
+  if (!scene.is_diff)
+  {
+    object_hashes_.clear();
+    complete_ = true;
+  }
+
+  for (std::size_t i = 0; i < scene.world.collision_objects.size(); i++)
+  {
+    // Stamps change with every publish, hash only the content
+    moveit_msgs::CollisionObject object = scene.world.collision_objects[i];
+    object.header.stamp = ros::Time();
+    object.header.seq = 0;
+
+    if (object.operation == moveit_msgs::CollisionObject::REMOVE)
+    {
+      if (object.id.empty())
+        object_hashes_.clear();
+      else
+        object_hashes_.erase(object.id);
+      continue;
+    }
+
+    uint32_t length = ros::serialization::serializationLength(object);
+    std::vector<uint8_t> buffer(length);
+    ros::serialization::OStream stream(buffer.data(), length);
+    ros::serialization::serialize(stream, object);
+
+    // Appended and moved objects extend their previous hash
+    uint64_t seed = 14695981039346656037ULL;
+    if (object.operation != moveit_msgs::CollisionObject::ADD && object_hashes_.count(object.id))
+      seed = object_hashes_[object.id];
+    object_hashes_[object.id] = fnv1aHash(buffer.data(), buffer.size(), seed);
+  }
+
+  // Order independent combination of all objects
+  fingerprint_ = 0;
+  for (auto it = object_hashes_.begin(); it != object_hashes_.end(); ++it)
+    fingerprint_ += fnv1aHash(reinterpret_cast<const uint8_t*>(it->first.data()), it->first.size(), it->second);
+}
+
+//-----------------------------------------------------------------------------------------
+// TrajectoryCache
+//-----------------------------------------------------------------------------------------
+
+TrajectoryCache::TrajectoryCache(std::size_t capacity, double joint_resolution, double position_resolution,
+                                 double orientation_resolution)
+  : capacity_(capacity)
+  , joint_resolution_(joint_resolution)
+  , position_resolution_(position_resolution)
+  , orientation_resolution_(orientation_resolution)
+  , hits_(0)
+  , misses_(0)
+{
+}
+
+TrajectoryCache::~TrajectoryCache()
+{
+}
+
+std::string TrajectoryCache::jointGoalKey(const std::vector<double>& start, const std::vector<double>& goal,
+                                          uint64_t scene_fingerprint) const
+{
+  std::string key(1, 'J');
+  key.append(reinterpret_cast<const char*>(&scene_fingerprint), sizeof(scene_fingerprint));
+  for (std::size_t i = 0; i < start.size(); i++)
+    appendQuantized(key, start[i], joint_resolution_);
+  for (std::size_t i = 0; i < goal.size(); i++)
+    appendQuantized(key, goal[i], joint_resolution_);
+  return key;
+}
+
+std::string TrajectoryCache::poseGoalKey(const std::vector<double>& start, const geometry_msgs::Pose& goal,
+                                         uint64_t scene_fingerprint) const
+{
+  // q and -q describe the same orientation, keep w non-negative
+  double sign = goal.orientation.w < 0 ? -1 : 1;
+
+  std::string key(1, 'P');
+  key.append(reinterpret_cast<const char*>(&scene_fingerprint), sizeof(scene_fingerprint));
+  for (std::size_t i = 0; i < start.size(); i++)
+    appendQuantized(key, start[i], joint_resolution_);
+  appendQuantized(key, goal.position.x, position_resolution_);
+  appendQuantized(key, goal.position.y, position_resolution_);
+  appendQuantized(key, goal.position.z, position_resolution_);
+  appendQuantized(key, sign * goal.orientation.x, orientation_resolution_);
+  appendQuantized(key, sign * goal.orientation.y, orientation_resolution_);
+  appendQuantized(key, sign * goal.orientation.z, orientation_resolution_);
+  appendQuantized(key, sign * goal.orientation.w, orientation_resolution_);
+  return key;
+}
+
+bool TrajectoryCache::get(const std::string& key, moveit_msgs::RobotTrajectory& trajectory)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = index_.find(key);
+  if (it == index_.end())
+  {
+    misses_++;
+    return false;
+  }
+
+  // Move entry to front of LRU list
+  entries_.splice(entries_.begin(), entries_, it->second);
+  trajectory = it->second->second;
+  hits_++;
+  return true;
+}
+
+void TrajectoryCache::put(const std::string& key, const moveit_msgs::RobotTrajectory& trajectory)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  insert(key, trajectory);
+}
+
+bool TrajectoryCache::load(const std::string& filepath)
+{
+  std::ifstream file(filepath.c_str(), std::ios::binary);
+  if (!file)
+    return false;
+
+  char magic[4];
+  uint32_t version, count;
+  if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, CACHE_FILE_MAGIC) ||
+      !readValue(file, version) || version != CACHE_FILE_VERSION || !readValue(file, count))
+  {
+    ROS_ERROR("Trajectory cache: %s is not a valid cache file", filepath.c_str());
+    return false;
+  }
+
+  // Entries are stored from least to most recently used, each followed by a checksum
+  // of key and message. Loading stops at the first damaged entry
+  std::vector<Entry> entries;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t key_length, msg_length;
+    uint64_t checksum;
+    if (!readValue(file, key_length) || key_length > MAX_KEY_LENGTH)
+      break;
+    std::string key(key_length, '\0');
+    if (!file.read(&key[0], key_length) || !readValue(file, msg_length) || msg_length > MAX_MESSAGE_LENGTH)
+      break;
+    std::vector<uint8_t> buffer(msg_length);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), msg_length) || !readValue(file, checksum))
+      break;
+
+    uint64_t hash = fnv1aHash(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    if (fnv1aHash(buffer.data(), buffer.size(), hash) != checksum)
+      break;
+
+    moveit_msgs::RobotTrajectory trajectory;
+    try
+    {
+      ros::serialization::IStream stream(buffer.data(), msg_length);
+      ros::serialization::deserialize(stream, trajectory);
+    }
+    catch (const ros::Exception&)
+    {
+      break;
+    }
+    entries.push_back(Entry(key, trajectory));
+  }
+
+  if (entries.size() < count)
+    ROS_WARN("Trajectory cache: %s is damaged, only %zu of %u trajectories loaded", filepath.c_str(), entries.size(),
+             count);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < entries.size(); i++)
+    insert(entries[i].first, entries[i].second);
+
+  ROS_INFO("Trajectory cache: %zu trajectories loaded from %s", entries_.size(), filepath.c_str());
+  return true;
+}
+
+bool TrajectoryCache::save(const std::string& filepath)
+{
+  std::ofstream file(filepath.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file)
+  {
+    ROS_ERROR("Trajectory cache: Not able to write %s", filepath.c_str());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  file.write(CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+  writeValue(file, CACHE_FILE_VERSION);
+  writeValue(file, static_cast<uint32_t>(entries_.size()));
+
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+  {
+    uint32_t msg_length = ros::serialization::serializationLength(it->second);
+    std::vector<uint8_t> buffer(msg_length);
+    ros::serialization::OStream stream(buffer.data(), msg_length);
+    ros::serialization::serialize(stream, it->second);
+
+    writeValue(file, static_cast<uint32_t>(it->first.size()));
+    file.write(it->first.data(), it->first.size());
+    writeValue(file, msg_length);
+    file.write(reinterpret_cast<const char*>(buffer.data()), msg_length);
+
+    uint64_t hash = fnv1aHash(reinterpret_cast<const uint8_t*>(it->first.data()), it->first.size());
+    writeValue(file, fnv1aHash(buffer.data(), buffer.size(), hash));
+  }
+
+  return static_cast<bool>(file);
+}
+
+void TrajectoryCache::appendQuantized(std::string& key, double value, double resolution) const
+{
+  int64_t quantized = static_cast<int64_t>(std::llround(value / resolution));
+  key.append(reinterpret_cast<const char*>(&quantized), sizeof(quantized));
+}
+
+void TrajectoryCache::insert(const std::string& key, const moveit_msgs::RobotTrajectory& trajectory)
+{
+  if (capacity_ == 0)
+    return;
+
+  auto it = index_.find(key);
+  if (it != index_.end())
+  {
+    it->second->second = trajectory;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+
+  entries_.push_front(Entry(key, trajectory));
+  index_[key] = entries_.begin();
+
+  // Drop least recently used entry
+  if (entries_.size() > capacity_)
+  {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,204 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/trajectory_processor.h"
+
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+#include <algorithm>
+#include <cmath>
+
+TrajectoryProcessor::TrajectoryProcessor(const robot_model::RobotModelConstPtr& robot_model,
+                                         const std::string& group_name, double tolerance,
+                                         double collision_resolution)
+  : robot_model_(robot_model)
+  , group_name_(group_name)
+  , tolerance_(tolerance)
+  , collision_resolution_(collision_resolution)
+  , input_points_(0)
+  , output_points_(0)
+{
+  joint_model_group_ = robot_model_->getJointModelGroup(group_name);
+}
+
+void TrajectoryProcessor::process(moveit_msgs::RobotTrajectory& trajectory,
+                                  const planning_scene::PlanningSceneConstPtr& scene)
+{
+  std::size_t size = trajectory.joint_trajectory.points.size();
+  input_points_ += size;
+  if (size < 3 || !scene)
+  {
+    output_points_ += size;
+    return;
+  }
+
+  // Joint order of the group, message may come from move_group with different order
+  robot_state::RobotState reference_state(robot_model_);
+  reference_state.setToDefaultValues();
+  robot_trajectory::RobotTrajectory robot_trajectory(robot_model_, group_name_);
+  robot_trajectory.setRobotTrajectoryMsg(reference_state, trajectory);
+
+  JointPath path(robot_trajectory.getWayPointCount());
+  for (std::size_t i = 0; i < path.size(); i++)
+    robot_trajectory.getWayPoint(i).copyJointGroupPositions(joint_model_group_, path[i]);
+
+  //---------------------------------------------------
+  // Drop nearly collinear waypoints
+  //---------------------------------------------------
+  std::vector<bool> keep(path.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+  simplify(path, 0, path.size() - 1, keep);
+
+  // Segments of the planned path are valid, new ones have to be checked
+  std::size_t previous = 0;
+  for (std::size_t i = 1; i < path.size(); i++)
+  {
+    if (!keep[i])
+      continue;
+
+    if (i > previous + 1 && !segmentValid(path[previous], path[i], *scene))
+      std::fill(keep.begin() + previous + 1, keep.begin() + i, true);
+    previous = i;
+  }
+
+  JointPath simplified;
+  simplified.reserve(path.size());
+  for (std::size_t i = 0; i < path.size(); i++)
+    if (keep[i])
+      simplified.push_back(std::move(path[i]));
+
+  //---------------------------------------------------
+  // Shortcut remaining path
+  //---------------------------------------------------
+  shortcut(simplified, *scene);
+
+  //---------------------------------------------------
+  // Time parameterization of the new path
+  //---------------------------------------------------
+  robot_trajectory.clear();
+  for (std::size_t i = 0; i < simplified.size(); i++)
+  {
+    robot_state::RobotStatePtr state(new robot_state::RobotState(reference_state));
+    state->setJointGroupPositions(joint_model_group_, simplified[i]);
+    state->update();
+    robot_trajectory.addSuffixWayPoint(state, 0.0);
+  }
+
+  trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+  time_parameterization.computeTimeStamps(robot_trajectory);
+
+  trajectory = moveit_msgs::RobotTrajectory();
+  robot_trajectory.getRobotTrajectoryMsg(trajectory);
+  output_points_ += trajectory.joint_trajectory.points.size();
+}
+
+void TrajectoryProcessor::simplify(const JointPath& path, std::size_t first, std::size_t last,
+                                   std::vector<bool>& keep) const
+{
+  // Douglas-Peucker in joint space, the farthest waypoint splits the segment
+  if (last <= first + 1)
+    return;
+
+  const std::vector<double>& a = path[first];
+  const std::vector<double>& b = path[last];
+
+  double segment_length = 0;
+  for (std::size_t j = 0; j < a.size(); j++)
+    segment_length += (b[j] - a[j]) * (b[j] - a[j]);
+
+  double max_distance = 0;
+  std::size_t farthest = first;
+  for (std::size_t i = first + 1; i < last; i++)
+  {
+    const std::vector<double>& p = path[i];
+
+    double t = 0;
+    if (segment_length > 0)
+    {
+      for (std::size_t j = 0; j < a.size(); j++)
+        t += (p[j] - a[j]) * (b[j] - a[j]);
+      t = std::max(0.0, std::min(1.0, t / segment_length));
+    }
+
+    double distance = 0;
+    for (std::size_t j = 0; j < a.size(); j++)
+      distance += pow(p[j] - (a[j] + t * (b[j] - a[j])), 2);
+    distance = sqrt(distance);
+
+    if (distance > max_distance)
+    {
+      max_distance = distance;
+      farthest = i;
+    }
+  }
+
+  if (max_distance <= tolerance_)
+    return;
+
+  keep[farthest] = true;
+  simplify(path, first, farthest, keep);
+  simplify(path, farthest, last, keep);
+}
+
+void TrajectoryProcessor::shortcut(JointPath& path, const planning_scene::PlanningScene& scene) const
+{
+  // Greedy, connect every kept waypoint to the farthest one reachable by a straight segment.
+  // Segments between neighbours are already valid
+  JointPath shortened;
+  shortened.reserve(path.size());
+  shortened.push_back(path.front());
+
+  std::size_t i = 0;
+  while (i + 1 < path.size())
+  {
+    std::size_t j = path.size() - 1;
+    while (j > i + 1 && !segmentValid(path[i], path[j], scene))
+      j--;
+
+    shortened.push_back(path[j]);
+    i = j;
+  }
+
+  path.swap(shortened);
+}
+
+bool TrajectoryProcessor::segmentValid(const std::vector<double>& from, const std::vector<double>& to,
+                                       const planning_scene::PlanningScene& scene) const
+{
+  double max_delta = 0;
+  for (std::size_t j = 0; j < from.size(); j++)
+    max_delta = std::max(max_delta, fabs(to[j] - from[j]));
+
+  // End points are valid waypoints of the planned path
+  int steps = static_cast<int>(std::ceil(max_delta / collision_resolution_));
+  robot_state::RobotState state(scene.getCurrentState());
+  std::vector<double> joints(from.size());
+  for (int k = 1; k < steps; k++)
+  {
+    double t = static_cast<double>(k) / steps;
+    for (std::size_t j = 0; j < from.size(); j++)
+      joints[j] = from[j] + t * (to[j] - from[j]);
+
+    state.setJointGroupPositions(joint_model_group_, joints);
+    state.update();
+    if (scene.isStateColliding(state, group_name_))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,126 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include "binpicking_emulator/trajectory_visualizer.h"
+
+TrajectoryVisualizer::TrajectoryVisualizer(ros::NodeHandle* nh, const robot_model::RobotModelConstPtr& robot_model,
+                                           std::size_t queue_size, double max_rate)
+  : kinematic_state_(robot_model), queue_size_(std::max<std::size_t>(queue_size, 1)), running_(true)
+{
+  trajectory_pub_ = nh->advertise<visualization_msgs::MarkerArray>("trajectory", 1);
+
+  // Zero rate disables rate limiting
+  min_period_ = std::chrono::steady_clock::duration::zero();
+  if (max_rate > 0)
+    min_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / max_rate));
+
+  thread_ = std::thread(&TrajectoryVisualizer::run, this);
+}
+
+TrajectoryVisualizer::~TrajectoryVisualizer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+void TrajectoryVisualizer::visualize(int vision_system_id,
+                                     const std::vector<trajectory_msgs::JointTrajectory>& segments)
+{
+  Request request;
+  request.vision_system_id = vision_system_id;
+  request.segments = segments;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= queue_size_)
+      queue_.pop_front();
+    queue_.push_back(request);
+  }
+  condition_.notify_one();
+}
+
+void TrajectoryVisualizer::run()
+{
+  while (true)
+  {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return !queue_.empty() || !running_; });
+      if (!running_)
+        return;
+
+      // Wait for rate limit, requests arriving meanwhile stay queued
+      if (condition_.wait_until(lock, last_publish_ + min_period_, [this]() { return !running_; }))
+        return;
+
+      std::swap(request, queue_.front());
+      queue_.pop_front();
+    }
+
+    publish(request);
+    last_publish_ = std::chrono::steady_clock::now();
+  }
+}
+
+void TrajectoryVisualizer::publish(const Request& request)
+{
+  const std::vector<trajectory_msgs::JointTrajectory>& segments = request.segments;
+
+  visualization_msgs::MarkerArrayPtr marker_array(new visualization_msgs::MarkerArray());
+  marker_array->markers.resize(segments.size());
+
+  ros::Time stamp = ros::Time::now();
+
+  for (std::size_t s = 0; s < segments.size(); s++)
+  {
+    visualization_msgs::Marker& marker = marker_array->markers[s];
+
+    marker.header.frame_id = "/base_link";
+    marker.header.stamp = stamp;
+    marker.ns = "trajectory_" + std::to_string(request.vision_system_id);
+    marker.id = s;
+    marker.type = visualization_msgs::Marker::LINE_STRIP;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.pose.orientation.w = 1.0;
+
+    marker.scale.x = 0.005;
+
+    marker.color.r = 0.9f;
+    marker.color.g = 0.9f;
+    marker.color.b = 0.9f;
+    marker.color.a = 1.0;
+
+    marker.lifetime = ros::Duration(5);
+
+    marker.points.resize(segments[s].points.size());
+    for (std::size_t i = 0; i < segments[s].points.size(); i++)
+    {
+      kinematic_state_.setJointGroupPositions("manipulator", segments[s].points[i].positions);
+      const Eigen::Affine3d& end_effector_state = kinematic_state_.getGlobalLinkTransform("tool0");
+
+      marker.points[i].x = end_effector_state.translation()[0];
+      marker.points[i].y = end_effector_state.translation()[1];
+      marker.points[i].z = end_effector_state.translation()[2];
+    }
+  }
+
+  trajectory_pub_.publish(marker_array);
+}
@@ -0,0 +1,95 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <binpicking_emulator/metrics.h>
+
+TEST(Percentile, NearestRank)
+{
+  std::vector<double> values = { 5, 1, 4, 2, 3 };
+
+  EXPECT_EQ(percentile(values, 0.0), 1.0);
+  EXPECT_EQ(percentile(values, 0.5), 3.0);
+  EXPECT_EQ(percentile(values, 0.9), 5.0);
+  EXPECT_EQ(percentile(values, 1.0), 5.0);
+  EXPECT_EQ(percentile(std::vector<double>(), 0.5), 0.0);
+}
+
+TEST(LatencyHistogram, EmptySummary)
+{
+  LatencyHistogram histogram;
+  LatencySummary summary = histogram.summary();
+
+  EXPECT_EQ(summary.count, 0u);
+  EXPECT_EQ(summary.mean, 0.0);
+  EXPECT_EQ(summary.p50, 0.0);
+  EXPECT_EQ(summary.p99, 0.0);
+  EXPECT_EQ(summary.max, 0.0);
+}
+
+TEST(LatencyHistogram, PercentilesAreBucketUpperBounds)
+{
+  LatencyHistogram histogram;
+  for (int i = 0; i < 90; i++)
+    histogram.record(0.001);
+  for (int i = 0; i < 10; i++)
+    histogram.record(0.1);
+
+  LatencySummary summary = histogram.summary();
+  EXPECT_EQ(summary.count, 100u);
+  EXPECT_NEAR(summary.mean, 0.0109, 1e-9);
+  EXPECT_NEAR(summary.max, 0.1, 1e-9);
+
+  // 1 ms falls into bucket below 1024 us, 100 ms bucket bound is capped by the maximum
+  EXPECT_NEAR(summary.p50, 1.024e-3, 1e-12);
+  EXPECT_NEAR(summary.p90, 0.1, 1e-9);
+  EXPECT_NEAR(summary.p99, 0.1, 1e-9);
+}
+
+TEST(LatencyHistogram, PercentilesAreOrdered)
+{
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 1000; i++)
+    histogram.record(i * 1e-5);
+
+  LatencySummary summary = histogram.summary();
+  EXPECT_EQ(summary.count, 1000u);
+  EXPECT_LE(summary.p50, summary.p90);
+  EXPECT_LE(summary.p90, summary.p99);
+  EXPECT_LE(summary.p99, summary.max);
+
+  // Upper bounds never underestimate the exact percentile
+  EXPECT_GE(summary.p50, 0.005);
+  EXPECT_GE(summary.p90, 0.009);
+}
+
+TEST(LatencyHistogram, NegativeAndHugeDurations)
+{
+  LatencyHistogram histogram;
+  histogram.record(-1.0);
+  histogram.record(1e6);
+
+  LatencySummary summary = histogram.summary();
+  EXPECT_EQ(summary.count, 2u);
+  EXPECT_NEAR(summary.p50, 1e6, 1e-3);
+  EXPECT_NEAR(summary.max, 1e6, 1e-3);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,162 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <binpicking_emulator/service_log.h>
+#include <pho_robot_loader/constants.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+class ServiceLogTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    filepath_ = "/tmp/test_service_log_" + std::to_string(getpid()) + ".bin";
+  }
+
+  virtual void TearDown()
+  {
+    remove(filepath_.c_str());
+  }
+
+  static ServiceRecord record(RECORDED_SERVICE::Service service, uint32_t vision_system_id, int64_t stamp,
+                              std::size_t request_size, std::size_t response_size)
+  {
+    ServiceRecord record;
+    record.service = service;
+    record.success = stamp % 2 == 0;
+    record.vision_system_id = vision_system_id;
+    record.stamp = stamp;
+    record.duration = 1000 + stamp;
+    for (std::size_t i = 0; i < request_size; i++)
+      record.request.push_back(static_cast<uint8_t>(i));
+    for (std::size_t i = 0; i < response_size; i++)
+      record.response.push_back(static_cast<uint8_t>(255 - i));
+    return record;
+  }
+
+  static void expectEqual(const ServiceRecord& a, const ServiceRecord& b)
+  {
+    EXPECT_EQ(a.service, b.service);
+    EXPECT_EQ(a.success, b.success);
+    EXPECT_EQ(a.vision_system_id, b.vision_system_id);
+    EXPECT_EQ(a.stamp, b.stamp);
+    EXPECT_EQ(a.duration, b.duration);
+    EXPECT_EQ(a.request, b.request);
+    EXPECT_EQ(a.response, b.response);
+  }
+
+  std::size_t fileSize()
+  {
+    std::ifstream file(filepath_.c_str(), std::ios::binary | std::ios::ate);
+    return file.tellg();
+  }
+
+  std::string filepath_;
+};
+}  // namespace
+
+TEST_F(ServiceLogTest, RecordsRoundTrip)
+{
+  std::vector<ServiceRecord> records;
+  records.push_back(record(RECORDED_SERVICE::INITIALIZE, 1, 0, 10, 3));
+  records.push_back(record(RECORDED_SERVICE::SCAN, 2, 5, 0, 0));
+  records.push_back(record(RECORDED_SERVICE::TRAJECTORY, 1, 8, 200, 4000));
+
+  {
+    ServiceLogWriter writer;
+    ASSERT_TRUE(writer.open(filepath_));
+    for (std::size_t i = 0; i < records.size(); i++)
+      writer.write(records[i]);
+  }
+
+  ServiceLogReader reader;
+  ASSERT_TRUE(reader.open(filepath_));
+
+  ServiceRecord read;
+  for (std::size_t i = 0; i < records.size(); i++)
+  {
+    ASSERT_TRUE(reader.next(read));
+    expectEqual(read, records[i]);
+  }
+  EXPECT_FALSE(reader.next(read));
+}
+
+TEST_F(ServiceLogTest, TruncatedLastRecordIsIgnored)
+{
+  ServiceRecord first = record(RECORDED_SERVICE::PICK_FAILED, 3, 2, 16, 16);
+  {
+    ServiceLogWriter writer;
+    ASSERT_TRUE(writer.open(filepath_));
+    writer.write(first);
+    writer.write(record(RECORDED_SERVICE::CHANGE_SOLUTION, 3, 4, 16, 16));
+  }
+  ASSERT_EQ(truncate(filepath_.c_str(), fileSize() - 1), 0);
+
+  ServiceLogReader reader;
+  ASSERT_TRUE(reader.open(filepath_));
+
+  ServiceRecord read;
+  ASSERT_TRUE(reader.next(read));
+  expectEqual(read, first);
+  EXPECT_FALSE(reader.next(read));
+}
+
+TEST_F(ServiceLogTest, RejectsOtherFiles)
+{
+  ServiceLogReader missing;
+  EXPECT_FALSE(missing.open(filepath_));
+
+  {
+    std::ofstream file(filepath_.c_str(), std::ios::binary);
+    file << "not a service log";
+  }
+  ServiceLogReader reader;
+  EXPECT_FALSE(reader.open(filepath_));
+}
+
+TEST(RecordedService, Names)
+{
+  EXPECT_STREQ(RECORDED_SERVICE::name(RECORDED_SERVICE::TRAJECTORY), "trajectory");
+  EXPECT_STREQ(RECORDED_SERVICE::name(RECORDED_SERVICE::COUNT), "unknown");
+}
+
+TEST(RecordedService, TrajectoryFailsWithErrorOperation)
+{
+  photoneo_msgs::operations::Response res;
+  res.operations.resize(3);
+  for (std::size_t i = 0; i < res.operations.size(); i++)
+    res.operations[i].operation_type = pho_robot_loader::OPERATION::TYPE::TRAJECTORY_CNT;
+  EXPECT_TRUE(RECORDED_SERVICE::succeeded(res));
+
+  res.operations[1].operation_type = pho_robot_loader::OPERATION::TYPE::ERROR;
+  EXPECT_FALSE(RECORDED_SERVICE::succeeded(res));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,12 +18,18 @@ limitations under the License.
 #define COLLISION_OBJECT_PUBLISHER_H
 
 #include <ros/ros.h>
+#include <std_srvs/Trigger.h>
 #include <moveit_msgs/CollisionObject.h>
 #include <moveit_msgs/PlanningScene.h>
 #include <geometric_shapes/shape_operations.h>
+#include <binpicking_simple_utils/mesh_simplification.h>
 #include <tf/tf.h>
 #include <yaml-cpp/yaml.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 struct CollisionObject
 {
   std::string label;
@@ -39,18 +45,61 @@ struct CollisionObject
   double z_scale;
 };
 
+// Mesh converted for planning, box-like meshes are replaced by a box primitive
+struct CollisionShape
+{
+  bool is_box;
+  shape_msgs::SolidPrimitive box;
+  geometry_msgs::Point box_center;
+  shape_msgs::Mesh mesh;
+};
+
+// Publishes collision objects as planning scene diffs. Meshes are converted
+// once, afterwards only objects changed in the yaml file are sent again.
 class CollisionObjectPublisher
 {
 public:
-  CollisionObjectPublisher(ros::NodeHandle* nh, std::string co_list_filepath);
+  // Private params are read from pnh, nodelets pass their private node handle
+  CollisionObjectPublisher(ros::NodeHandle* nh, std::string co_list_filepath,
+                           ros::NodeHandle pnh = ros::NodeHandle("~"));
   ~CollisionObjectPublisher();
   void publishAllCollisionObjects();
-  void publishSingleCollisionObject(CollisionObject single_object);
+  void publishChangedCollisionObjects();
+
+  uint32_t subscribers() const
+  {
+    return pub.getNumSubscribers();
+  }
 
 private:
+  void publishCollisionObjects(bool all);
+  bool loadCollisionObjects(std::vector<CollisionObject>& objects);
+  bool composeCollisionObject(const CollisionObject& single_object, moveit_msgs::CollisionObject& collision_object,
+                              bool move);
+  const CollisionShape* collisionShape(const CollisionObject& single_object);
+  bool convertShape(const CollisionObject& single_object, CollisionShape& shape);
+  bool republishCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+  void watchCallback(const ros::TimerEvent& event);
+
+  std::string filepath;
+
+  // Last published objects, key is the object label
+  std::map<std::string, CollisionObject> published_objects;
+
+  // Converted shapes, key is the model filepath with scale
+  std::map<std::string, CollisionShape> converted_shapes;
+
+  // Shape preprocessing, results are cached on disk when directory is set
+  bool fit_primitives;
+  int max_triangles;
+  std::string shape_cache_directory;
 
-  std::vector<CollisionObject> collision_objects;
   ros::Publisher pub;
+  ros::ServiceServer republish_service;
+
+  // inotify watch of the yaml file directory, editors often replace the file
+  int inotify_fd;
+  ros::Timer watch_timer;
 };
 
 #endif // COLLISION_OBJECT_PUBLISHER_H
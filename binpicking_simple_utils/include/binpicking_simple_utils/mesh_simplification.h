@@ -0,0 +1,38 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#ifndef MESH_SIMPLIFICATION_H
+#define MESH_SIMPLIFICATION_H
+
+#include <geometry_msgs/Point.h>
+#include <shape_msgs/Mesh.h>
+#include <shape_msgs/SolidPrimitive.h>
+
+#include <cstddef>
+
+// Box fitted to the mesh, vertices of box-like meshes lie in the corners of
+// their bounding box and the triangles cover exactly its surface. Center is
+// the offset of the box in the mesh frame.
+bool fitBox(const shape_msgs::Mesh& mesh, shape_msgs::SolidPrimitive& box, geometry_msgs::Point& center);
+
+// Vertex clustering on a grid coarsened until the mesh fits the triangle budget.
+// Result is inflated by the cell diagonal, which keeps convex and smoothly curved
+// surfaces enclosed. Near spikes and folds sharper than about 75 degrees between
+// vertex and face normals the offset is capped and parts of the original surface
+// may stick out. Triangles have to be ordered counter-clockwise seen from outside
+void decimateMesh(shape_msgs::Mesh& mesh, std::size_t max_triangles);
+
+#endif // MESH_SIMPLIFICATION_H
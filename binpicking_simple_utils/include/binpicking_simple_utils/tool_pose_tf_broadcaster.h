@@ -19,20 +19,51 @@ limitations under the License.
 
 #include <ros/ros.h>
 #include <geometry_msgs/Pose.h>
-#include <tf/transform_broadcaster.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <tf2_msgs/TFMessage.h>
+#include <tf2_ros/static_transform_broadcaster.h>
 
+#include <mutex>
+#include <string>
+
+// Broadcasts tool pose streamed by the robot controller as TF. Poses are
+// stamped with source time when received as PoseStamped. With non zero
+// publish rate all poses received during one tick are sent in a single
+// TFMessage, in static mode the pose is latched on /tf_static and sent
+// again only when it moves by more than the static tolerances.
 class Broadcaster
 {
 public:
-  Broadcaster();
+  // Subscribes tool pose topics, private params are read from pnh
+  Broadcaster(ros::NodeHandle* nh, ros::NodeHandle pnh = ros::NodeHandle("~"));
   ~Broadcaster();
   void poseCallback(const geometry_msgs::PoseConstPtr& msg);
+  void poseStampedCallback(const geometry_msgs::PoseStampedConstPtr& msg);
 
 private:
-  tf::TransformBroadcaster br;
-  tf::Transform transform;
-  tf::Vector3 origin;
-  tf::Quaternion orientation;  
+  void addTransform(const geometry_msgs::Pose& pose, const ros::Time& stamp, const std::string& frame_id);
+  void publishCallback(const ros::WallTimerEvent& event);
+  bool staticTransformChanged(const geometry_msgs::TransformStamped& transform) const;
+
+  std::string parent_frame;
+  std::string child_frame;
+  bool static_mode;
+  double static_translation_tolerance;
+  double static_rotation_tolerance;
+  std::size_t max_batch_size;
+
+  ros::Subscriber sub;
+  ros::Subscriber stamped_sub;
+  ros::Publisher tf_pub;
+  tf2_ros::StaticTransformBroadcaster static_br;
+  ros::WallTimer publish_timer;
+
+  // Poses received since last tick, last static transform
+  std::mutex mutex;
+  tf2_msgs::TFMessage batch;
+  geometry_msgs::TransformStamped static_transform;
+  bool static_sent;
 };
 
-#endif // TOOL_POSE_TF_BROADCASTER_H
\ No newline at end of file
+#endif // TOOL_POSE_TF_BROADCASTER_H
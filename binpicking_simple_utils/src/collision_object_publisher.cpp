@@ -16,11 +16,141 @@ limitations under the License.
 
 #include <binpicking_simple_utils/collision_object_publisher.h>
 
-CollisionObjectPublisher::CollisionObjectPublisher(ros::NodeHandle *nh, std::string collision_object_list_filepath)
+#include <resource_retriever/retriever.h>
+#include <ros/serialization.h>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static bool sameShape(const CollisionObject& a, const CollisionObject& b)
+{
+  return a.model_filepath == b.model_filepath && a.x_scale == b.x_scale && a.y_scale == b.y_scale &&
+         a.z_scale == b.z_scale;
+}
+
+static bool samePose(const CollisionObject& a, const CollisionObject& b)
+{
+  return a.x_position == b.x_position && a.y_position == b.y_position && a.z_position == b.z_position &&
+         a.roll == b.roll && a.pitch == b.pitch && a.yaw == b.yaw;
+}
+
+// FNV-1a, names disk cache entries after content of the model file
+static uint64_t hashBytes(const uint8_t* data, std::size_t size, uint64_t hash = 14695981039346656037ULL)
 {
+  for (std::size_t i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  return hash;
+}
+
+static bool readShapeCache(const std::string& filepath, CollisionShape& shape)
+{
+  std::ifstream file(filepath.c_str(), std::ios::binary);
+  if (!file)
+    return false;
+
+  std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (buffer.empty())
+    return false;
+
   try
   {
-    YAML::Node config = YAML::LoadFile(collision_object_list_filepath);
+    shape.is_box = buffer[0] != 0;
+    ros::serialization::IStream stream(buffer.data() + 1, buffer.size() - 1);
+    ros::serialization::deserialize(stream, shape.box);
+    ros::serialization::deserialize(stream, shape.box_center);
+    ros::serialization::deserialize(stream, shape.mesh);
+  }
+  catch(ros::serialization::StreamOverrunException &e)
+  {
+    return false;
+  }
+  return true;
+}
+
+static void writeShapeCache(const std::string& filepath, const CollisionShape& shape)
+{
+  std::vector<uint8_t> buffer(1 + ros::serialization::serializationLength(shape.box) +
+                              ros::serialization::serializationLength(shape.box_center) +
+                              ros::serialization::serializationLength(shape.mesh));
+  buffer[0] = shape.is_box;
+  ros::serialization::OStream stream(buffer.data() + 1, buffer.size() - 1);
+  ros::serialization::serialize(stream, shape.box);
+  ros::serialization::serialize(stream, shape.box_center);
+  ros::serialization::serialize(stream, shape.mesh);
+
+  // Concurrent nodes never read a partially written entry
+  std::string temporary = filepath + ".tmp";
+  {
+    std::ofstream file(temporary.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!file.good())
+      return;
+  }
+  rename(temporary.c_str(), filepath.c_str());
+}
+
+static geometry_msgs::Pose objectPose(const CollisionObject& single_object)
+{
+  geometry_msgs::Pose pose;
+  pose.position.x = single_object.x_position;
+  pose.position.y = single_object.y_position;
+  pose.position.z = single_object.z_position;
+
+  tf::Quaternion quaternion;
+  quaternion.setRPY(single_object.roll, single_object.pitch, single_object.yaw);
+
+  pose.orientation.w = quaternion.getW();
+  pose.orientation.x = quaternion.getX();
+  pose.orientation.y = quaternion.getY();
+  pose.orientation.z = quaternion.getZ();
+  return pose;
+}
+
+CollisionObjectPublisher::CollisionObjectPublisher(ros::NodeHandle *nh, std::string collision_object_list_filepath,
+                                                   ros::NodeHandle pnh)
+  : filepath(collision_object_list_filepath), inotify_fd(-1)
+{
+  // Shape preprocessing, zero triangle budget keeps meshes as they are
+  pnh.param<bool>("fit_primitives", fit_primitives, true);
+  pnh.param<int>("max_triangles", max_triangles, 2000);
+  pnh.param<std::string>("shape_cache_directory", shape_cache_directory, "");
+
+  if (!shape_cache_directory.empty())
+    mkdir(shape_cache_directory.c_str(), 0755);
+
+  // Initialize ros::Publisher, move_group applies diffs received on planning_scene topic
+  pub = nh->advertise<moveit_msgs::PlanningScene>("planning_scene", 1);
+  republish_service = nh->advertiseService("collision_object_publisher/republish",
+                                           &CollisionObjectPublisher::republishCallback, this);
+
+  // Watch directory of the yaml file for changes
+  std::size_t separator = filepath.find_last_of('/');
+  std::string directory = (separator == std::string::npos) ? "." : filepath.substr(0, separator);
+
+  inotify_fd = inotify_init1(IN_NONBLOCK);
+  if (inotify_fd < 0 || inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    ROS_WARN("Not able to watch %s for changes, use republish service instead", filepath.c_str());
+  else
+    watch_timer = nh->createTimer(ros::Duration(0.5), &CollisionObjectPublisher::watchCallback, this);
+}
+
+
+CollisionObjectPublisher::~CollisionObjectPublisher()
+{
+  if (inotify_fd >= 0)
+    close(inotify_fd);
+}
+
+bool CollisionObjectPublisher::loadCollisionObjects(std::vector<CollisionObject>& objects)
+{
+  try
+  {
+    YAML::Node config = YAML::LoadFile(filepath);
 
     // Parse single collision object data one by one
     for(std::size_t i = 0; i < config.size(); i++)
@@ -40,100 +170,241 @@ CollisionObjectPublisher::CollisionObjectPublisher(ros::NodeHandle *nh, std::str
       single_object.y_scale          = config[i]["y_scale"].as<double>();
       single_object.z_scale          = config[i]["z_scale"].as<double>();
 
-      collision_objects.push_back(single_object);
+      objects.push_back(single_object);
     }
   }
-  catch(YAML::ParserException &e)
+  catch(YAML::Exception &e)
   {
-    ROS_ERROR("Error reading yaml config file! Check list of collision objects file");
-    ros::shutdown();
+    ROS_ERROR("Error reading yaml config file! Check list of collision objects file: %s", e.what());
+    return false;
   }
+  return true;
+}
 
-  // Initialize ros::Publisher
-  pub = nh->advertise<moveit_msgs::CollisionObject>("collision_object", 1);
-  
+void CollisionObjectPublisher::publishAllCollisionObjects()
+{
+  publishCollisionObjects(true);
 }
 
+void CollisionObjectPublisher::publishChangedCollisionObjects()
+{
+  publishCollisionObjects(false);
+}
 
-CollisionObjectPublisher::~CollisionObjectPublisher()
+void CollisionObjectPublisher::publishCollisionObjects(bool all)
 {
+  // Invalid file, e.g. saved in the middle of editing, keeps the scene as is
+  std::vector<CollisionObject> objects;
+  if (!loadCollisionObjects(objects))
+    return;
 
-}
+  // Published as shared pointer, passed without copy to subscribers in the same nodelet manager
+  moveit_msgs::PlanningScenePtr scene(new moveit_msgs::PlanningScene());
+  scene->is_diff = true;
+
+  std::map<std::string, CollisionObject> current_objects;
+  for(std::size_t i = 0; i < objects.size(); i++)
+  {
+    const CollisionObject& single_object = objects[i];
+    current_objects[single_object.label] = single_object;
 
+    ROS_DEBUG_STREAM("[Label          ]: " << single_object.label);
+    ROS_DEBUG_STREAM("[Model filepath ]: " << single_object.model_filepath);
 
-void CollisionObjectPublisher::publishAllCollisionObjects()
-{
-  for(int i = 0; i < collision_objects.size(); i++)
+    std::map<std::string, CollisionObject>::const_iterator published = published_objects.find(single_object.label);
+    bool known = !all && published != published_objects.end();
+    if (known && sameShape(published->second, single_object) && samePose(published->second, single_object))
+      continue;
+
+    // Only pose changed, shape is not sent again
+    moveit_msgs::CollisionObject collision_object;
+    bool move = known && sameShape(published->second, single_object);
+    if (!composeCollisionObject(single_object, collision_object, move))
+    {
+      current_objects.erase(single_object.label);
+      continue;
+    }
+
+    scene->world.collision_objects.push_back(collision_object);
+  }
+
+  // Objects removed from the file
+  for(std::map<std::string, CollisionObject>::const_iterator it = published_objects.begin();
+      it != published_objects.end(); ++it)
   {
-    ROS_DEBUG_STREAM("[Label          ]: " << collision_objects[i].label);
-    ROS_DEBUG_STREAM("[Model filepath ]: " << collision_objects[i].model_filepath);
-    ROS_DEBUG_STREAM("[X position     ]: " << collision_objects[i].x_position );
-    ROS_DEBUG_STREAM("[Y position     ]: " << collision_objects[i].y_position );
-    ROS_DEBUG_STREAM("[Z position     ]: " << collision_objects[i].z_position );
-    ROS_DEBUG_STREAM("[ROLL           ]: " << collision_objects[i].roll );
-    ROS_DEBUG_STREAM("[PITCH          ]: " << collision_objects[i].pitch );
-    ROS_DEBUG_STREAM("[YAW            ]: " << collision_objects[i].yaw );
-    ROS_DEBUG_STREAM("[SCALE X        ]: " << collision_objects[i].x_scale );
-    ROS_DEBUG_STREAM("[SCALE Y        ]: " << collision_objects[i].y_scale );
-    ROS_DEBUG_STREAM("[SCALE Z        ]: " << collision_objects[i].z_scale );
+    if (current_objects.count(it->first))
+      continue;
 
-    publishSingleCollisionObject(collision_objects[i]);
+    moveit_msgs::CollisionObject collision_object;
+    collision_object.header.frame_id = "base_link";
+    collision_object.id = it->first;
+    collision_object.operation = collision_object.REMOVE;
+    scene->world.collision_objects.push_back(collision_object);
   }
+
+  published_objects.swap(current_objects);
+  if (scene->world.collision_objects.empty())
+    return;
+
+  pub.publish(scene);
+  ROS_INFO("Published planning scene diff with %zu collision objects", scene->world.collision_objects.size());
 }
 
-void CollisionObjectPublisher::publishSingleCollisionObject(CollisionObject single_object)
+bool CollisionObjectPublisher::composeCollisionObject(const CollisionObject& single_object,
+                                                      moveit_msgs::CollisionObject& collision_object, bool move)
 {
-  moveit_msgs::CollisionObject collision_object;
-  const Eigen::Vector3d mesh_scale(single_object.x_scale, single_object.y_scale, single_object.z_scale);
-  shapes::Mesh* mesh = shapes::createMeshFromResource(single_object.model_filepath, mesh_scale);
+  const CollisionShape* shape = collisionShape(single_object);
+  if (!shape)
+    return false;
 
-  shape_msgs::Mesh collision_object_mesh;
-  shapes::ShapeMsg collision_object_mesh_msg;
-  shapes::constructMsgFromShape(mesh, collision_object_mesh_msg);
-  collision_object_mesh = boost::get<shape_msgs::Mesh>(collision_object_mesh_msg);
-  collision_object.meshes.resize(1);
-  collision_object.mesh_poses.resize(1);
-  collision_object.meshes[0] = collision_object_mesh;
   collision_object.header.frame_id = "base_link";
   collision_object.id = single_object.label;
+  collision_object.operation = move ? collision_object.MOVE : collision_object.ADD;
 
-  collision_object.mesh_poses[0].position.x = single_object.x_position;
-  collision_object.mesh_poses[0].position.y = single_object.y_position;
-  collision_object.mesh_poses[0].position.z = single_object.z_position;
+  geometry_msgs::Pose pose = objectPose(single_object);
+  if (!shape->is_box)
+  {
+    if (!move)
+      collision_object.meshes.push_back(shape->mesh);
+    collision_object.mesh_poses.push_back(pose);
+    return true;
+  }
 
-  tf::Quaternion quaternion;
-  quaternion.setRPY(single_object.roll, single_object.pitch, single_object.yaw);
+  // Box center is offset in the mesh frame
+  tf::Quaternion orientation(pose.orientation.x, pose.orientation.y, pose.orientation.z, pose.orientation.w);
+  tf::Vector3 offset =
+      tf::quatRotate(orientation, tf::Vector3(shape->box_center.x, shape->box_center.y, shape->box_center.z));
+  pose.position.x += offset.x();
+  pose.position.y += offset.y();
+  pose.position.z += offset.z();
+
+  if (!move)
+    collision_object.primitives.push_back(shape->box);
+  collision_object.primitive_poses.push_back(pose);
+  return true;
+}
+
+const CollisionShape* CollisionObjectPublisher::collisionShape(const CollisionObject& single_object)
+{
+  // Convert every mesh with its scale only once
+  std::ostringstream shape_key;
+  shape_key << single_object.model_filepath << " " << single_object.x_scale << " " << single_object.y_scale << " "
+            << single_object.z_scale;
 
-  collision_object.mesh_poses[0].orientation.w= quaternion.getW();
-  collision_object.mesh_poses[0].orientation.x= quaternion.getX();
-  collision_object.mesh_poses[0].orientation.y= quaternion.getY();
-  collision_object.mesh_poses[0].orientation.z= quaternion.getZ();
+  std::map<std::string, CollisionShape>::iterator cached = converted_shapes.find(shape_key.str());
+  if (cached != converted_shapes.end())
+    return &cached->second;
 
-  collision_object.meshes.push_back(collision_object_mesh);
-  collision_object.mesh_poses.push_back(collision_object.mesh_poses[0]);
-  collision_object.operation = collision_object.ADD;
+  CollisionShape shape;
+  if (!convertShape(single_object, shape))
+    return NULL;
 
-  pub.publish(collision_object);
-  ROS_DEBUG_STREAM("Collision object[ " << single_object.label << " ] published");
+  return &converted_shapes.insert(std::make_pair(shape_key.str(), shape)).first->second;
 }
 
-int main(int argc, char** argv)
+bool CollisionObjectPublisher::convertShape(const CollisionObject& single_object, CollisionShape& shape)
 {
-  ros::init(argc, argv, "collision_object_publisher");
-  ros::NodeHandle nh;
+  resource_retriever::MemoryResource resource;
+  try
+  {
+    resource_retriever::Retriever retriever;
+    resource = retriever.get(single_object.model_filepath);
+  }
+  catch(resource_retriever::Exception &e)
+  {
+    ROS_ERROR("Not able to load mesh %s of collision object %s: %s", single_object.model_filepath.c_str(),
+              single_object.label.c_str(), e.what());
+    return false;
+  }
 
-  // Get collision object list filepath
-  std::string collision_objects_list_filepath;
-  nh.getParam("collision_objects_list_filepath", collision_objects_list_filepath);
+  // Disk cache entry depends on file content and all preprocessing settings
+  std::string cache_filepath;
+  if (!shape_cache_directory.empty())
+  {
+    double settings[5] = { single_object.x_scale, single_object.y_scale, single_object.z_scale,
+                           static_cast<double>(fit_primitives), static_cast<double>(max_triangles) };
+    uint64_t hash = hashBytes(resource.data.get(), resource.size);
+    hash = hashBytes(reinterpret_cast<const uint8_t*>(settings), sizeof(settings), hash);
 
-  CollisionObjectPublisher collision_object_publisher(&nh, collision_objects_list_filepath);
-  
-  while(ros::ok())
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016llx.shape", static_cast<unsigned long long>(hash));
+    cache_filepath = shape_cache_directory + "/" + filename;
+
+    if (readShapeCache(cache_filepath, shape))
+      return true;
+  }
+
+  std::size_t extension = single_object.model_filepath.find_last_of('.');
+  std::string assimp_hint =
+      (extension == std::string::npos) ? std::string() : single_object.model_filepath.substr(extension + 1);
+  const Eigen::Vector3d mesh_scale(single_object.x_scale, single_object.y_scale, single_object.z_scale);
+  shapes::Mesh* mesh = shapes::createMeshFromBinary(reinterpret_cast<const char*>(resource.data.get()),
+                                                    resource.size, mesh_scale, assimp_hint);
+  if (!mesh)
+  {
+    ROS_ERROR("Not able to convert mesh %s of collision object %s", single_object.model_filepath.c_str(),
+              single_object.label.c_str());
+    return false;
+  }
+
+  shapes::ShapeMsg collision_object_mesh_msg;
+  shapes::constructMsgFromShape(mesh, collision_object_mesh_msg);
+  delete mesh;
+  shape.mesh = boost::get<shape_msgs::Mesh>(collision_object_mesh_msg);
+
+  // Primitive collision checks are far cheaper than triangle meshes
+  shape.is_box = fit_primitives && fitBox(shape.mesh, shape.box, shape.box_center);
+  if (shape.is_box)
   {
-    collision_object_publisher.publishAllCollisionObjects();
-    ros::Duration(10).sleep();
+    shape.mesh = shape_msgs::Mesh();
+    ROS_INFO("Collision object %s replaced by box primitive", single_object.label.c_str());
   }
+  else
+  {
+    std::size_t triangles = shape.mesh.triangles.size();
+    decimateMesh(shape.mesh, std::max(max_triangles, 0));
+    if (shape.mesh.triangles.size() < triangles)
+      ROS_INFO("Collision object %s decimated from %zu to %zu triangles", single_object.label.c_str(), triangles,
+               shape.mesh.triangles.size());
+  }
+
+  if (!cache_filepath.empty())
+    writeShapeCache(cache_filepath, shape);
+  return true;
+}
 
-  ros::shutdown();
-  return EXIT_SUCCESS;
+bool CollisionObjectPublisher::republishCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+{
+  publishAllCollisionObjects();
+
+  res.success = true;
+  res.message = "Published " + std::to_string(published_objects.size()) + " collision objects";
+  return true;
+}
+
+void CollisionObjectPublisher::watchCallback(const ros::TimerEvent& event)
+{
+  std::size_t separator = filepath.find_last_of('/');
+  std::string filename = (separator == std::string::npos) ? filepath : filepath.substr(separator + 1);
+
+  // Drain all pending events, several writes are handled by one update
+  bool changed = false;
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+  {
+    for (char* ptr = buffer; ptr < buffer + length;)
+    {
+      const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+      if (event->len > 0 && filename == event->name)
+        changed = true;
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  if (changed)
+  {
+    ROS_INFO("Collision objects file changed, publishing updates");
+    publishChangedCollisionObjects();
+  }
 }
@@ -0,0 +1,38 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <binpicking_simple_utils/collision_object_publisher.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "collision_object_publisher");
+  ros::NodeHandle nh;
+
+  // Get collision object list filepath
+  std::string collision_objects_list_filepath;
+  nh.getParam("collision_objects_list_filepath", collision_objects_list_filepath);
+
+  CollisionObjectPublisher collision_object_publisher(&nh, collision_objects_list_filepath);
+
+  // Diffs are not latched, wait for move_group before the initial publish
+  while(ros::ok() && collision_object_publisher.subscribers() == 0)
+    ros::WallDuration(0.5).sleep();
+
+  collision_object_publisher.publishAllCollisionObjects();
+  ros::spin();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <binpicking_simple_utils/mesh_simplification.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+static double coordinate(const geometry_msgs::Point& point, int axis)
+{
+  return axis == 0 ? point.x : (axis == 1 ? point.y : point.z);
+}
+
+static void boundingBox(const shape_msgs::Mesh& mesh, double min[3], double max[3])
+{
+  for (int axis = 0; axis < 3; axis++)
+  {
+    min[axis] = coordinate(mesh.vertices[0], axis);
+    max[axis] = min[axis];
+  }
+
+  for (std::size_t i = 1; i < mesh.vertices.size(); i++)
+    for (int axis = 0; axis < 3; axis++)
+    {
+      min[axis] = std::min(min[axis], coordinate(mesh.vertices[i], axis));
+      max[axis] = std::max(max[axis], coordinate(mesh.vertices[i], axis));
+    }
+}
+
+bool fitBox(const shape_msgs::Mesh& mesh, shape_msgs::SolidPrimitive& box, geometry_msgs::Point& center)
+{
+  if (mesh.vertices.empty() || mesh.triangles.empty())
+    return false;
+
+  double min[3], max[3], size[3];
+  boundingBox(mesh, min, max);
+  for (int axis = 0; axis < 3; axis++)
+    size[axis] = max[axis] - min[axis];
+
+  double tolerance = 1e-3 * std::max(size[0], std::max(size[1], size[2]));
+  if (std::min(size[0], std::min(size[1], size[2])) <= tolerance)
+    return false;
+
+  // Every vertex in a corner of the bounding box
+  for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double value = coordinate(mesh.vertices[i], axis);
+      if (fabs(value - min[axis]) > tolerance && fabs(value - max[axis]) > tolerance)
+        return false;
+    }
+
+  // Triangles cover the box surface, rules out meshes with missing or doubled faces
+  double area = 0;
+  for (std::size_t i = 0; i < mesh.triangles.size(); i++)
+  {
+    const geometry_msgs::Point& a = mesh.vertices[mesh.triangles[i].vertex_indices[0]];
+    const geometry_msgs::Point& b = mesh.vertices[mesh.triangles[i].vertex_indices[1]];
+    const geometry_msgs::Point& c = mesh.vertices[mesh.triangles[i].vertex_indices[2]];
+
+    double u[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+    double v[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+    double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    area += 0.5 * sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+  }
+
+  double box_area = 2 * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+  if (fabs(area - box_area) > 1e-2 * box_area)
+    return false;
+
+  box.type = shape_msgs::SolidPrimitive::BOX;
+  box.dimensions.resize(3);
+  box.dimensions[shape_msgs::SolidPrimitive::BOX_X] = size[0];
+  box.dimensions[shape_msgs::SolidPrimitive::BOX_Y] = size[1];
+  box.dimensions[shape_msgs::SolidPrimitive::BOX_Z] = size[2];
+
+  center.x = (min[0] + max[0]) / 2;
+  center.y = (min[1] + max[1]) / 2;
+  center.z = (min[2] + max[2]) / 2;
+  return true;
+}
+
+// Offsets every vertex along its normal, so that planes of all adjacent triangles
+// move outward by at least distance. Triangles are expected in counter-clockwise order
+static void inflate(std::vector<geometry_msgs::Point>& vertices, const std::vector<shape_msgs::MeshTriangle>& triangles,
+                    double distance)
+{
+  std::vector<std::array<double, 3> > face_normals(triangles.size());
+  std::vector<std::array<double, 3> > vertex_normals(vertices.size(), std::array<double, 3>{ { 0, 0, 0 } });
+  for (std::size_t i = 0; i < triangles.size(); i++)
+  {
+    const geometry_msgs::Point& a = vertices[triangles[i].vertex_indices[0]];
+    const geometry_msgs::Point& b = vertices[triangles[i].vertex_indices[1]];
+    const geometry_msgs::Point& c = vertices[triangles[i].vertex_indices[2]];
+
+    // Cross product length is twice the area, weights vertex normals by area
+    double u[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+    double v[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+    double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    double length = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+      face_normals[i][axis] = length > 0 ? cross[axis] / length : 0;
+      for (int k = 0; k < 3; k++)
+        vertex_normals[triangles[i].vertex_indices[k]][axis] += cross[axis];
+    }
+  }
+
+  for (std::array<double, 3>& normal : vertex_normals)
+  {
+    double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (int axis = 0; axis < 3; axis++)
+      normal[axis] = length > 0 ? normal[axis] / length : 0;
+  }
+
+  // Offset along vertex normal moves a face plane by the cosine of their angle,
+  // the least aligned face decides. Capped at 4x on sharp spikes and folds where it
+  // would diverge or flip, those faces are not guaranteed to move by the full distance
+  std::vector<double> min_cosine(vertices.size(), 1.0);
+  for (std::size_t i = 0; i < triangles.size(); i++)
+    for (int k = 0; k < 3; k++)
+    {
+      uint32_t index = triangles[i].vertex_indices[k];
+      const std::array<double, 3>& n = vertex_normals[index];
+      double cosine = n[0] * face_normals[i][0] + n[1] * face_normals[i][1] + n[2] * face_normals[i][2];
+      min_cosine[index] = std::min(min_cosine[index], cosine);
+    }
+
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    double offset = distance / std::max(min_cosine[i], 0.25);
+    vertices[i].x += offset * vertex_normals[i][0];
+    vertices[i].y += offset * vertex_normals[i][1];
+    vertices[i].z += offset * vertex_normals[i][2];
+  }
+}
+
+void decimateMesh(shape_msgs::Mesh& mesh, std::size_t max_triangles)
+{
+  if (max_triangles == 0 || mesh.triangles.size() <= max_triangles || mesh.vertices.empty())
+    return;
+
+  double min[3], max[3];
+  boundingBox(mesh, min, max);
+  double extent = std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+
+  // Surface of n^3 grid has about 12 n^2 triangles, start finer and coarsen
+  for (double resolution = std::max(1.0, sqrt(static_cast<double>(max_triangles))); ; resolution *= 0.8)
+  {
+    double cell_size = extent / std::max(1.0, std::floor(resolution));
+
+    // Vertices of a cell are merged into their average
+    std::map<std::array<long, 3>, uint32_t> cells;
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    std::vector<geometry_msgs::Point> sums;
+    std::vector<std::size_t> counts;
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+      const geometry_msgs::Point& vertex = mesh.vertices[i];
+      std::array<long, 3> cell = { { static_cast<long>(std::floor((vertex.x - min[0]) / cell_size)),
+                                     static_cast<long>(std::floor((vertex.y - min[1]) / cell_size)),
+                                     static_cast<long>(std::floor((vertex.z - min[2]) / cell_size)) } };
+
+      std::map<std::array<long, 3>, uint32_t>::iterator it = cells.find(cell);
+      if (it == cells.end())
+      {
+        it = cells.insert(std::make_pair(cell, static_cast<uint32_t>(sums.size()))).first;
+        sums.push_back(geometry_msgs::Point());
+        counts.push_back(0);
+      }
+
+      remap[i] = it->second;
+      sums[it->second].x += vertex.x;
+      sums[it->second].y += vertex.y;
+      sums[it->second].z += vertex.z;
+      counts[it->second]++;
+    }
+
+    // Collapsed and duplicate triangles are dropped
+    std::set<std::array<uint32_t, 3> > unique;
+    std::vector<shape_msgs::MeshTriangle> triangles;
+    for (std::size_t i = 0; i < mesh.triangles.size(); i++)
+    {
+      shape_msgs::MeshTriangle triangle;
+      for (int k = 0; k < 3; k++)
+        triangle.vertex_indices[k] = remap[mesh.triangles[i].vertex_indices[k]];
+
+      const boost::array<uint32_t, 3>& v = triangle.vertex_indices;
+      if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+        continue;
+
+      std::array<uint32_t, 3> key = { { v[0], v[1], v[2] } };
+      std::sort(key.begin(), key.end());
+      if (unique.insert(key).second)
+        triangles.push_back(triangle);
+    }
+
+    if (triangles.size() > max_triangles && resolution > 1)
+      continue;
+
+    for (std::size_t i = 0; i < sums.size(); i++)
+    {
+      sums[i].x /= counts[i];
+      sums[i].y /= counts[i];
+      sums[i].z /= counts[i];
+    }
+
+    // Merged vertices moved up to a cell diagonal, inflate by it so the mesh stays conservative
+    inflate(sums, triangles, cell_size * sqrt(3.0));
+
+    mesh.vertices.swap(sums);
+    mesh.triangles.swap(triangles);
+    return;
+  }
+}
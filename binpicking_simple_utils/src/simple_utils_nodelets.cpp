@@ -0,0 +1,74 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+// Simple utils loadable into a nodelet manager together with the emulators, tool pose
+// and planning scene messages are then passed as shared pointers without serialization.
+
+#include <binpicking_simple_utils/collision_object_publisher.h>
+#include <binpicking_simple_utils/tool_pose_tf_broadcaster.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+
+namespace binpicking_simple_utils
+{
+class ToolPoseTfBroadcasterNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    // Pose callbacks and batch publishing run in parallel on manager worker threads
+    broadcaster.reset(new Broadcaster(&getMTNodeHandle(), getMTPrivateNodeHandle()));
+    NODELET_INFO("Tool Pose TF Broadcater running!");
+  }
+
+  std::shared_ptr<Broadcaster> broadcaster;
+};
+
+class CollisionObjectPublisherNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    ros::NodeHandle& nh = getNodeHandle();
+
+    std::string collision_objects_list_filepath;
+    nh.getParam("collision_objects_list_filepath", collision_objects_list_filepath);
+    publisher.reset(new CollisionObjectPublisher(&nh, collision_objects_list_filepath, getPrivateNodeHandle()));
+
+    // Diffs are not latched, initial publish waits for move_group without blocking the manager
+    subscriber_timer = nh.createWallTimer(ros::WallDuration(0.5), &CollisionObjectPublisherNodelet::subscriberCallback,
+                                          this);
+  }
+
+  void subscriberCallback(const ros::WallTimerEvent& event)
+  {
+    if (publisher->subscribers() == 0)
+      return;
+
+    subscriber_timer.stop();
+    publisher->publishAllCollisionObjects();
+  }
+
+  std::shared_ptr<CollisionObjectPublisher> publisher;
+  ros::WallTimer subscriber_timer;
+};
+}  // namespace binpicking_simple_utils
+
+PLUGINLIB_EXPORT_CLASS(binpicking_simple_utils::ToolPoseTfBroadcasterNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(binpicking_simple_utils::CollisionObjectPublisherNodelet, nodelet::Nodelet)
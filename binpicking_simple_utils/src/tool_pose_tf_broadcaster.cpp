@@ -16,9 +16,42 @@ limitations under the License.
 
 #include <binpicking_simple_utils/tool_pose_tf_broadcaster.h>
 
-Broadcaster::Broadcaster()
+#include <algorithm>
+#include <cmath>
+
+Broadcaster::Broadcaster(ros::NodeHandle* nh, ros::NodeHandle pnh) : static_sent(false)
 {
-  
+  double publish_rate;
+  int max_batch;
+  pnh.param<std::string>("parent_frame", parent_frame, "base_link");
+  pnh.param<std::string>("child_frame", child_frame, "photoneo_tool_pose");
+  pnh.param<bool>("static_mode", static_mode, false);
+  pnh.param<double>("static_translation_tolerance", static_translation_tolerance, 1e-4);
+  pnh.param<double>("static_rotation_tolerance", static_rotation_tolerance, 1e-3);
+  pnh.param<double>("publish_rate", publish_rate, 0.0);
+  pnh.param<int>("max_batch_size", max_batch, 100);
+  max_batch_size = std::max(max_batch, 1);
+
+  tf_pub = nh->advertise<tf2_msgs::TFMessage>("/tf", 100);
+
+  // Zero rate sends every pose as soon as it is received
+  if (!static_mode && publish_rate > 0)
+    publish_timer = nh->createWallTimer(ros::WallDuration(1.0 / publish_rate), &Broadcaster::publishCallback, this);
+
+  // Low latency transport, controllers stream tool pose at hundreds of Hz
+  bool udp;
+  int queue_size;
+  pnh.param<bool>("udp", udp, false);
+  pnh.param<int>("queue_size", queue_size, 10);
+
+  ros::TransportHints transport_hints;
+  if (udp)
+    transport_hints = transport_hints.unreliable();
+  transport_hints = transport_hints.reliable().tcpNoDelay();
+
+  sub = nh->subscribe("photoneo_tool_pose", queue_size, &Broadcaster::poseCallback, this, transport_hints);
+  stamped_sub = nh->subscribe("photoneo_tool_pose_stamped", queue_size, &Broadcaster::poseStampedCallback, this,
+                              transport_hints);
 }
 
 Broadcaster::~Broadcaster()
@@ -26,44 +59,99 @@ Broadcaster::~Broadcaster()
   
 }
 
-void Broadcaster::poseCallback(const geometry_msgs::PoseConstPtr& msg){
-  
+void Broadcaster::poseCallback(const geometry_msgs::PoseConstPtr& msg)
+{
+  // Plain pose carries no time, stamp it on arrival
+  addTransform(*msg, ros::Time::now(), parent_frame);
+}
+
+void Broadcaster::poseStampedCallback(const geometry_msgs::PoseStampedConstPtr& msg)
+{
+  ros::Time stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
+  addTransform(msg->pose, stamp, msg->header.frame_id.empty() ? parent_frame : msg->header.frame_id);
+}
+
+void Broadcaster::addTransform(const geometry_msgs::Pose& pose, const ros::Time& stamp, const std::string& frame_id)
+{
   // Check data validity (Quaternion x^2 + y^2 + z^2 + w^2 = 1)
-  double quaternion_sum = pow(msg->orientation.x, 2)
-                        + pow(msg->orientation.y, 2) 
-                        + pow(msg->orientation.z, 2) 
-                        + pow(msg->orientation.w, 2);
-  
-  if (abs(1 -quaternion_sum) < 0.01)
+  double quaternion_sum = pow(pose.orientation.x, 2)
+                        + pow(pose.orientation.y, 2)
+                        + pow(pose.orientation.z, 2)
+                        + pow(pose.orientation.w, 2);
+
+  if (fabs(1 - quaternion_sum) >= 0.01)
   {
-    // Tool Pose transform
-    origin.setX(msg->position.x);
-    origin.setY(msg->position.y);
-    origin.setZ(msg->position.z);
-    
-    orientation.setX(msg->orientation.x);
-    orientation.setY(msg->orientation.y);
-    orientation.setZ(msg->orientation.z);
-    orientation.setW(msg->orientation.w);
-        
-    transform.setOrigin(origin);    
-    transform.setRotation(orientation);
-        
-    br.sendTransform(tf::StampedTransform(transform, ros::Time::now(), "base_link", "photoneo_tool_pose"));
+    ROS_WARN_THROTTLE(1.0, "Tool Pose Quaternion not valid!");
+    return;
   }
-  else
-    ROS_WARN("Tool Pose Quaternion not valid!");
+
+  // Tool Pose transform
+  geometry_msgs::TransformStamped transform;
+  transform.header.stamp = stamp;
+  transform.header.frame_id = frame_id;
+  transform.child_frame_id = child_frame;
+  transform.transform.translation.x = pose.position.x;
+  transform.transform.translation.y = pose.position.y;
+  transform.transform.translation.z = pose.position.z;
+  transform.transform.rotation = pose.orientation;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (static_mode)
+  {
+    // Latched transform is sent again only when the pose moves beyond the tolerances,
+    // poses streamed by a standing robot still differ by controller noise
+    if (static_sent && !staticTransformChanged(transform))
+      return;
+
+    static_transform = transform;
+    static_sent = true;
+    static_br.sendTransform(static_transform);
+    return;
+  }
+
+  if (!publish_timer.isValid())
+  {
+    tf2_msgs::TFMessagePtr message(new tf2_msgs::TFMessage());
+    message->transforms.push_back(transform);
+    tf_pub.publish(message);
+    return;
+  }
+
+  // Oldest samples are dropped when publishing can not keep up
+  if (batch.transforms.size() >= max_batch_size)
+    batch.transforms.erase(batch.transforms.begin());
+  batch.transforms.push_back(transform);
 }
 
-int main(int argc, char** argv){
-  ros::init(argc, argv, "tool_pose_tf_broadcaster");
-  ros::NodeHandle nh;
-  
-  Broadcaster broadcaster;
-  
-  ros::Subscriber sub = nh.subscribe("photoneo_tool_pose", 1, &Broadcaster::poseCallback, &broadcaster);
+void Broadcaster::publishCallback(const ros::WallTimerEvent& event)
+{
+  tf2_msgs::TFMessagePtr message(new tf2_msgs::TFMessage());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batch.transforms.empty())
+      return;
+    message->transforms.swap(batch.transforms);
+  }
+
+  tf_pub.publish(message);
+}
+
+bool Broadcaster::staticTransformChanged(const geometry_msgs::TransformStamped& transform) const
+{
+  if (static_transform.header.frame_id != transform.header.frame_id)
+    return true;
+
+  const geometry_msgs::Vector3& a = static_transform.transform.translation;
+  const geometry_msgs::Vector3& b = transform.transform.translation;
+  double distance = sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2));
+
+  // Angle between orientations, quaternions are only close to unit length
+  const geometry_msgs::Quaternion& p = static_transform.transform.rotation;
+  const geometry_msgs::Quaternion& q = transform.transform.rotation;
+  double dot = p.x * q.x + p.y * q.y + p.z * q.z + p.w * q.w;
+  double norms = sqrt((p.x * p.x + p.y * p.y + p.z * p.z + p.w * p.w) *
+                      (q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w));
+  double angle = 2 * acos(std::min(1.0, fabs(dot) / norms));
 
-  ROS_INFO("Tool Pose TF Broadcater running!");
-  ros::spin();
-  return 0;
+  return distance > static_translation_tolerance || angle > static_rotation_tolerance;
 }
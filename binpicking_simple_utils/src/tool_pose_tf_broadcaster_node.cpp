@@ -0,0 +1,36 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <binpicking_simple_utils/tool_pose_tf_broadcaster.h>
+
+int main(int argc, char** argv){
+  ros::init(argc, argv, "tool_pose_tf_broadcaster");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  Broadcaster broadcaster(&nh, pnh);
+
+  int spinner_threads;
+  pnh.param<int>("spinner_threads", spinner_threads, 2);
+
+  ROS_INFO("Tool Pose TF Broadcater running!");
+
+  // Pose callbacks and batch publishing run in parallel
+  ros::AsyncSpinner spinner(std::max(spinner_threads, 1));
+  spinner.start();
+  ros::waitForShutdown();
+  return 0;
+}
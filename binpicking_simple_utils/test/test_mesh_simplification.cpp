@@ -0,0 +1,218 @@
+/*********************************************************************
+Copyright [2017] [Frantisek Durovsky]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <binpicking_simple_utils/mesh_simplification.h>
+
+#include <cmath>
+
+namespace
+{
+geometry_msgs::Point point(double x, double y, double z)
+{
+  geometry_msgs::Point point;
+  point.x = x;
+  point.y = y;
+  point.z = z;
+  return point;
+}
+
+void addTriangle(shape_msgs::Mesh& mesh, uint32_t a, uint32_t b, uint32_t c)
+{
+  shape_msgs::MeshTriangle triangle;
+  triangle.vertex_indices[0] = a;
+  triangle.vertex_indices[1] = b;
+  triangle.vertex_indices[2] = c;
+  mesh.triangles.push_back(triangle);
+}
+
+// Box of 12 triangles, counter-clockwise seen from outside
+shape_msgs::Mesh boxMesh(double min_x, double min_y, double min_z, double max_x, double max_y, double max_z)
+{
+  shape_msgs::Mesh mesh;
+  for (int i = 0; i < 8; i++)
+    mesh.vertices.push_back(point(i & 1 ? max_x : min_x, i & 2 ? max_y : min_y, i & 4 ? max_z : min_z));
+
+  const uint32_t faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 },
+                                 { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+  for (int i = 0; i < 6; i++)
+  {
+    addTriangle(mesh, faces[i][0], faces[i][1], faces[i][2]);
+    addTriangle(mesh, faces[i][0], faces[i][2], faces[i][3]);
+  }
+  return mesh;
+}
+
+// Cube [-1, 1]^3 with every face split into a grid of 2 n^2 triangles, optionally projected
+// on the unit sphere. Counter-clockwise seen from outside
+shape_msgs::Mesh denseMesh(int n, bool sphere)
+{
+  shape_msgs::Mesh mesh;
+  for (int axis = 0; axis < 3; axis++)
+    for (int sign = -1; sign <= 1; sign += 2)
+    {
+      // u x v points along the face normal
+      int u = (axis + (sign > 0 ? 1 : 2)) % 3;
+      int v = (axis + (sign > 0 ? 2 : 1)) % 3;
+      uint32_t first = mesh.vertices.size();
+      for (int i = 0; i <= n; i++)
+        for (int j = 0; j <= n; j++)
+        {
+          double p[3];
+          p[axis] = sign;
+          p[u] = -1 + 2.0 * i / n;
+          p[v] = -1 + 2.0 * j / n;
+          double scale = sphere ? 1 / sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) : 1;
+          mesh.vertices.push_back(point(scale * p[0], scale * p[1], scale * p[2]));
+        }
+
+      for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+        {
+          uint32_t a = first + i * (n + 1) + j;
+          uint32_t b = a + n + 1;
+          addTriangle(mesh, a, b, b + 1);
+          addTriangle(mesh, a, b + 1, a + 1);
+        }
+    }
+  return mesh;
+}
+
+// Generalized winding number, sum of solid angles of the triangles seen from the point,
+// close to 1 inside a closed mesh and to 0 outside
+double windingNumber(const shape_msgs::Mesh& mesh, const geometry_msgs::Point& p)
+{
+  double sum = 0;
+  for (std::size_t i = 0; i < mesh.triangles.size(); i++)
+  {
+    double r[3][3], length[3];
+    for (int k = 0; k < 3; k++)
+    {
+      const geometry_msgs::Point& vertex = mesh.vertices[mesh.triangles[i].vertex_indices[k]];
+      r[k][0] = vertex.x - p.x;
+      r[k][1] = vertex.y - p.y;
+      r[k][2] = vertex.z - p.z;
+      length[k] = sqrt(r[k][0] * r[k][0] + r[k][1] * r[k][1] + r[k][2] * r[k][2]);
+    }
+
+    double cross[3] = { r[1][1] * r[2][2] - r[1][2] * r[2][1], r[1][2] * r[2][0] - r[1][0] * r[2][2],
+                        r[1][0] * r[2][1] - r[1][1] * r[2][0] };
+    double triple = r[0][0] * cross[0] + r[0][1] * cross[1] + r[0][2] * cross[2];
+    double dot01 = r[0][0] * r[1][0] + r[0][1] * r[1][1] + r[0][2] * r[1][2];
+    double dot02 = r[0][0] * r[2][0] + r[0][1] * r[2][1] + r[0][2] * r[2][2];
+    double dot12 = r[1][0] * r[2][0] + r[1][1] * r[2][1] + r[1][2] * r[2][2];
+    double denominator = length[0] * length[1] * length[2] + dot01 * length[2] + dot02 * length[1] + dot12 * length[0];
+    sum += 2 * atan2(triple, denominator);
+  }
+  return sum / (4 * M_PI);
+}
+
+void expectEncloses(const shape_msgs::Mesh& original, std::size_t max_triangles)
+{
+  shape_msgs::Mesh decimated = original;
+  decimateMesh(decimated, max_triangles);
+  ASSERT_LE(decimated.triangles.size(), max_triangles);
+  ASSERT_FALSE(decimated.triangles.empty());
+
+  for (std::size_t i = 0; i < original.vertices.size(); i++)
+    EXPECT_GT(windingNumber(decimated, original.vertices[i]), 0.5) << "vertex " << i << " outside";
+}
+}  // namespace
+
+TEST(FitBox, FitsBoxMesh)
+{
+  shape_msgs::Mesh mesh = boxMesh(0.1, -0.2, 0.0, 0.4, 0.2, 0.05);
+
+  shape_msgs::SolidPrimitive box;
+  geometry_msgs::Point center;
+  ASSERT_TRUE(fitBox(mesh, box, center));
+
+  EXPECT_EQ(box.type, shape_msgs::SolidPrimitive::BOX);
+  ASSERT_EQ(box.dimensions.size(), 3u);
+  EXPECT_NEAR(box.dimensions[shape_msgs::SolidPrimitive::BOX_X], 0.3, 1e-12);
+  EXPECT_NEAR(box.dimensions[shape_msgs::SolidPrimitive::BOX_Y], 0.4, 1e-12);
+  EXPECT_NEAR(box.dimensions[shape_msgs::SolidPrimitive::BOX_Z], 0.05, 1e-12);
+  EXPECT_NEAR(center.x, 0.25, 1e-12);
+  EXPECT_NEAR(center.y, 0.0, 1e-12);
+  EXPECT_NEAR(center.z, 0.025, 1e-12);
+}
+
+TEST(FitBox, RejectsVertexOutsideCorners)
+{
+  shape_msgs::Mesh mesh = boxMesh(0, 0, 0, 1, 1, 1);
+  mesh.vertices[7] = point(1, 1, 0.5);
+
+  shape_msgs::SolidPrimitive box;
+  geometry_msgs::Point center;
+  EXPECT_FALSE(fitBox(mesh, box, center));
+}
+
+TEST(FitBox, RejectsMissingAndDoubledFaces)
+{
+  shape_msgs::SolidPrimitive box;
+  geometry_msgs::Point center;
+
+  shape_msgs::Mesh open = boxMesh(0, 0, 0, 1, 1, 1);
+  open.triangles.resize(10);
+  EXPECT_FALSE(fitBox(open, box, center));
+
+  shape_msgs::Mesh doubled = boxMesh(0, 0, 0, 1, 1, 1);
+  addTriangle(doubled, 0, 2, 3);
+  addTriangle(doubled, 0, 3, 1);
+  EXPECT_FALSE(fitBox(doubled, box, center));
+}
+
+TEST(FitBox, RejectsFlatAndEmptyMesh)
+{
+  shape_msgs::SolidPrimitive box;
+  geometry_msgs::Point center;
+
+  EXPECT_FALSE(fitBox(boxMesh(0, 0, 0, 1, 1, 0), box, center));
+  EXPECT_FALSE(fitBox(shape_msgs::Mesh(), box, center));
+}
+
+TEST(DecimateMesh, KeepsSmallMesh)
+{
+  shape_msgs::Mesh mesh = denseMesh(4, true);
+  shape_msgs::Mesh decimated = mesh;
+  decimateMesh(decimated, mesh.triangles.size());
+
+  EXPECT_EQ(decimated.triangles.size(), mesh.triangles.size());
+  EXPECT_EQ(decimated.vertices.size(), mesh.vertices.size());
+}
+
+TEST(DecimateMesh, EnclosesSphere)
+{
+  shape_msgs::Mesh sphere = denseMesh(20, true);
+  ASSERT_EQ(sphere.triangles.size(), 4800u);
+
+  expectEncloses(sphere, 1000);
+  expectEncloses(sphere, 200);
+}
+
+TEST(DecimateMesh, EnclosesBox)
+{
+  shape_msgs::Mesh box = denseMesh(20, false);
+
+  expectEncloses(box, 1000);
+  expectEncloses(box, 200);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}